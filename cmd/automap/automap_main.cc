@@ -1,7 +1,15 @@
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <functional>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include "absl/debugging/failure_signal_handler.h"
 #include "absl/flags/flag.h"
@@ -13,35 +21,199 @@
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/time/clock.h"
+#include "cmd/automap/batch_lighting.h"
+#include "cmd/automap/capture.h"
 #include "cmd/automap/ddp.h"
+#include "cmd/automap/ddp_fanout.h"
+#include "cmd/automap/ddp_probe.h"
+#include "cmd/automap/ddp_receiver.h"
+#include "cmd/automap/gray_code.h"
+#include "cmd/automap/gray_code_decoder.h"
+#include "cmd/automap/image_writer.h"
+#include "cmd/automap/latency.h"
 #include "cmd/automap/net.h"
+#include "cmd/automap/pixel_selection.h"
+#include "cmd/automap/settle.h"
 #include "cmd/automap/stream_reader.h"
+#include "cmd/automap/stream_recorder.h"
+#include "cmd/automap/synthetic_stream_reader.h"
+#include "cmd/automap/universe.h"
+#include "cmd/detect/detect.h"
+#include "cmd/detect/records.h"
 #include "lib/file/path.h"
+#include "lib/file/proto.h"
+#include "lib/file/readers.h"
+#include "lib/file/stream_align.h"
+#include "lib/file/writers.h"
+#include "lib/geometry/camera_metadata.h"
+#include "lib/geometry/points.h"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/opencv.hpp"
+#include "proto/camera_metadata.pb.h"
+#include "proto/points.pb.h"
 
-ABSL_FLAG(std::string, camera, "", "URL for camera");
+ABSL_FLAG(std::string, camera, "",
+          "Comma-separated camera URLs. With more than one camera, each "
+          "camera's images are written to <outdir>/camera_<number>.");
 ABSL_FLAG(std::string, controller, "", "host:port for DDP controller");
 ABSL_FLAG(int, num_pixels, -1, "Number of pixels on controller");
+ABSL_FLAG(std::string, controllers, "",
+          "Drive several controllers as one string, instead of --controller "
+          "and --num_pixels. A comma-separated list of "
+          "host[:port]=num_pixels[@offset], where offset is the controller "
+          "pixel that receives the entry's first pixel. Pixels are numbered "
+          "across controllers in list order.");
 ABSL_FLAG(int, start_pixel, 0, "Pixel to start with");
 ABSL_FLAG(int, end_pixel, -1,
           "Pixel to end with (inclusive); defaults to num_pixels-1");
 ABSL_FLAG(std::string, outdir, "", "Output directory for images");
 ABSL_FLAG(bool, verbose, false, "Verbose mode");
 ABSL_FLAG(absl::Duration, ddp_settle_time, absl::Milliseconds(500),
-          "DDP settle time");
+          "DDP settle time. In adaptive settle mode, this is the maximum "
+          "time to wait.");
+ABSL_FLAG(std::string, settle_mode, "fixed",
+          "How to wait for the lights after each DDP push. 'fixed' sleeps "
+          "for --ddp_settle_time. 'adaptive' watches the camera until the "
+          "image changes and then holds steady, recording the measured "
+          "latencies in settle_times in each camera's directory.");
+ABSL_FLAG(int, settle_stable_frames, 3,
+          "Number of steady frames required in adaptive settle mode");
+ABSL_FLAG(int, settle_change_pixels, 2,
+          "Number of (downscaled) pixels that must change in adaptive settle "
+          "mode");
+ABSL_FLAG(int, probe_samples, 0,
+          "Number of DDP status queries to send each controller at startup. "
+          "Half the median round-trip time is taken as the soonest a push "
+          "can show up on camera: --ddp_settle_time is raised to at least "
+          "that, and adaptive settling ignores earlier frames. Controllers "
+          "that don't answer queries are skipped.");
+ABSL_FLAG(bool, ddp_delta, false,
+          "Only send the DDP channels that changed since the previous frame");
+ABSL_FLAG(int, ddp_full_frame_interval, 10,
+          "With --ddp_delta, send every this many frames in full anyway, so "
+          "that pixels left stale by a dropped packet are corrected; 0 never "
+          "does");
 ABSL_FLAG(bool, display, true, "Display in-progress results");
+ABSL_FLAG(bool, lazy_decode, false,
+          "Only decode camera frames when they're needed, rather than "
+          "decoding every frame as it arrives");
+ABSL_FLAG(int, writer_threads, 2,
+          "Number of threads encoding and writing images in the background. "
+          "0 writes each image before moving on to the next push.");
+ABSL_FLAG(int, writer_queue, 16,
+          "Maximum number of images waiting to be written before capture "
+          "blocks");
+ABSL_FLAG(int, latency_report_interval, 100,
+          "Log per-stage capture latencies every this many captures (0 to "
+          "only log them at the end)");
+ABSL_FLAG(std::string, latency_summary, "",
+          "CSV file to receive per-stage capture latencies at the end of the "
+          "run; defaults to latencies.csv in --outdir");
+ABSL_FLAG(std::string, capture_mode, "single",
+          "How pixels are lit. 'single' lights one pixel per frame. "
+          "'rgb' lights three pixels per frame in red, green and blue, saved "
+          "as rgb_NNN.jpg where NNN is the red pixel (see detect --channel). "
+          "'gray_code' lights all pixels at once using Gray-code bit planes, "
+          "decoding the results into --output_coords. 'batch' uses "
+          "--prior_coords to light groups of pixels that are far apart in "
+          "every camera, saved as batch_NNN.jpg, and writes the located "
+          "pixels to --output_coords. 'stream' records each camera "
+          "continuously while lighting one pixel every --stream_interval, "
+          "for cmd/detect's stream_detect to find afterwards.");
+ABSL_FLAG(int, camera_number, 1,
+          "Number of the first camera; subsequent cameras are numbered "
+          "sequentially. Used in --output_coords.");
+ABSL_FLAG(std::string, simulate_world_coords, "",
+          "Simulate the lights and cameras instead of using real ones. A "
+          "proto.PixelRecords textproto with the ground-truth world location "
+          "of each pixel. DDP frames go to an in-process emulated controller, "
+          "and cameras 1 and 2 render what it receives.");
+ABSL_FLAG(int, simulate_cameras, 2, "Number of simulated cameras (1 or 2)");
+ABSL_FLAG(std::string, camera_metadata, "",
+          "Path to a proto.CameraMetadata textproto describing the simulated "
+          "cameras");
+ABSL_FLAG(std::string, output_coords, "",
+          "File to receive coordinates in proto.PixelRecords textproto format "
+          "(gray_code and batch modes)");
+ABSL_FLAG(std::string, prior_coords, "",
+          "proto.PixelRecords textproto with the camera coordinates of each "
+          "pixel from an earlier run (batch mode). Pixels without coordinates "
+          "in every camera are lit one at a time.");
+ABSL_FLAG(bool, resume, false,
+          "Skip pixels whose pixel_NNN.jpg already exists in every camera's "
+          "directory (single mode)");
+ABSL_FLAG(std::string, pixels_file, "",
+          "Only capture the pixels listed in this file, one per line, such as "
+          "the missed file written by scripts/detect_all_images (single "
+          "mode)");
+ABSL_FLAG(std::string, unseen_from, "",
+          "Only capture the pixels that this proto.PixelRecords textproto "
+          "doesn't locate in every camera (single mode)");
+ABSL_FLAG(double, batch_min_distance, 50,
+          "Minimum distance, in camera pixels, between pixels lit together in "
+          "batch mode");
+ABSL_FLAG(absl::Duration, stream_interval, absl::Milliseconds(100),
+          "Time each pixel is lit for in stream mode. At least a few camera "
+          "frame intervals, so that some frames show only that pixel.");
+ABSL_FLAG(double, stream_fps, 30,
+          "Frame rate recorded in stream mode videos' metadata");
 
 namespace {
 
-absl::Status SaveImage(cv::Mat mat, const std::string& filename) {
-  if (!cv::imwrite(filename, mat)) {
-    return absl::UnknownError(
-        absl::StrCat("failed to write image to ", filename));
+void MakeDirOrDie(const std::string& path) {
+  if (mkdir(path.c_str(), 0777) < 0 && errno != EEXIST) {
+    QCHECK(false) << "Failed to make " << path << ": " << strerror(errno);
   }
-  return absl::OkStatus();
+}
+
+enum class CaptureMode {
+  kSingle,
+  kRgb,
+  kGrayCode,
+  kBatch,
+  kStream,
+};
+
+CaptureMode ParseCaptureMode(const std::string& str) {
+  if (str == "single") {
+    return CaptureMode::kSingle;
+  } else if (str == "rgb") {
+    return CaptureMode::kRgb;
+  } else if (str == "gray_code") {
+    return CaptureMode::kGrayCode;
+  } else if (str == "batch") {
+    return CaptureMode::kBatch;
+  } else if (str == "stream") {
+    return CaptureMode::kStream;
+  }
+
+  QCHECK(false) << "invalid --capture_mode " << str;
+  return CaptureMode::kSingle;
+}
+
+// Returns the world location of each pixel in a PixelRecords file, indexed
+// by pixel number.
+std::vector<std::optional<XYZPos>> ReadWorldPixelsOrDie(
+    const std::string& path) {
+  auto records = ReadProto<proto::PixelRecords>(path);
+  QCHECK_OK(records);
+
+  std::vector<std::optional<XYZPos>> pixels;
+  for (const proto::PixelRecord& record : records->pixel()) {
+    if (!record.has_world_pixel()) {
+      continue;
+    }
+
+    const proto::Point3d& loc = record.world_pixel().pixel_location();
+    if (record.pixel_number() >= static_cast<int>(pixels.size())) {
+      pixels.resize(record.pixel_number() + 1);
+    }
+    pixels[record.pixel_number()] = XYZPos{loc.x(), loc.y(), loc.z()};
+  }
+  return pixels;
 }
 
 }  // namespace
@@ -51,21 +223,47 @@ int main(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
   absl::InstallFailureSignalHandler(absl::FailureSignalHandlerOptions());
 
-  QCHECK(!absl::GetFlag(FLAGS_camera).empty()) << "--camera is required";
-  QCHECK(!absl::GetFlag(FLAGS_controller).empty())
-      << "--controller is required";
+  const bool simulate = !absl::GetFlag(FLAGS_simulate_world_coords).empty();
+  if (!simulate) {
+    QCHECK(!absl::GetFlag(FLAGS_camera).empty()) << "--camera is required";
+  }
 
   QCHECK(!absl::GetFlag(FLAGS_outdir).empty()) << "--outdir is required";
   const std::string outdir = absl::GetFlag(FLAGS_outdir);
 
+  std::optional<std::vector<UniverseEntry>> universe;
   std::string hostname;
-  int port;
-  std::tie(hostname, port) =
-      ParseHostPort(absl::GetFlag(FLAGS_controller), kDefaultDDPPort);
-  QCHECK(!hostname.empty()) << "Invalid controller host:port";
+  int port = 0;
+  std::vector<std::optional<XYZPos>> world_pixels;
+  if (simulate) {
+    world_pixels =
+        ReadWorldPixelsOrDie(absl::GetFlag(FLAGS_simulate_world_coords));
+    QCHECK(!world_pixels.empty()) << "no world coordinates to simulate";
+  } else if (const std::string spec = absl::GetFlag(FLAGS_controllers);
+             !spec.empty()) {
+    QCHECK(absl::GetFlag(FLAGS_controller).empty())
+        << "--controller and --controllers are mutually exclusive";
+    auto statusor = ParseUniverseMap(spec, kDefaultDDPPort);
+    QCHECK_OK(statusor);
+    universe = std::move(*statusor);
+  } else {
+    QCHECK(!absl::GetFlag(FLAGS_controller).empty())
+        << "--controller or --controllers is required";
+    std::tie(hostname, port) =
+        ParseHostPort(absl::GetFlag(FLAGS_controller), kDefaultDDPPort);
+    QCHECK(!hostname.empty()) << "Invalid controller host:port";
+    QCHECK_NE(absl::GetFlag(FLAGS_num_pixels), -1)
+        << "--num_pixels is required";
+  }
 
-  QCHECK_NE(absl::GetFlag(FLAGS_num_pixels), -1) << "--num_pixels is required";
-  const int num_pixels = absl::GetFlag(FLAGS_num_pixels);
+  const int num_pixels = [&]() {
+    if (universe.has_value()) {
+      return UniverseSize(*universe);
+    } else if (simulate && absl::GetFlag(FLAGS_num_pixels) == -1) {
+      return static_cast<int>(world_pixels.size());
+    }
+    return absl::GetFlag(FLAGS_num_pixels);
+  }();
   const int start_pixel = absl::GetFlag(FLAGS_start_pixel);
   const int end_pixel = [&](int end) {
     return end == -1 ? num_pixels - 1 : end;
@@ -79,63 +277,452 @@ int main(int argc, char** argv) {
   LOG(INFO) << "num_pixels: " << num_pixels << " scanning [" << start_pixel
             << "," << end_pixel << "]";
 
-  const absl::Duration settle_time = absl::GetFlag(FLAGS_ddp_settle_time);
+  absl::Duration settle_time = absl::GetFlag(FLAGS_ddp_settle_time);
+
+  const CaptureMode capture_mode =
+      ParseCaptureMode(absl::GetFlag(FLAGS_capture_mode));
+  if (capture_mode == CaptureMode::kGrayCode ||
+      capture_mode == CaptureMode::kBatch) {
+    QCHECK(!absl::GetFlag(FLAGS_output_coords).empty())
+        << "--output_coords is required in "
+        << absl::GetFlag(FLAGS_capture_mode) << " mode";
+  }
+
+  const bool select_pixels = absl::GetFlag(FLAGS_resume) ||
+                             !absl::GetFlag(FLAGS_pixels_file).empty() ||
+                             !absl::GetFlag(FLAGS_unseen_from).empty();
+  if (select_pixels) {
+    QCHECK(capture_mode == CaptureMode::kSingle)
+        << "--resume, --pixels_file and --unseen_from require single mode";
+  }
+
+  std::optional<proto::PixelRecords> prior_coords;
+  if (capture_mode == CaptureMode::kBatch) {
+    QCHECK(!absl::GetFlag(FLAGS_prior_coords).empty())
+        << "--prior_coords is required in batch mode";
+    auto statusor =
+        ReadProto<proto::PixelRecords>(absl::GetFlag(FLAGS_prior_coords));
+    QCHECK_OK(statusor);
+    prior_coords = std::move(*statusor);
+  }
+
+  MakeDirOrDie(outdir);
 
-  if (mkdir(absl::GetFlag(FLAGS_outdir).c_str(), 0777) < 0 && errno != EEXIST) {
-    QCHECK(false) << "Failed to make outdir: " << strerror(errno);
+  // In simulation, DDP frames go to an emulated controller in this process.
+  std::unique_ptr<DDPReceiver> simulated_controller;
+  std::thread simulated_controller_thread;
+  if (simulate) {
+    auto statusor = DDPReceiver::Create({.num_pixels = num_pixels});
+    QCHECK_OK(statusor);
+    simulated_controller = std::move(*statusor);
+    simulated_controller_thread =
+        std::thread([&] { simulated_controller->Run(); });
+
+    hostname = "127.0.0.1";
+    port = simulated_controller->port();
   }
 
-  std::unique_ptr<DDPConn> ddp_conn = [&]() {
+  std::unique_ptr<DDPOutput> ddp_conn = [&]() -> std::unique_ptr<DDPOutput> {
+    if (universe.has_value()) {
+      auto statusor = DDPFanout::Create(
+          *universe, {
+                         .delta_updates = absl::GetFlag(FLAGS_ddp_delta),
+                         .full_frame_interval =
+                             absl::GetFlag(FLAGS_ddp_full_frame_interval),
+                         .verbose = absl::GetFlag(FLAGS_verbose),
+                     });
+      QCHECK_OK(statusor);
+      return std::move(*statusor);
+    }
+
     auto statusor = DDPConn::Create(
         hostname, port,
-        {.num_pixels = num_pixels, .verbose = absl::GetFlag(FLAGS_verbose)});
+        {
+            .num_pixels = num_pixels,
+            .delta_updates = absl::GetFlag(FLAGS_ddp_delta),
+            .full_frame_interval =
+                absl::GetFlag(FLAGS_ddp_full_frame_interval),
+            .verbose = absl::GetFlag(FLAGS_verbose),
+        });
     QCHECK_OK(statusor);
     return std::move(*statusor);
   }();
 
-  auto stream = std::make_unique<cv::VideoCapture>();
-  QCHECK(stream->open(absl::GetFlag(FLAGS_camera)));
+  // The soonest a push could take effect, from probing the controllers.
+  absl::Duration min_push_latency = absl::ZeroDuration();
+  if (const int samples = absl::GetFlag(FLAGS_probe_samples); samples > 0) {
+    std::vector<std::tuple<std::string, int>> controllers;
+    if (universe.has_value()) {
+      for (const UniverseEntry& entry : *universe) {
+        controllers.emplace_back(entry.host, entry.port);
+      }
+    } else {
+      controllers.emplace_back(hostname, port);
+    }
+
+    for (const auto& [controller_host, controller_port] : controllers) {
+      auto result = ProbeDDPController(controller_host, controller_port,
+                                       {.samples = samples});
+      QCHECK_OK(result);
+      LOG(INFO) << "controller " << controller_host << ":" << controller_port
+                << ": " << FormatDDPProbeResult(*result);
+      if (result->received == 0) {
+        LOG(WARNING) << "no replies from " << controller_host << ":"
+                     << controller_port
+                     << "; not using it to bound settle time";
+        continue;
+      }
+      min_push_latency = std::max(min_push_latency, result->median / 2);
+    }
+  }
+
+  const StreamReader::Options reader_options = {
+      .verbose = absl::GetFlag(FLAGS_verbose),
+      .lazy_decode = absl::GetFlag(FLAGS_lazy_decode),
+  };
+
+  std::vector<CaptureCamera> cameras;
+  if (simulate) {
+    QCHECK(!absl::GetFlag(FLAGS_camera_metadata).empty())
+        << "--camera_metadata is required to simulate";
+    auto metadata =
+        ReadProto<proto::CameraMetadata>(absl::GetFlag(FLAGS_camera_metadata));
+    QCHECK_OK(metadata);
+
+    const int num_cameras = absl::GetFlag(FLAGS_simulate_cameras);
+    QCHECK(num_cameras == 1 || num_cameras == 2)
+        << "invalid --simulate_cameras";
+    for (int number = 1; number <= num_cameras; ++number) {
+      cameras.push_back({
+          .number = number,
+          .outdir = outdir,
+          .reader = std::make_unique<SyntheticStreamReader>(
+              SyntheticStreamReader::Options{
+                  .reader = reader_options,
+                  .camera_number = number,
+                  .metadata = CameraMetadata::FromProto(*metadata),
+                  .pixels = world_pixels,
+              },
+              simulated_controller.get()),
+      });
+    }
+  } else {
+    const std::vector<std::string> camera_urls =
+        absl::StrSplit(absl::GetFlag(FLAGS_camera), ',');
+    const int first_camera_number = absl::GetFlag(FLAGS_camera_number);
+    QCHECK_GT(first_camera_number, 0) << "invalid --camera_number";
+
+    for (int i = 0; i < static_cast<int>(camera_urls.size()); ++i) {
+      auto stream = std::make_unique<cv::VideoCapture>();
+      QCHECK(stream->open(camera_urls[i]))
+          << "failed to open " << camera_urls[i];
+
+      cameras.push_back({
+          .number = first_camera_number + i,
+          .outdir = outdir,
+          .reader = std::make_unique<VideoCaptureStreamReader>(
+              reader_options, std::move(stream)),
+      });
+    }
+  }
+
+  // With more than one camera, each gets its own directory.
+  if (cameras.size() > 1) {
+    for (CaptureCamera& camera : cameras) {
+      camera.outdir =
+          JoinPath({outdir, absl::StrFormat("camera_%d", camera.number)});
+      MakeDirOrDie(camera.outdir);
+    }
+  }
 
-  VideoCaptureStreamReader stream_reader(
-      {.verbose = absl::GetFlag(FLAGS_verbose)}, std::move(stream));
-  std::thread stream_reader_thread([&] { stream_reader.Read(); });
+  std::optional<FrameSettler::Options> adaptive_settle;
+  if (const std::string mode = absl::GetFlag(FLAGS_settle_mode);
+      mode == "adaptive") {
+    adaptive_settle = FrameSettler::Options{
+        .detector =
+            {
+                .change_pixels = absl::GetFlag(FLAGS_settle_change_pixels),
+                .stable_frames = absl::GetFlag(FLAGS_settle_stable_frames),
+            },
+        .timeout = settle_time,
+        .min_latency = min_push_latency,
+    };
+  } else {
+    QCHECK_EQ(mode, "fixed") << "invalid --settle_mode";
+    if (settle_time < min_push_latency) {
+      LOG(WARNING) << "raising settle time from " << settle_time << " to "
+                   << min_push_latency << " to cover controller latency";
+      settle_time = min_push_latency;
+    }
+  }
 
-  cv::Mat frame = stream_reader.WaitForFrame();
-  LOG(INFO) << "shape: x=" << frame.cols << " y=" << frame.rows;
+  std::optional<AsyncImageWriter::Options> async_writer;
+  if (const int threads = absl::GetFlag(FLAGS_writer_threads); threads > 0) {
+    async_writer = AsyncImageWriter::Options{
+        .num_threads = threads,
+        .max_queued = absl::GetFlag(FLAGS_writer_queue),
+    };
+  }
 
-  static constexpr char kStreamWindowName[] = "stream";
+  CaptureLatencies latencies;
+  Capturer capturer(
+      {
+          .settle_time = settle_time,
+          .adaptive_settle = adaptive_settle,
+          .async_writer = async_writer,
+          .latencies = &latencies,
+          .display = absl::GetFlag(FLAGS_display),
+          .verbose = absl::GetFlag(FLAGS_verbose),
+      },
+      std::move(cameras));
+  QCHECK_OK(capturer.Start());
 
-  if (absl::GetFlag(FLAGS_display)) {
-    cv::namedWindow(kStreamWindowName, cv::WINDOW_AUTOSIZE);
+  if (capturer.cameras().size() > 1) {
+    std::vector<std::string> dirs;
+    for (const CaptureCamera& camera : capturer.cameras()) {
+      dirs.push_back(camera.outdir);
+    }
+    LOG(INFO) << "camera directories: " << absl::StrJoin(dirs, ",");
   }
 
-  QCHECK_OK(ddp_conn->SetAll(0));
-  absl::SleepFor(settle_time);
-  QCHECK_OK(
-      SaveImage(stream_reader.CurrentFrame(), JoinPath({outdir, "off.jpg"})));
+  const int latency_report_interval =
+      absl::GetFlag(FLAGS_latency_report_interval);
+  int num_captures = 0;
+  auto capture = [&](const std::function<absl::Status()>& push,
+                     const std::string& name, bool expect_change) {
+    absl::StatusOr<std::vector<cv::Mat>> frames =
+        capturer.PushAndCapture(push, name, expect_change);
+    QCHECK_OK(frames);
+    QCHECK_OK(capturer.Save(*frames, name + ".jpg"));
+
+    ++num_captures;
+    if (latency_report_interval > 0 &&
+        num_captures % latency_report_interval == 0) {
+      LOG(INFO) << "latencies after " << num_captures << " captures:\n"
+                << latencies.Summary();
+    }
+    return *frames;
+  };
+
+  // The lights are usually off already, so turning them off may not change
+  // anything.
+  std::vector<cv::Mat> off_images = capture(
+      [&] { return ddp_conn->SetAll(0); }, "off", /*expect_change=*/false);
+  std::vector<cv::Mat> on_images =
+      capture([&] { return ddp_conn->SetAll(0xffffff); }, "on",
+              /*expect_change=*/true);
+
+  if (capture_mode == CaptureMode::kGrayCode) {
+    const int bits = GrayCodeBits(end_pixel + 1);
+    LOG(INFO) << "capturing " << bits << " Gray code bit planes";
+
+    // Indexed by camera, then by bit.
+    std::vector<std::vector<GrayCodePlane>> planes(
+        capturer.cameras().size(), std::vector<GrayCodePlane>(bits));
+    for (int bit = 0; bit < bits; ++bit) {
+      for (const bool inverted : {false, true}) {
+        LOG(INFO) << "bit " << bit << (inverted ? " inverted" : "");
+        std::vector<cv::Mat> frames = capture(
+            [&] {
+              return ddp_conn->SetAll(
+                  MakeGrayCodePattern(num_pixels, start_pixel, end_pixel, bit,
+                                      inverted, 0xff'ff'ff));
+            },
+            absl::StrFormat("gray_%02d_%s", bit, inverted ? "inv" : "norm"),
+            /*expect_change=*/true);
+
+        for (int i = 0; i < static_cast<int>(frames.size()); ++i) {
+          GrayCodePlane& plane = planes[i][bit];
+          (inverted ? plane.inverted : plane.normal) = frames[i];
+        }
+      }
+    }
+
+    proto::PixelRecords records;
+    for (int i = 0; i < static_cast<int>(capturer.cameras().size()); ++i) {
+      DecodeGrayCode(off_images[i], on_images[i], planes[i],
+                     {.first_pixel = start_pixel,
+                      .last_pixel = end_pixel,
+                      .camera_number = capturer.cameras()[i].number,
+                      .verbose = absl::GetFlag(FLAGS_verbose)},
+                     &records);
+    }
+    QCHECK_OK(WriteTextProto(absl::GetFlag(FLAGS_output_coords), records));
+  } else if (capture_mode == CaptureMode::kBatch) {
+    std::vector<int> camera_numbers;
+    for (const CaptureCamera& camera : capturer.cameras()) {
+      camera_numbers.push_back(camera.number);
+    }
+
+    const double min_distance = absl::GetFlag(FLAGS_batch_min_distance);
+    const std::vector<ExpectedPixel> expected = ExpectedPixelsFromRecords(
+        *prior_coords, camera_numbers, start_pixel, end_pixel);
+    const std::vector<std::vector<int>> groups =
+        GroupDisjointPixels(expected, min_distance);
+    LOG(INFO) << "lighting " << expected.size() << " pixels in "
+              << groups.size() << " batches";
+
+    proto::PixelRecords records;
+    for (int i = 0; i < static_cast<int>(groups.size()); ++i) {
+      std::vector<const ExpectedPixel*> group;
+      std::vector<DDPOutput::PixelColor> pixels;
+      for (const int idx : groups[i]) {
+        group.push_back(&expected[idx]);
+        pixels.push_back({.idx = expected[idx].pixel_num, .color = 0xffffff});
+      }
 
-  QCHECK_OK(ddp_conn->SetAll(0xffffff));
-  absl::SleepFor(settle_time);
-  QCHECK_OK(
-      SaveImage(stream_reader.CurrentFrame(), JoinPath({outdir, "on.jpg"})));
+      LOG(INFO) << "batch " << i << ": " << group.size() << " pixels";
+      std::vector<cv::Mat> frames =
+          capture([&] { return ddp_conn->OnlyThese(pixels); },
+                  absl::StrFormat("batch_%03d", i), /*expect_change=*/true);
 
-  for (int i = start_pixel; i <= end_pixel; ++i) {
-    LOG(INFO) << "pixel " << i;
-    QCHECK_OK(ddp_conn->OnlyOne(i, 0xff'ff'ff));
-    absl::SleepFor(settle_time);
+      for (int cam = 0; cam < static_cast<int>(frames.size()); ++cam) {
+        cv::Mat mask(frames[cam].rows, frames[cam].cols, CV_8U,
+                     cv::Scalar::all(255));
+        const std::map<int, cv::Point2i> found = AssignBlobs(
+            group, cam, DetectBlobs(off_images[cam], frames[cam], mask),
+            min_distance / 2);
 
-    cv::Mat image = stream_reader.CurrentFrame();
-    if (absl::GetFlag(FLAGS_display)) {
-      cv::imshow(kStreamWindowName, image);
-      cv::waitKey(1);
+        for (const ExpectedPixel* pixel : group) {
+          std::optional<cv::Point2i> point;
+          if (auto iter = found.find(pixel->pixel_num); iter != found.end()) {
+            point = iter->second;
+          }
+          InsertResult(capturer.cameras()[cam].number, pixel->pixel_num, point,
+                       &records);
+        }
+      }
+    }
+    QCHECK_OK(WriteTextProto(absl::GetFlag(FLAGS_output_coords), records));
+  } else if (capture_mode == CaptureMode::kStream) {
+    std::vector<std::unique_ptr<StreamRecorder>> recorders;
+    for (const CaptureCamera& camera : capturer.cameras()) {
+      auto recorder = StreamRecorder::Create(
+          camera.reader.get(),
+          {
+              .video_path = JoinPath({camera.outdir, "stream.avi"}),
+              .times_path = JoinPath({camera.outdir, "stream_frames.csv"}),
+              .fps = absl::GetFlag(FLAGS_stream_fps),
+          });
+      QCHECK_OK(recorder);
+      recorders.push_back(std::move(*recorder));
+    }
+
+    // Pixels are lit on a fixed schedule rather than after each one settles.
+    // The recordings are matched up with the schedule afterwards. Pushes are
+    // scheduled from the previous deadline rather than from when the last
+    // push happened, so that sleep and send latency don't accumulate.
+    const absl::Duration interval = absl::GetFlag(FLAGS_stream_interval);
+    std::vector<std::string> pushes;
+    absl::Time next_push = absl::Now();
+    auto push = [&](int pixel, const std::function<absl::Status()>& fn,
+                    absl::Duration hold) {
+      absl::SleepFor(next_push - absl::Now());
+      const absl::Time push_time = absl::Now();
+      QCHECK_OK(fn());
+      pushes.push_back(FormatStreamPush({.pixel = pixel, .time = push_time}));
+      next_push += hold;
+    };
+
+    // Dark frames on either side of the pixels give stream_detect its off
+    // image, and let the last pixel's window close.
+    constexpr int kOffIntervals = 10;
+    push(kStreamAllOff, [&] { return ddp_conn->SetAll(0); },
+         kOffIntervals * interval);
+    for (int i = start_pixel; i <= end_pixel; ++i) {
+      LOG(INFO) << "pixel " << i;
+      push(i, [&] { return ddp_conn->OnlyOne(i, 0xff'ff'ff); }, interval);
+    }
+    push(kStreamAllOff, [&] { return ddp_conn->SetAll(0); },
+         kOffIntervals * interval);
+    absl::SleepFor(next_push - absl::Now());
+
+    for (int i = 0; i < static_cast<int>(recorders.size()); ++i) {
+      QCHECK_OK(recorders[i]->Stop());
+      QCHECK_OK(WriteFile(
+          JoinPath({capturer.cameras()[i].outdir, "stream_pushes.csv"}),
+          pushes));
+    }
+    LOG(INFO) << "streamed " << end_pixel - start_pixel + 1 << " pixels";
+  } else if (capture_mode == CaptureMode::kRgb) {
+    constexpr int kColors[] = {0xff'00'00, 0x00'ff'00, 0x00'00'ff};
+    for (int i = start_pixel; i <= end_pixel; i += 3) {
+      std::vector<DDPOutput::PixelColor> pixels;
+      for (int j = 0; j < 3 && i + j <= end_pixel; ++j) {
+        pixels.push_back({.idx = i + j, .color = kColors[j]});
+      }
+
+      LOG(INFO) << "pixels " << i << "-" << i + pixels.size() - 1;
+      capture([&] { return ddp_conn->OnlyThese(pixels); },
+              absl::StrFormat("rgb_%03d", i), /*expect_change=*/true);
+    }
+  } else {
+    std::optional<std::set<int>> only;
+    if (const std::string path = absl::GetFlag(FLAGS_pixels_file);
+        !path.empty()) {
+      absl::StatusOr<std::vector<int>> listed = ReadInts(path);
+      QCHECK_OK(listed) << path;
+      only.emplace(listed->begin(), listed->end());
+    }
+    if (const std::string path = absl::GetFlag(FLAGS_unseen_from);
+        !path.empty()) {
+      auto records = ReadProto<proto::PixelRecords>(path);
+      QCHECK_OK(records);
+
+      std::vector<int> camera_numbers;
+      for (const CaptureCamera& camera : capturer.cameras()) {
+        camera_numbers.push_back(camera.number);
+      }
+      std::set<int> unseen =
+          UnseenPixels(*records, camera_numbers, start_pixel, end_pixel);
+      if (only.has_value()) {
+        std::erase_if(*only, [&](int i) { return !unseen.contains(i); });
+      } else {
+        only = std::move(unseen);
+      }
+    }
+
+    std::vector<int> pixels = SelectPixels(
+        start_pixel, end_pixel, only.has_value() ? &*only : nullptr);
+    if (absl::GetFlag(FLAGS_resume)) {
+      std::vector<std::string> dirs;
+      for (const CaptureCamera& camera : capturer.cameras()) {
+        dirs.push_back(camera.outdir);
+      }
+      auto missing = RemoveCaptured(pixels, dirs, "pixel_%03d.jpg");
+      QCHECK_OK(missing);
+      pixels = std::move(*missing);
+    }
+    if (select_pixels) {
+      LOG(INFO) << "capturing " << pixels.size() << " of "
+                << end_pixel - start_pixel + 1 << " pixels";
+    }
+
+    for (const int i : pixels) {
+      LOG(INFO) << "pixel " << i;
+      capture([&] { return ddp_conn->OnlyOne(i, 0xff'ff'ff); },
+              absl::StrFormat("pixel_%03d", i), /*expect_change=*/true);
     }
-    QCHECK_OK(
-        SaveImage(stream_reader.CurrentFrame(),
-                  JoinPath({outdir, absl::StrFormat("pixel_%03d.jpg", i)})));
   }
 
-  stream_reader.Stop();
-  stream_reader_thread.join();
+  QCHECK_OK(capturer.Flush());
+
+  LOG(INFO) << "latencies after " << num_captures << " captures:\n"
+            << latencies.Summary();
+  const std::string latency_summary = [&]() {
+    const std::string path = absl::GetFlag(FLAGS_latency_summary);
+    return path.empty() ? JoinPath({outdir, "latencies.csv"}) : path;
+  }();
+  QCHECK_OK(latencies.WriteCsv(latency_summary));
+
+  if (simulate) {
+    const DDPReceiver::Stats stats = simulated_controller->stats();
+    LOG(INFO) << "simulated controller received " << stats.frames
+              << " frames in " << stats.packets << " packets ("
+              << stats.dropped_packets << " dropped)";
+    simulated_controller->Stop();
+    simulated_controller_thread.join();
+  }
 
   return 0;
 }
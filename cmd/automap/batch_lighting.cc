@@ -0,0 +1,192 @@
+#include "cmd/automap/batch_lighting.h"
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "cmd/detect/detect.h"
+#include "opencv2/core/types.hpp"
+#include "proto/points.pb.h"
+
+namespace {
+
+double Distance(const cv::Point2i& a, const cv::Point2i& b) {
+  const double dx = a.x - b.x;
+  const double dy = a.y - b.y;
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+// The positions of one group's pixels in one camera, bucketed into square
+// cells min_distance on a side so that only the neighboring cells need to be
+// checked for conflicts.
+class PositionGrid {
+ public:
+  explicit PositionGrid(double min_distance) : min_distance_(min_distance) {}
+
+  bool HasConflict(const cv::Point2i& pos) const {
+    const auto [cx, cy] = Cell(pos);
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        auto iter = cells_.find(Key(cx + dx, cy + dy));
+        if (iter == cells_.end()) {
+          continue;
+        }
+        for (const cv::Point2i& other : iter->second) {
+          if (Distance(pos, other) < min_distance_) {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  void Add(const cv::Point2i& pos) {
+    const auto [cx, cy] = Cell(pos);
+    cells_[Key(cx, cy)].push_back(pos);
+  }
+
+ private:
+  std::pair<int, int> Cell(const cv::Point2i& pos) const {
+    return {static_cast<int>(std::floor(pos.x / min_distance_)),
+            static_cast<int>(std::floor(pos.y / min_distance_))};
+  }
+
+  static int64_t Key(int cx, int cy) {
+    return (static_cast<int64_t>(cx) << 32) ^ static_cast<uint32_t>(cy);
+  }
+
+  const double min_distance_;
+  absl::flat_hash_map<int64_t, std::vector<cv::Point2i>> cells_;
+};
+
+}  // namespace
+
+std::vector<ExpectedPixel> ExpectedPixelsFromRecords(
+    const proto::PixelRecords& records, const std::vector<int>& camera_numbers,
+    int first_pixel, int last_pixel) {
+  std::vector<ExpectedPixel> pixels;
+  for (int i = first_pixel; i <= last_pixel; ++i) {
+    pixels.push_back({
+        .pixel_num = i,
+        .positions = std::vector<std::optional<cv::Point2i>>(
+            camera_numbers.size()),
+    });
+  }
+
+  for (const proto::PixelRecord& record : records.pixel()) {
+    const int pixel_num = record.pixel_number();
+    if (pixel_num < first_pixel || pixel_num > last_pixel) {
+      continue;
+    }
+
+    ExpectedPixel& pixel = pixels[pixel_num - first_pixel];
+    for (const proto::CameraPixelLocation& loc : record.camera_pixel()) {
+      if (!loc.has_pixel_location()) {
+        continue;
+      }
+      for (int i = 0; i < static_cast<int>(camera_numbers.size()); ++i) {
+        if (camera_numbers[i] == loc.camera_number()) {
+          pixel.positions[i] = cv::Point2i(loc.pixel_location().x(),
+                                           loc.pixel_location().y());
+        }
+      }
+    }
+  }
+
+  return pixels;
+}
+
+std::vector<std::vector<int>> GroupDisjointPixels(
+    const std::vector<ExpectedPixel>& pixels, double min_distance) {
+  std::vector<std::vector<int>> groups;
+
+  // Indexed like groups, then by camera.
+  std::vector<std::vector<PositionGrid>> grids;
+
+  for (int i = 0; i < static_cast<int>(pixels.size()); ++i) {
+    const ExpectedPixel& pixel = pixels[i];
+
+    bool known = true;
+    for (const std::optional<cv::Point2i>& pos : pixel.positions) {
+      known = known && pos.has_value();
+    }
+    if (!known) {
+      groups.push_back({i});
+      grids.emplace_back();
+      continue;
+    }
+
+    int group_idx = 0;
+    for (; group_idx < static_cast<int>(groups.size()); ++group_idx) {
+      std::vector<PositionGrid>& group_grids = grids[group_idx];
+      if (group_grids.empty()) {
+        continue;  // a group of one unknown pixel
+      }
+
+      bool conflict = false;
+      for (int c = 0; c < static_cast<int>(pixel.positions.size()); ++c) {
+        conflict = conflict || group_grids[c].HasConflict(*pixel.positions[c]);
+      }
+      if (!conflict) {
+        break;
+      }
+    }
+
+    if (group_idx == static_cast<int>(groups.size())) {
+      groups.emplace_back();
+      grids.emplace_back(pixel.positions.size(), PositionGrid(min_distance));
+    }
+
+    groups[group_idx].push_back(i);
+    for (int c = 0; c < static_cast<int>(pixel.positions.size()); ++c) {
+      grids[group_idx][c].Add(*pixel.positions[c]);
+    }
+  }
+
+  return groups;
+}
+
+std::map<int, cv::Point2i> AssignBlobs(
+    const std::vector<const ExpectedPixel*>& group, int camera_idx,
+    const std::vector<DetectedBlob>& blobs, double max_distance) {
+  // The winning blob for each pixel.
+  std::map<int, const DetectedBlob*> winners;
+
+  for (const DetectedBlob& blob : blobs) {
+    const ExpectedPixel* nearest = nullptr;
+    if (group.size() == 1) {
+      nearest = group.front();
+    } else {
+      double nearest_dist = max_distance;
+      for (const ExpectedPixel* pixel : group) {
+        const std::optional<cv::Point2i>& pos = pixel->positions[camera_idx];
+        if (!pos.has_value()) {
+          continue;
+        }
+        if (const double dist = Distance(blob.centroid, *pos);
+            dist <= nearest_dist) {
+          nearest = pixel;
+          nearest_dist = dist;
+        }
+      }
+    }
+    if (nearest == nullptr) {
+      continue;
+    }
+
+    const DetectedBlob*& winner = winners[nearest->pixel_num];
+    if (winner == nullptr || blob.area > winner->area) {
+      winner = &blob;
+    }
+  }
+
+  std::map<int, cv::Point2i> assignments;
+  for (const auto& [pixel_num, blob] : winners) {
+    assignments[pixel_num] = blob->centroid;
+  }
+  return assignments;
+}
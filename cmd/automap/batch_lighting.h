@@ -0,0 +1,45 @@
+#ifndef _CMD_AUTOMAP_BATCH_LIGHTING_H_
+#define _CMD_AUTOMAP_BATCH_LIGHTING_H_ 1
+
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "cmd/detect/detect.h"
+#include "opencv2/core/types.hpp"
+#include "proto/points.pb.h"
+
+// Where a pixel is expected to appear in each camera, typically from an
+// earlier mapping run.
+struct ExpectedPixel {
+  int pixel_num;
+
+  // Indexed by camera (in capture order). nullopt if the pixel's location in
+  // that camera isn't known.
+  std::vector<std::optional<cv::Point2i>> positions;
+};
+
+// Returns the expected positions of pixels [first_pixel, last_pixel] in the
+// given cameras, from a PixelRecords proto. Pixels missing from the records
+// have no positions.
+std::vector<ExpectedPixel> ExpectedPixelsFromRecords(
+    const proto::PixelRecords& records, const std::vector<int>& camera_numbers,
+    int first_pixel, int last_pixel);
+
+// Greedily splits pixels into groups that can be lit together: within a
+// group, every pair of pixels is at least min_distance apart in every camera.
+// Pixels without a known position in every camera are put in groups of their
+// own. Returns indices into `pixels`.
+std::vector<std::vector<int>> GroupDisjointPixels(
+    const std::vector<ExpectedPixel>& pixels, double min_distance);
+
+// Assigns blobs found by one camera in a group's frame to the group's pixels.
+// Each blob goes to the pixel whose expected position is nearest, if it's
+// within max_distance; if several blobs go to one pixel, the largest wins.
+// In a group of one, the largest blob goes to the pixel regardless of where
+// it is. Returns positions keyed by pixel number.
+std::map<int, cv::Point2i> AssignBlobs(
+    const std::vector<const ExpectedPixel*>& group, int camera_idx,
+    const std::vector<DetectedBlob>& blobs, double max_distance);
+
+#endif  // _CMD_AUTOMAP_BATCH_LIGHTING_H_
@@ -0,0 +1,124 @@
+#include "cmd/automap/batch_lighting.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/testing/cv.h"
+#include "lib/testing/proto.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+
+ExpectedPixel Pixel(int num, std::vector<std::optional<cv::Point2i>> pos) {
+  return {.pixel_num = num, .positions = pos};
+}
+
+TEST(ExpectedPixelsFromRecordsTest, Test) {
+  const auto records = ParseTextProtoOrDie<proto::PixelRecords>(R"pb(
+    pixel {
+      pixel_number: 1
+      camera_pixel {
+        camera_number: 2
+        pixel_location { x: 10 y: 20 }
+      }
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 30 y: 40 }
+      }
+    }
+    pixel {
+      pixel_number: 2
+      camera_pixel { camera_number: 1 }
+    }
+    pixel {
+      pixel_number: 5
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 1 y: 1 }
+      }
+    }
+  )pb");
+
+  std::vector<ExpectedPixel> pixels =
+      ExpectedPixelsFromRecords(records, {1, 2}, 1, 3);
+  ASSERT_EQ(pixels.size(), 3);
+
+  EXPECT_EQ(pixels[0].pixel_num, 1);
+  ASSERT_EQ(pixels[0].positions.size(), 2);
+  EXPECT_THAT(*pixels[0].positions[0], CvPointEq(cv::Point2i(30, 40)));
+  EXPECT_THAT(*pixels[0].positions[1], CvPointEq(cv::Point2i(10, 20)));
+
+  EXPECT_EQ(pixels[1].pixel_num, 2);
+  EXPECT_FALSE(pixels[1].positions[0].has_value());
+  EXPECT_FALSE(pixels[1].positions[1].has_value());
+
+  EXPECT_EQ(pixels[2].pixel_num, 3);
+}
+
+TEST(GroupDisjointPixelsTest, OneCamera) {
+  const std::vector<ExpectedPixel> pixels = {
+      Pixel(0, {cv::Point2i(0, 0)}),     //
+      Pixel(1, {cv::Point2i(5, 0)}),     // too close to 0
+      Pixel(2, {cv::Point2i(10, 0)}),    //
+      Pixel(3, {cv::Point2i(100, 0)}),   //
+      Pixel(4, {std::nullopt}),          // unknown
+      Pixel(5, {cv::Point2i(105, 50)}),  //
+  };
+
+  EXPECT_THAT(GroupDisjointPixels(pixels, 10),
+              ElementsAre(ElementsAre(0, 2, 3, 5), ElementsAre(1),
+                          ElementsAre(4)));
+  EXPECT_THAT(GroupDisjointPixels(pixels, 11),
+              ElementsAre(ElementsAre(0, 3, 5), ElementsAre(1),
+                          ElementsAre(2), ElementsAre(4)));
+}
+
+TEST(GroupDisjointPixelsTest, TwoCameras) {
+  // Pixels 0 and 1 are far apart in camera 0 but close in camera 1.
+  const std::vector<ExpectedPixel> pixels = {
+      Pixel(0, {cv::Point2i(0, 0), cv::Point2i(50, 50)}),
+      Pixel(1, {cv::Point2i(100, 100), cv::Point2i(52, 50)}),
+      Pixel(2, {cv::Point2i(200, 200), cv::Point2i(200, 200)}),
+      Pixel(3, {cv::Point2i(300, 300), std::nullopt}),
+  };
+
+  EXPECT_THAT(GroupDisjointPixels(pixels, 10),
+              ElementsAre(ElementsAre(0, 2), ElementsAre(1), ElementsAre(3)));
+}
+
+TEST(AssignBlobsTest, Nearest) {
+  const ExpectedPixel p0 = Pixel(10, {cv::Point2i(0, 0)});
+  const ExpectedPixel p1 = Pixel(11, {cv::Point2i(100, 0)});
+  const ExpectedPixel p2 = Pixel(12, {cv::Point2i(200, 0)});
+
+  const std::vector<DetectedBlob> blobs = {
+      {.centroid = cv::Point(3, 4), .area = 10},
+      {.centroid = cv::Point(95, 0), .area = 10},
+      {.centroid = cv::Point(105, 0), .area = 20},  // bigger, so wins
+      {.centroid = cv::Point(150, 0), .area = 50},  // too far from anything
+  };
+
+  EXPECT_THAT(AssignBlobs({&p0, &p1, &p2}, 0, blobs, 20),
+              UnorderedElementsAre(Pair(10, CvPointEq(cv::Point2i(3, 4))),
+                                   Pair(11, CvPointEq(cv::Point2i(105, 0)))));
+}
+
+TEST(AssignBlobsTest, Single) {
+  const ExpectedPixel p0 = Pixel(10, {std::nullopt});
+
+  const std::vector<DetectedBlob> blobs = {
+      {.centroid = cv::Point(500, 500), .area = 10},
+      {.centroid = cv::Point(600, 600), .area = 20},
+  };
+
+  EXPECT_THAT(AssignBlobs({&p0}, 0, blobs, 20),
+              ElementsAre(Pair(10, CvPointEq(cv::Point2i(600, 600)))));
+  EXPECT_THAT(AssignBlobs({&p0}, 0, {}, 20), IsEmpty());
+}
+
+}  // namespace
@@ -0,0 +1,204 @@
+#include "cmd/automap/capture.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/settle.h"
+#include "cmd/automap/stream_reader.h"
+#include "lib/file/path.h"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/opencv.hpp"
+
+namespace {
+
+// How long to wait for a camera to deliver a frame.
+constexpr absl::Duration kMaxFrameWait = absl::Seconds(2);
+
+}  // namespace
+
+Capturer::Capturer(const Options& options, std::vector<CaptureCamera> cameras)
+    : options_(options), cameras_(std::move(cameras)) {
+  if (options_.adaptive_settle.has_value()) {
+    settler_.emplace(*options_.adaptive_settle);
+  }
+  if (options_.async_writer.has_value()) {
+    AsyncImageWriter::Options writer_options = *options_.async_writer;
+    writer_options.encode_latency = Histogram(CaptureStage::kEncode);
+    writer_options.write_latency = Histogram(CaptureStage::kWrite);
+    writer_ = std::make_unique<AsyncImageWriter>(writer_options);
+  }
+
+  for (CaptureCamera& camera : cameras_) {
+    StreamReader* reader = camera.reader.get();
+    reader_threads_.emplace_back([reader] { reader->Read(); });
+  }
+}
+
+Capturer::~Capturer() {
+  for (CaptureCamera& camera : cameras_) {
+    camera.reader->Stop();
+  }
+  for (std::thread& thread : reader_threads_) {
+    thread.join();
+  }
+}
+
+absl::Status Capturer::Start() {
+  for (CaptureCamera& camera : cameras_) {
+    cv::Mat frame = camera.reader->WaitForFrame();
+    if (frame.empty()) {
+      return absl::UnavailableError(
+          absl::StrCat("no frames from camera ", camera.number));
+    }
+    LOG(INFO) << "camera " << camera.number << " shape: x=" << frame.cols
+              << " y=" << frame.rows;
+    last_frames_.push_back(frame);
+
+    if (settler_.has_value()) {
+      const std::string path = JoinPath({camera.outdir, "settle_times"});
+      auto log = std::make_unique<std::ofstream>(path);
+      if (!log->good()) {
+        return absl::UnknownError(absl::StrCat("failed to open ", path));
+      }
+      settle_logs_.push_back(std::move(log));
+    }
+
+    window_names_.push_back(absl::StrCat("camera ", camera.number));
+    if (options_.display) {
+      cv::namedWindow(window_names_.back(), cv::WINDOW_AUTOSIZE);
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<cv::Mat>> Capturer::PushAndCapture(
+    const std::function<absl::Status()>& push, const std::string& label,
+    bool expect_change) {
+  const absl::Time push_time = absl::Now();
+  if (absl::Status status = push(); !status.ok()) {
+    return status;
+  }
+  Record(CaptureStage::kPush, absl::Now() - push_time);
+
+  // Each camera is settled in its own thread. Adaptive settling times out
+  // relative to push_time, so settling them one after another would leave a
+  // slow camera's wait eating into the others' timeouts.
+  std::vector<cv::Mat> frames(cameras_.size());
+  if (cameras_.size() == 1) {
+    frames[0] = Settle(0, push_time, label, expect_change);
+  } else {
+    std::vector<std::thread> settlers;
+    for (int i = 0; i < static_cast<int>(cameras_.size()); ++i) {
+      settlers.emplace_back([this, i, push_time, &label, expect_change,
+                             &frames] {
+        frames[i] = Settle(i, push_time, label, expect_change);
+      });
+    }
+    for (std::thread& settler : settlers) {
+      settler.join();
+    }
+  }
+
+  if (options_.display) {
+    const absl::Time start = absl::Now();
+    for (int i = 0; i < static_cast<int>(cameras_.size()); ++i) {
+      cv::imshow(window_names_[i], frames[i]);
+    }
+    cv::waitKey(1);
+    Record(CaptureStage::kDisplay, absl::Now() - start);
+  }
+
+  return frames;
+}
+
+cv::Mat Capturer::Settle(int idx, absl::Time push_time,
+                         const std::string& label, bool expect_change) {
+  StreamReader& reader = *cameras_[idx].reader;
+  cv::Mat& last_frame = last_frames_[idx];
+
+  if (!settler_.has_value()) {
+    const absl::Time settled = push_time + options_.settle_time;
+    const absl::Time start = absl::Now();
+    absl::SleepFor(settled - start);
+    const absl::Time slept = absl::Now();
+    Record(CaptureStage::kSettle, slept - start);
+
+    // Make sure the frame was captured after the settle time rather than
+    // buffered from before it.
+    auto frame =
+        reader.WaitForFrameAfter(settled, absl::Now() + kMaxFrameWait);
+    Record(CaptureStage::kAcquire, absl::Now() - slept);
+    if (frame.has_value()) {
+      last_frame = frame->value;
+    } else {
+      LOG(WARNING) << "camera " << cameras_[idx].number
+                   << ": no frame captured after settle time for " << label;
+      last_frame = reader.CurrentFrame();
+    }
+    return last_frame;
+  }
+
+  // The settler acquires frames as it goes, so there's no separate
+  // acquisition step to measure.
+  const absl::Time start = absl::Now();
+  SettleResult result =
+      settler_->Wait(reader, last_frame, push_time, expect_change);
+  Record(CaptureStage::kSettle, absl::Now() - start);
+  LOG_IF(INFO, options_.verbose) << "camera " << cameras_[idx].number << ": "
+                                 << label << " settled in " << result.latency;
+  *settle_logs_[idx] << label << " "
+                     << absl::ToInt64Milliseconds(result.latency)
+                     << (result.settled ? "" : " timeout") << "\n";
+  last_frame = result.frame;
+  return last_frame;
+}
+
+absl::Status Capturer::Save(const std::vector<cv::Mat>& frames,
+                            const std::string& filename) {
+  for (int i = 0; i < static_cast<int>(cameras_.size()); ++i) {
+    const std::string path = JoinPath({cameras_[i].outdir, filename});
+    if (writer_ != nullptr) {
+      if (absl::Status status = writer_->Write(frames[i], path); !status.ok()) {
+        return status;
+      }
+      continue;
+    }
+    if (absl::Status status =
+            WriteImage(frames[i], path, Histogram(CaptureStage::kEncode),
+                       Histogram(CaptureStage::kWrite));
+        !status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Capturer::Flush() {
+  if (writer_ == nullptr) {
+    return absl::OkStatus();
+  }
+  return writer_->Flush();
+}
+
+void Capturer::Record(CaptureStage stage, absl::Duration latency) {
+  if (LatencyHistogram* histogram = Histogram(stage); histogram != nullptr) {
+    histogram->Record(latency);
+  }
+}
+
+LatencyHistogram* Capturer::Histogram(CaptureStage stage) {
+  if (options_.latencies == nullptr) {
+    return nullptr;
+  }
+  return &options_.latencies->stage(stage);
+}
@@ -0,0 +1,100 @@
+#ifndef _CMD_AUTOMAP_CAPTURE_H_
+#define _CMD_AUTOMAP_CAPTURE_H_ 1
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "cmd/automap/image_writer.h"
+#include "cmd/automap/latency.h"
+#include "cmd/automap/settle.h"
+#include "cmd/automap/stream_reader.h"
+#include "opencv2/core/mat.hpp"
+
+// A camera taking part in a capture run. Its images are written to outdir,
+// laid out as showfound's --camera_dirs expects.
+struct CaptureCamera {
+  int number;
+  std::string outdir;
+  std::unique_ptr<StreamReader> reader;
+};
+
+// Drives the push/settle/capture cycle for any number of cameras watching the
+// same lights. Each camera's StreamReader runs in its own thread, and every
+// push yields one frame per camera.
+class Capturer {
+ public:
+  struct Options {
+    // Fixed settle time, or the upper bound in adaptive mode.
+    absl::Duration settle_time;
+
+    // Set to settle adaptively rather than sleeping for settle_time.
+    std::optional<FrameSettler::Options> adaptive_settle;
+
+    // Set to encode and write images in the background rather than in Save.
+    std::optional<AsyncImageWriter::Options> async_writer;
+
+    // If non-null, receives the time spent in each stage of every capture.
+    // Must outlive the Capturer.
+    CaptureLatencies* latencies = nullptr;
+
+    bool display = false;
+    bool verbose = false;
+  };
+
+  Capturer(const Options& options, std::vector<CaptureCamera> cameras);
+  ~Capturer();
+
+  // Waits for every camera to deliver its first frame, and prepares the
+  // settle logs and display windows.
+  absl::Status Start();
+
+  // Calls `push` to change the lights, waits for them to settle, and returns
+  // one frame per camera (in camera order). `label` identifies the push in
+  // logs. Adaptive settling waits for the frame to change first unless
+  // `expect_change` is false.
+  absl::StatusOr<std::vector<cv::Mat>> PushAndCapture(
+      const std::function<absl::Status()>& push, const std::string& label,
+      bool expect_change);
+
+  // Writes frames[i] to `filename` in camera i's output directory. With an
+  // async writer, the write may not have happened (or failed) when Save
+  // returns; call Flush to wait for it.
+  absl::Status Save(const std::vector<cv::Mat>& frames,
+                    const std::string& filename);
+
+  // Waits for every saved frame to be written.
+  absl::Status Flush();
+
+  const std::vector<CaptureCamera>& cameras() const { return cameras_; }
+
+ private:
+  // Waits for camera idx to settle after a push. Called concurrently for
+  // different cameras, so it only touches camera idx's state.
+  cv::Mat Settle(int idx, absl::Time push_time, const std::string& label,
+                 bool expect_change);
+
+  // Records `latency` for `stage` if latencies are being kept.
+  void Record(CaptureStage stage, absl::Duration latency);
+  LatencyHistogram* Histogram(CaptureStage stage);
+
+  const Options options_;
+  std::vector<CaptureCamera> cameras_;
+  std::vector<std::thread> reader_threads_;
+  std::optional<FrameSettler> settler_;
+  std::unique_ptr<AsyncImageWriter> writer_;
+
+  // Per-camera state, indexed like cameras_.
+  std::vector<cv::Mat> last_frames_;
+  std::vector<std::unique_ptr<std::ofstream>> settle_logs_;
+  std::vector<std::string> window_names_;
+};
+
+#endif  // _CMD_AUTOMAP_CAPTURE_H_
@@ -1,18 +1,27 @@
 #include "cmd/automap/ddp.h"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/cleanup/cleanup.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/time/clock.h"
 
 absl::StatusOr<std::unique_ptr<DDPConn>> DDPConn::Create(
     const std::string& hostname, int port, const Options& options) {
@@ -42,109 +51,350 @@ absl::StatusOr<std::unique_ptr<DDPConn>> DDPConn::Create(
     return absl::ErrnoToStatus(s, "failed to create socket");
   }
 
-  return std::unique_ptr<DDPConn>(new DDPConn(s, std::move(sockaddr), options));
+  if (options.nonblocking) {
+    if (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) < 0) {
+      const int err = errno;
+      close(s);
+      return absl::ErrnoToStatus(err, "failed to make socket nonblocking");
+    }
+  }
+
+  return std::unique_ptr<DDPConn>(
+      new DDPConn(s, hostname, std::move(sockaddr), options));
 }
 
-absl::Status DDPConn::SetAll(int color) {
-  std::vector<char> chans(options_.num_pixels * 3);
-  for (int i = 0; i < options_.num_pixels * 3; i += 3) {
-    chans[i] = color >> 16;
-    chans[i + 1] = (color >> 8) & 0xff;
-    chans[i + 2] = color & 0xff;
+namespace {
+
+// Each packet costs a DDP header plus 28 bytes of UDP/IP header, so it's
+// cheaper to resend a few unchanged channels than to start a new packet.
+constexpr int kDeltaMergeGap = sizeof(DdpHeader) + 28;
+
+std::string PacketToString(const struct msghdr& msg) {
+  std::vector<std::string> out;
+  for (size_t i = 0; i < msg.msg_iovlen; ++i) {
+    const struct iovec& iov = msg.msg_iov[i];
+    for (size_t j = 0; j < iov.iov_len; ++j) {
+      out.push_back(absl::StrFormat(
+          "%02x", static_cast<const unsigned char*>(iov.iov_base)[j]));
+    }
   }
+  return absl::StrJoin(out, " ");
+}
 
-  return SetAll(chans);
+}  // namespace
+
+void DiffChannels(absl::Span<const char> prev, absl::Span<const char> next,
+                  int merge_gap, std::vector<ChannelRange>* ranges) {
+  QCHECK_EQ(prev.size(), next.size());
+
+  const int size = next.size();
+  int i = 0;
+  while (i < size) {
+    // memcmp is much faster than a byte loop over long unchanged stretches,
+    // so skip over them a block at a time.
+    constexpr int kBlock = 64;
+    if (i + kBlock <= size && memcmp(&prev[i], &next[i], kBlock) == 0) {
+      i += kBlock;
+      continue;
+    }
+    if (prev[i] == next[i]) {
+      ++i;
+      continue;
+    }
+
+    int end = i + 1;
+    while (end < size && prev[end] != next[end]) {
+      ++end;
+    }
+
+    if (!ranges->empty()) {
+      ChannelRange& last = ranges->back();
+      if (i - (last.off + last.len) < merge_gap) {
+        last.len = end - last.off;
+        i = end;
+        continue;
+      }
+    }
+    ranges->push_back({.off = i, .len = end - i});
+    i = end;
+  }
 }
 
-absl::Status DDPConn::OnlyOne(int idx, int color) {
-  std::vector<char> chans(options_.num_pixels * 3);
-  idx *= 3;
-  chans[idx++] = color >> 16;
-  chans[idx++] = (color >> 8) & 0xff;
-  chans[idx] = color & 0xff;
+DDPOutput::DDPOutput(int num_pixels, bool delta_updates,
+                     int full_frame_interval)
+    : delta_updates_(delta_updates),
+      full_frame_interval_(full_frame_interval),
+      num_frames_(0),
+      chans_(num_pixels * 3) {}
+
+absl::Status DDPOutput::SetAll(int color) {
+  for (int i = 0; i < static_cast<int>(chans_.size()); i += 3) {
+    chans_[i] = color >> 16;
+    chans_[i + 1] = (color >> 8) & 0xff;
+    chans_[i + 2] = color & 0xff;
+  }
 
-  return SetAll(chans);
+  return Send();
 }
 
-absl::Status DDPConn::SetAll(const std::vector<char>& chans) {
-  absl::Span<const char> span(chans);
-  int packet_num = 0, off = 0;
-  while (!span.empty()) {
-    ++packet_num;
-    absl::Span<const char> packet_span =
-        span.subspan(0, options_.max_chans_per_packet);
-    span.remove_prefix(packet_span.size());
-    const bool last = span.empty();
+absl::Status DDPOutput::OnlyOne(int idx, int color) {
+  return OnlyThese({{.idx = idx, .color = color}});
+}
 
-    std::vector<unsigned char> packet = MakePacket(packet_span, off, last);
-    absl::Status status = SendPacket(packet);
-    if (!status.ok()) {
-      return status;
-    }
+absl::Status DDPOutput::OnlyThese(absl::Span<const PixelColor> pixels) {
+  std::fill(chans_.begin(), chans_.end(), 0);
+  for (const PixelColor& pixel : pixels) {
+    int idx = pixel.idx * 3;
+    chans_[idx++] = pixel.color >> 16;
+    chans_[idx++] = (pixel.color >> 8) & 0xff;
+    chans_[idx] = pixel.color & 0xff;
+  }
+
+  return Send();
+}
 
-    off += packet_span.size();
+absl::Status DDPOutput::Send() {
+  ++num_frames_;
+  if (!delta_updates_ ||
+      (full_frame_interval_ > 0 && num_frames_ % full_frame_interval_ == 0)) {
+    return SetAll(chans_);
   }
+  return Update(chans_);
+}
 
-  return absl::OkStatus();
+DDPConn::DDPConn(int sock, const std::string& hostname,
+                 std::unique_ptr<struct sockaddr_in> addr,
+                 const Options& options)
+    : DDPOutput(options.num_pixels, options.delta_updates,
+                options.full_frame_interval),
+      sock_(sock),
+      hostname_(hostname),
+      addr_(std::move(addr)),
+      options_(options),
+      seq_(1),
+      has_shadow_(false),
+      num_pending_(0),
+      num_sent_(0) {
+  ReservePackets((options_.num_pixels * 3 + options_.max_chans_per_packet - 1) /
+                 options_.max_chans_per_packet);
+  shadow_.reserve(options_.num_pixels * 3);
 }
 
-namespace {
+absl::Status DDPConn::SetAll(absl::Span<const char> chans) {
+  Queue(chans, /*delta=*/false);
+  return Flush();
+}
 
-struct DdpHeader {
-  unsigned char flags;
-  unsigned char seq;
-  unsigned char data_type;
-  unsigned char id;
-  uint32_t offset;
-  uint16_t len;
-  unsigned char data[];
-} __attribute__((packed));
+absl::Status DDPConn::Update(absl::Span<const char> chans) {
+  Queue(chans, /*delta=*/true);
+  return Flush();
+}
 
-constexpr unsigned char DDP_FLAGS_VER1 = 0x40;
-constexpr unsigned char DDP_FLAGS_PUSH = 0x01;
+void DDPConn::Queue(absl::Span<const char> chans, bool delta) {
+  ranges_.clear();
+  if (delta && has_shadow_ && shadow_.size() == chans.size()) {
+    DiffChannels(shadow_, chans, kDeltaMergeGap, &ranges_);
+  } else {
+    ranges_.push_back({.off = 0, .len = static_cast<int>(chans.size())});
+    has_shadow_ = false;
+  }
 
-std::string PacketToString(absl::Span<const unsigned char> packet) {
-  std::vector<std::string> out;
-  for (const unsigned char b : packet) {
-    out.push_back(absl::StrFormat("%02x", b));
+  pending_chans_ = chans;
+  num_pending_ = PreparePackets(chans);
+  num_sent_ = 0;
+
+  if (options_.verbose) {
+    for (int i = 0; i < num_pending_; ++i) {
+      LOG(INFO) << PacketToString(msgs_[i].msg_hdr);
+    }
   }
-  return absl::StrJoin(out, " ");
 }
 
-}  // namespace
+absl::Status DDPConn::Flush() {
+  for (;;) {
+    absl::StatusOr<bool> done = SendPending();
+    if (!done.ok()) {
+      return done.status();
+    }
+    if (*done) {
+      return absl::OkStatus();
+    }
+  }
+}
+
+int DDPConn::PreparePackets(absl::Span<const char> chans) {
+  int num_packets = 0;
+  for (const ChannelRange& range : ranges_) {
+    num_packets += (range.len + options_.max_chans_per_packet - 1) /
+                   options_.max_chans_per_packet;
+  }
+  ReservePackets(num_packets);
+
+  // The iovecs point into chans, which is const only from our side.
+  char* data = const_cast<char*>(chans.data());
+
+  int packet_num = 0;
+  for (const ChannelRange& range : ranges_) {
+    const int range_end = range.off + range.len;
+    for (int off = range.off; off < range_end;
+         off += options_.max_chans_per_packet) {
+      const int len =
+          std::min<int>(options_.max_chans_per_packet, range_end - off);
+      const bool last = packet_num == num_packets - 1;
+
+      DdpHeader* hdr = &headers_[packet_num];
+      FillDdpHeader(last ? DDP_FLAGS_PUSH : 0, GetSeq(),
+                    options_.pixel_offset * 3 + off, len, hdr);
 
-std::vector<unsigned char> DDPConn::MakePacket(absl::Span<const char> chans,
-                                               int off, bool last) {
-  std::vector<unsigned char> packet(sizeof(struct DdpHeader) + chans.size());
-  DdpHeader* hdr = reinterpret_cast<DdpHeader*>(packet.data());
+      struct iovec* iov = &iovecs_[packet_num * 2];
+      iov[0].iov_base = hdr;
+      iov[0].iov_len = sizeof(*hdr);
+      iov[1].iov_base = data + off;
+      iov[1].iov_len = len;
 
-  hdr->flags = DDP_FLAGS_VER1 | (last ? DDP_FLAGS_PUSH : 0);
-  hdr->seq = GetSeq();
-  hdr->data_type = 1;  // What xLights uses
-  hdr->id = 1;
-  hdr->offset = htonl(off);
-  hdr->len = htons(chans.size());
-  memcpy(hdr->data, chans.data(), chans.size());
+      ++packet_num;
+    }
+  }
 
-  return packet;
+  return num_packets;
 }
 
-absl::Status DDPConn::SendPacket(absl::Span<const unsigned char> packet) {
-  LOG_IF(INFO, options_.verbose) << PacketToString(packet);
+void DDPConn::ReservePackets(int num_packets) {
+  if (num_packets <= static_cast<int>(headers_.size())) {
+    return;
+  }
+
+  headers_.resize(num_packets);
+  iovecs_.resize(num_packets * 2);
+  msgs_.resize(num_packets);
+
+  // iovecs_ may have moved, so rebuild every message.
+  for (int i = 0; i < num_packets; ++i) {
+    struct msghdr* msg = &msgs_[i].msg_hdr;
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_name = addr_.get();
+    msg->msg_namelen = sizeof(struct sockaddr_in);
+    msg->msg_iov = &iovecs_[i * 2];
+    msg->msg_iovlen = 2;
+  }
+}
+
+absl::StatusOr<bool> DDPConn::SendPending() {
+  if (ranges_.empty()) {
+    return true;  // Nothing queued
+  }
+
+  while (num_sent_ < num_pending_) {
+#ifdef __linux__
+    // sendmmsg may stop short (e.g. when the socket buffer fills), so keep
+    // going until everything is out.
+    const int n =
+        sendmmsg(sock_, &msgs_[num_sent_], num_pending_ - num_sent_, 0);
+#else
+    const int n = sendmsg(sock_, &msgs_[num_sent_].msg_hdr, 0) < 0 ? -1 : 1;
+#endif
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+      }
 
-  if (sendto(sock_, packet.data(), packet.size(), 0,
-             reinterpret_cast<sockaddr*>(addr_.get()),
-             sizeof(struct sockaddr_in)) < 0) {
-    return absl::ErrnoToStatus(errno, "failed to send packet");
+      // We can't tell which packets made it, so the next update will have
+      // to be a full frame.
+      const int err = errno;
+      has_shadow_ = false;
+      ranges_.clear();
+      return absl::ErrnoToStatus(
+          err, absl::StrCat("failed to send packet to ", hostname_));
+    }
+    num_sent_ += n;
+  }
+
+  if (has_shadow_) {
+    for (const ChannelRange& range : ranges_) {
+      memcpy(&shadow_[range.off], &pending_chans_[range.off], range.len);
+    }
+  } else {
+    shadow_.assign(pending_chans_.begin(), pending_chans_.end());
+    has_shadow_ = true;
   }
+  ranges_.clear();
+  return true;
+}
+
+absl::StatusOr<std::optional<DDPConn::Reply>> DDPConn::Query(
+    unsigned char id, absl::Time deadline) {
+  const int seq = GetSeq();
+  DdpHeader query;
+  FillDdpQueryHeader(seq, id, &query);
+  if (sendto(sock_, &query, sizeof(query), 0,
+             reinterpret_cast<struct sockaddr*>(addr_.get()),
+             sizeof(*addr_)) < 0) {
+    return absl::ErrnoToStatus(
+        errno, absl::StrCat("failed to send query to ", hostname_));
+  }
+
+  char buf[2048];
+  for (;;) {
+    const absl::Duration remaining = deadline - absl::Now();
+    if (remaining <= absl::ZeroDuration()) {
+      return std::nullopt;
+    }
+
+    struct pollfd pfd = {.fd = sock_, .events = POLLIN, .revents = 0};
+    const int timeout_ms =
+        std::max<int64_t>(1, absl::ToInt64Milliseconds(absl::Ceil(
+                                 remaining, absl::Milliseconds(1))));
+    if (int rc = poll(&pfd, 1, timeout_ms); rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return absl::ErrnoToStatus(errno, "poll failed");
+    } else if (rc == 0) {
+      continue;  // timed out; the loop checks the deadline
+    }
+
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    const int n = recvfrom(sock_, buf, sizeof(buf), MSG_DONTWAIT,
+                           reinterpret_cast<struct sockaddr*>(&from),
+                           &from_len);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        continue;
+      }
+      return absl::ErrnoToStatus(
+          errno, absl::StrCat("failed to receive from ", hostname_));
+    }
 
-  return absl::OkStatus();
+    DdpHeader hdr;
+    if (from.sin_addr.s_addr != addr_->sin_addr.s_addr ||
+        n < static_cast<int>(sizeof(hdr))) {
+      continue;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    if ((hdr.flags & 0xc0) != DDP_FLAGS_VER1 ||
+        !(hdr.flags & DDP_FLAGS_REPLY) || hdr.id != id || hdr.seq != seq) {
+      LOG_IF(INFO, options_.verbose)
+          << "ignoring packet from " << hostname_ << " with flags "
+          << static_cast<int>(hdr.flags) << " seq "
+          << static_cast<int>(hdr.seq);
+      continue;
+    }
+
+    const int len =
+        std::min<int>(ntohs(hdr.len), n - static_cast<int>(sizeof(hdr)));
+    return Reply{
+        .id = hdr.id,
+        .seq = hdr.seq,
+        .payload = std::string(buf + sizeof(hdr), len),
+    };
+  }
 }
 
 int DDPConn::GetSeq() {
   int seq = seq_;
   ++seq_;
-  if (seq_ > 15) {
+  if (seq_ > kDdpMaxSeq) {
     seq_ = 1;
   }
   return seq;
@@ -2,49 +2,189 @@
 #define _CMD_AUTOMAP_DDP_H_ 1
 
 #include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "absl/status/statusor.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "cmd/automap/ddp_protocol.h"
 
 constexpr int kDefaultDDPPort = 4048;
 
-class DDPConn {
+// A run of channels [off, off+len).
+struct ChannelRange {
+  int off;
+  int len;
+
+  bool operator==(const ChannelRange& other) const = default;
+};
+
+// Appends to `ranges` the runs of channels that differ between prev and next,
+// which must be the same size. Runs separated by fewer than merge_gap
+// unchanged channels are merged into one.
+void DiffChannels(absl::Span<const char> prev, absl::Span<const char> next,
+                  int merge_gap, std::vector<ChannelRange>* ranges);
+
+// A string of lights driven over DDP, addressed as one run of pixels.
+class DDPOutput {
+ public:
+  virtual ~DDPOutput() = default;
+
+  absl::Status SetAll(int color);
+  absl::Status OnlyOne(int idx, int color);
+
+  // Lights only the given pixels, each in its own color.
+  struct PixelColor {
+    int idx;
+    int color;
+  };
+  absl::Status OnlyThese(absl::Span<const PixelColor> pixels);
+
+  // Sends a full set of channel values (three per pixel).
+  virtual absl::Status SetAll(absl::Span<const char> chans) = 0;
+
+  // Like SetAll, but only sends the channels that differ from the last frame
+  // sent, using the packet offsets to place them. Sends a full frame if
+  // there's no previous frame to compare against (or the previous send
+  // failed), and nothing at all if the frame is unchanged.
+  virtual absl::Status Update(absl::Span<const char> chans) = 0;
+
+ protected:
+  // With delta_updates, SetAll(int) and OnlyOne use Update rather than
+  // sending full frames, except that every full_frame_interval'th frame is
+  // sent in full (if full_frame_interval is nonzero).
+  DDPOutput(int num_pixels, bool delta_updates, int full_frame_interval);
+
+ private:
+  // Sends chans_ in full or as an update.
+  absl::Status Send();
+
+  const bool delta_updates_;
+  const int full_frame_interval_;
+  int num_frames_;
+
+  // Scratch channel buffer for SetAll(int) and OnlyOne.
+  std::vector<char> chans_;
+};
+
+// Sends channel values to a DDP controller. The transmit path doesn't
+// allocate or copy channel data once constructed: each packet is sent as a
+// preallocated header plus a pointer into the caller's channel buffer, and
+// all of a frame's packets go out in a single sendmmsg call (one sendmsg
+// per packet where sendmmsg isn't available).
+class DDPConn : public DDPOutput {
  public:
-  ~DDPConn() { close(sock_); }
+  ~DDPConn() override { close(sock_); }
 
   struct Options {
     int num_pixels;
     int max_chans_per_packet = 1440;
+
+    // Send SetAll(int) and OnlyOne with Update rather than as full frames.
+    bool delta_updates = false;
+
+    // With delta_updates, still send every full_frame_interval'th frame in
+    // full, so that a dropped packet leaves pixels stale for at most that
+    // many frames. 0 to only send the first frame in full.
+    int full_frame_interval = 10;
+
+    // Added to the offset of every packet, for strings that don't start at
+    // the controller's first pixel.
+    int pixel_offset = 0;
+
+    // Use a nonblocking socket. Callers must drive sends with Queue and
+    // SendPending rather than with SetAll and Update.
+    bool nonblocking = false;
+
     bool verbose = false;
   };
 
   static absl::StatusOr<std::unique_ptr<DDPConn>> Create(
       const std::string& hostname, int port, const Options& options);
 
-  absl::Status SetAll(int color);
-  absl::Status OnlyOne(int idx, int color);
+  using DDPOutput::SetAll;
+  absl::Status SetAll(absl::Span<const char> chans) override;
+  absl::Status Update(absl::Span<const char> chans) override;
+
+  // Prepares chans to be sent by SendPending, either as a full frame or
+  // (with delta) as the ranges that changed since the last frame. chans
+  // must remain valid until SendPending finishes.
+  void Queue(absl::Span<const char> chans, bool delta);
+
+  // Sends as many of the queued packets as the socket will take without
+  // blocking. Returns true once all of them have been sent.
+  absl::StatusOr<bool> SendPending();
+
+  // The controller's reply to a query.
+  struct Reply {
+    unsigned char id;
+    int seq;
+    std::string payload;
+  };
+
+  // Asks the controller for the contents of `id` (e.g. DDP_ID_STATUS) and
+  // waits for the reply, which arrives on the same socket. Returns nullopt if
+  // no reply arrives by the deadline. Late replies to earlier queries are
+  // discarded.
+  absl::StatusOr<std::optional<Reply>> Query(unsigned char id,
+                                             absl::Time deadline);
+
+  int fd() const { return sock_; }
+  const std::string& hostname() const { return hostname_; }
 
  private:
-  absl::Status SetAll(const std::vector<char>& chans);
+#ifdef __linux__
+  using Message = struct mmsghdr;
+#else
+  // Sent one at a time with sendmsg.
+  struct Message {
+    struct msghdr msg_hdr;
+  };
+#endif
+
+  DDPConn(int sock, const std::string& hostname,
+          std::unique_ptr<struct sockaddr_in> addr, const Options& options);
 
   int GetSeq();
 
-  std::vector<unsigned char> MakePacket(absl::Span<const char> chans, int off,
-                                        bool last);
-  absl::Status SendPacket(absl::Span<const unsigned char> packet);
+  // Sizes the per-packet buffers for num_packets packets. Only allocates
+  // when a frame needs more packets than any seen before.
+  void ReservePackets(int num_packets);
 
-  DDPConn(int sock, std::unique_ptr<struct sockaddr_in> addr,
-          const Options& options)
-      : sock_(sock), addr_(std::move(addr)), options_(options), seq_(1) {}
+  // Prepares packets for ranges_ of chans, splitting ranges as necessary.
+  // The last packet has PUSH set. Returns the number of packets.
+  int PreparePackets(absl::Span<const char> chans);
+
+  // Sends queued packets until they're all gone.
+  absl::Status Flush();
 
   int sock_;
+  const std::string hostname_;
   std::unique_ptr<struct sockaddr_in> addr_;
   const Options options_;
   int seq_;
+
+  // The last frame successfully sent, for Update.
+  std::vector<char> shadow_;
+  bool has_shadow_;
+
+  // The frame being sent, and the ranges of it being sent.
+  absl::Span<const char> pending_chans_;
+  std::vector<ChannelRange> ranges_;
+  int num_pending_;
+  int num_sent_;
+
+  // Per-packet state. Each packet is two iovecs: its header and its slice of
+  // the channel buffer.
+  std::vector<DdpHeader> headers_;
+  std::vector<struct iovec> iovecs_;
+  std::vector<Message> msgs_;
 };
 
 #endif  // _CMD_AUTOMAP_DDP_H_
@@ -0,0 +1,110 @@
+#include "cmd/automap/ddp_fanout.h"
+
+#include <poll.h>
+
+#include <memory>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp.h"
+#include "cmd/automap/universe.h"
+
+absl::StatusOr<std::unique_ptr<DDPFanout>> DDPFanout::Create(
+    const std::vector<UniverseEntry>& universe, const Options& options) {
+  std::vector<std::unique_ptr<DDPConn>> conns;
+  for (const UniverseEntry& entry : universe) {
+    absl::StatusOr<std::unique_ptr<DDPConn>> conn = DDPConn::Create(
+        entry.host, entry.port,
+        {
+            .num_pixels = entry.num_pixels,
+            .max_chans_per_packet = options.max_chans_per_packet,
+            .pixel_offset = entry.controller_offset,
+            .nonblocking = true,
+            .verbose = options.verbose,
+        });
+    if (!conn.ok()) {
+      return conn.status();
+    }
+    conns.push_back(std::move(*conn));
+  }
+
+  return std::unique_ptr<DDPFanout>(
+      new DDPFanout(universe, std::move(conns), options));
+}
+
+DDPFanout::DDPFanout(const std::vector<UniverseEntry>& universe,
+                     std::vector<std::unique_ptr<DDPConn>> conns,
+                     const Options& options)
+    : DDPOutput(UniverseSize(universe), options.delta_updates,
+                options.full_frame_interval),
+      universe_(universe),
+      conns_(std::move(conns)),
+      options_(options),
+      num_chans_(UniverseSize(universe) * 3) {
+  sending_.reserve(conns_.size());
+  pollfds_.reserve(conns_.size());
+}
+
+absl::Status DDPFanout::SetAll(absl::Span<const char> chans) {
+  return Send(chans, /*delta=*/false);
+}
+
+absl::Status DDPFanout::Update(absl::Span<const char> chans) {
+  return Send(chans, /*delta=*/true);
+}
+
+absl::Status DDPFanout::Send(absl::Span<const char> chans, bool delta) {
+  if (static_cast<int>(chans.size()) != num_chans_) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "got ", chans.size(), " channels; universe has ", num_chans_));
+  }
+
+  sending_.clear();
+  for (int i = 0; i < static_cast<int>(conns_.size()); ++i) {
+    const UniverseEntry& entry = universe_[i];
+    conns_[i]->Queue(chans.subspan(entry.first_pixel * 3, entry.num_pixels * 3),
+                     delta);
+    sending_.push_back(conns_[i].get());
+  }
+
+  const absl::Time deadline = absl::Now() + options_.send_timeout;
+  for (;;) {
+    // Send what we can to each controller, and wait for room on the sockets
+    // of those with packets left over.
+    pollfds_.clear();
+    for (int i = 0; i < static_cast<int>(sending_.size());) {
+      absl::StatusOr<bool> done = sending_[i]->SendPending();
+      if (!done.ok()) {
+        return done.status();
+      }
+      if (*done) {
+        sending_[i] = sending_.back();
+        sending_.pop_back();
+        continue;
+      }
+
+      pollfds_.push_back(
+          {.fd = sending_[i]->fd(), .events = POLLOUT, .revents = 0});
+      ++i;
+    }
+
+    if (sending_.empty()) {
+      return absl::OkStatus();
+    }
+
+    const absl::Duration remaining = deadline - absl::Now();
+    if (remaining <= absl::ZeroDuration()) {
+      return absl::DeadlineExceededError(absl::StrCat(
+          "timed out sending to ", sending_.front()->hostname()));
+    }
+    if (poll(pollfds_.data(), pollfds_.size(),
+             absl::ToInt64Milliseconds(remaining) + 1) < 0 &&
+        errno != EINTR) {
+      return absl::ErrnoToStatus(errno, "poll failed");
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef _CMD_AUTOMAP_DDP_FANOUT_H_
+#define _CMD_AUTOMAP_DDP_FANOUT_H_ 1
+
+#include <poll.h>
+
+#include <memory>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "cmd/automap/ddp.h"
+#include "cmd/automap/universe.h"
+
+// Drives several DDP controllers as one string of pixels, as laid out by a
+// universe map. Each frame is split across the controllers and sent from a
+// single poll loop over their nonblocking sockets, with each controller's
+// packets batched into sendmmsg calls.
+class DDPFanout : public DDPOutput {
+ public:
+  struct Options {
+    int max_chans_per_packet = 1440;
+
+    // Send SetAll(int) and OnlyOne with Update rather than as full frames.
+    bool delta_updates = false;
+
+    // With delta_updates, still send every full_frame_interval'th frame in
+    // full, so that a dropped packet leaves pixels stale for at most that
+    // many frames. 0 to only send the first frame in full.
+    int full_frame_interval = 10;
+
+    // How long to wait for every controller's packets to be sent.
+    absl::Duration send_timeout = absl::Seconds(1);
+
+    bool verbose = false;
+  };
+
+  static absl::StatusOr<std::unique_ptr<DDPFanout>> Create(
+      const std::vector<UniverseEntry>& universe, const Options& options);
+
+  using DDPOutput::SetAll;
+  absl::Status SetAll(absl::Span<const char> chans) override;
+  absl::Status Update(absl::Span<const char> chans) override;
+
+ private:
+  DDPFanout(const std::vector<UniverseEntry>& universe,
+            std::vector<std::unique_ptr<DDPConn>> conns,
+            const Options& options);
+
+  absl::Status Send(absl::Span<const char> chans, bool delta);
+
+  const std::vector<UniverseEntry> universe_;
+  std::vector<std::unique_ptr<DDPConn>> conns_;
+  const Options options_;
+  const int num_chans_;
+
+  // Scratch state for Send: the controllers still sending, and their
+  // sockets.
+  std::vector<DDPConn*> sending_;
+  std::vector<struct pollfd> pollfds_;
+};
+
+#endif  // _CMD_AUTOMAP_DDP_FANOUT_H_
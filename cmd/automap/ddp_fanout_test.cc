@@ -0,0 +1,101 @@
+#include "cmd/automap/ddp_fanout.h"
+
+#include <arpa/inet.h>
+
+#include <memory>
+#include <vector>
+
+#include "cmd/automap/ddp_protocol.h"
+#include "cmd/automap/ddp_testutil.h"
+#include "cmd/automap/universe.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using Packet = DDPTestReceiver::Packet;
+
+class DDPFanoutTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (int i = 0; i < 2; ++i) {
+      auto receiver = DDPTestReceiver::Create();
+      ASSERT_TRUE(receiver.ok()) << receiver.status();
+      receivers_.push_back(std::move(*receiver));
+    }
+
+    // Ten pixels on the first controller, and five on the second starting
+    // at its pixel 20.
+    universe_ = {
+        {.host = "127.0.0.1",
+         .port = receivers_[0]->port(),
+         .first_pixel = 0,
+         .num_pixels = 10,
+         .controller_offset = 0},
+        {.host = "127.0.0.1",
+         .port = receivers_[1]->port(),
+         .first_pixel = 10,
+         .num_pixels = 5,
+         .controller_offset = 20},
+    };
+  }
+
+  Packet Receive(int idx) {
+    absl::StatusOr<Packet> packet = receivers_[idx]->Receive();
+    EXPECT_TRUE(packet.ok()) << packet.status();
+    return packet.ok() ? *packet : Packet{};
+  }
+
+  std::vector<std::unique_ptr<DDPTestReceiver>> receivers_;
+  std::vector<UniverseEntry> universe_;
+};
+
+TEST_F(DDPFanoutTest, SetAll) {
+  auto fanout = DDPFanout::Create(universe_, {});
+  ASSERT_TRUE(fanout.ok()) << fanout.status();
+
+  std::vector<char> chans(45);
+  for (int i = 0; i < 45; ++i) {
+    chans[i] = i;
+  }
+  ASSERT_TRUE((*fanout)->SetAll(chans).ok());
+
+  Packet packet = Receive(0);
+  EXPECT_EQ(packet.hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_PUSH);
+  EXPECT_EQ(ntohl(packet.hdr.offset), 0);
+  EXPECT_EQ(packet.data, std::vector<char>(chans.begin(), chans.begin() + 30));
+
+  packet = Receive(1);
+  EXPECT_EQ(packet.hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_PUSH);
+  EXPECT_EQ(ntohl(packet.hdr.offset), 60);
+  EXPECT_EQ(packet.data, std::vector<char>(chans.begin() + 30, chans.end()));
+}
+
+TEST_F(DDPFanoutTest, OnlyOneDelta) {
+  auto fanout = DDPFanout::Create(universe_, {.delta_updates = true});
+  ASSERT_TRUE(fanout.ok()) << fanout.status();
+
+  ASSERT_TRUE((*fanout)->SetAll(0).ok());
+  Receive(0);
+  Receive(1);
+
+  // Only the second controller's pixels change.
+  ASSERT_TRUE((*fanout)->OnlyOne(12, 0x010203).ok());
+  Packet packet = Receive(1);
+  EXPECT_EQ(ntohl(packet.hdr.offset), (20 + 2) * 3);
+  EXPECT_EQ(packet.data, std::vector<char>({1, 2, 3}));
+
+  // The first controller gets nothing, so this is the next thing it sees.
+  ASSERT_TRUE((*fanout)->OnlyOne(3, 0x040506).ok());
+  packet = Receive(0);
+  EXPECT_EQ(ntohl(packet.hdr.offset), 9);
+  EXPECT_EQ(packet.data, std::vector<char>({4, 5, 6}));
+}
+
+TEST_F(DDPFanoutTest, WrongSize) {
+  auto fanout = DDPFanout::Create(universe_, {});
+  ASSERT_TRUE(fanout.ok()) << fanout.status();
+
+  EXPECT_FALSE((*fanout)->SetAll(std::vector<char>(44)).ok());
+}
+
+}  // namespace
@@ -0,0 +1,68 @@
+#include "cmd/automap/ddp_probe.h"
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp.h"
+#include "cmd/automap/ddp_protocol.h"
+
+absl::StatusOr<DDPProbeResult> ProbeDDPLatency(DDPConn& conn,
+                                               const DDPProbeOptions& options) {
+  DDPProbeResult result;
+  std::vector<absl::Duration> rtts;
+  for (int i = 0; i < options.samples; ++i) {
+    if (i > 0) {
+      absl::SleepFor(options.interval);
+    }
+
+    const absl::Time start = absl::Now();
+    auto reply = conn.Query(DDP_ID_STATUS, start + options.timeout);
+    if (!reply.ok()) {
+      return reply.status();
+    }
+    ++result.sent;
+    if (!reply->has_value()) {
+      continue;
+    }
+
+    rtts.push_back(absl::Now() - start);
+    result.status = (*reply)->payload;
+  }
+
+  result.received = rtts.size();
+  if (!rtts.empty()) {
+    std::sort(rtts.begin(), rtts.end());
+    const int n = rtts.size();
+    result.min = rtts.front();
+    result.median = rtts[n / 2];
+    result.p90 = rtts[std::min(n - 1, n * 9 / 10)];
+    result.max = rtts.back();
+  }
+  return result;
+}
+
+absl::StatusOr<DDPProbeResult> ProbeDDPController(
+    const std::string& hostname, int port, const DDPProbeOptions& options) {
+  auto conn = DDPConn::Create(hostname, port, {.num_pixels = 1});
+  if (!conn.ok()) {
+    return conn.status();
+  }
+  return ProbeDDPLatency(**conn, options);
+}
+
+std::string FormatDDPProbeResult(const DDPProbeResult& result) {
+  const double loss =
+      result.sent == 0 ? 0 : 100.0 * (result.sent - result.received) /
+                                 result.sent;
+  return absl::StrFormat(
+      "%d/%d replies (%.1f%% lost), rtt min %s median %s p90 %s max %s",
+      result.received, result.sent, loss, absl::FormatDuration(result.min),
+      absl::FormatDuration(result.median), absl::FormatDuration(result.p90),
+      absl::FormatDuration(result.max));
+}
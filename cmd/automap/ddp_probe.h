@@ -0,0 +1,46 @@
+#ifndef _CMD_AUTOMAP_DDP_PROBE_H_
+#define _CMD_AUTOMAP_DDP_PROBE_H_ 1
+
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp.h"
+
+// Measures controller round-trip time by sending DDP status queries and
+// timing the replies.
+struct DDPProbeOptions {
+  int samples = 20;
+
+  // How long to wait for each reply before counting it as lost.
+  absl::Duration timeout = absl::Milliseconds(250);
+
+  // Pause between samples, so the probe doesn't flood the controller.
+  absl::Duration interval = absl::Milliseconds(10);
+};
+
+struct DDPProbeResult {
+  int sent = 0;
+  int received = 0;
+
+  // Round-trip times of the replies; zero if there weren't any.
+  absl::Duration min;
+  absl::Duration median;
+  absl::Duration p90;
+  absl::Duration max;
+
+  // The payload of the last status reply.
+  std::string status;
+};
+
+absl::StatusOr<DDPProbeResult> ProbeDDPLatency(DDPConn& conn,
+                                               const DDPProbeOptions& options);
+
+// Like ProbeDDPLatency, using a connection of its own to host:port.
+absl::StatusOr<DDPProbeResult> ProbeDDPController(
+    const std::string& hostname, int port, const DDPProbeOptions& options);
+
+// Returns a one-line summary of a probe result.
+std::string FormatDDPProbeResult(const DDPProbeResult& result);
+
+#endif  // _CMD_AUTOMAP_DDP_PROBE_H_
@@ -0,0 +1,94 @@
+#include "cmd/automap/ddp_probe.h"
+
+#include <memory>
+#include <thread>
+
+#include "absl/time/time.h"
+#include "cmd/automap/ddp.h"
+#include "cmd/automap/ddp_protocol.h"
+#include "cmd/automap/ddp_receiver.h"
+#include "cmd/automap/ddp_testutil.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(DDPProbeTest, Receiver) {
+  auto receiver = DDPReceiver::Create({.num_pixels = 1});
+  ASSERT_TRUE(receiver.ok()) << receiver.status();
+  std::thread thread([&] { (*receiver)->Run(); });
+
+  auto result = ProbeDDPController("127.0.0.1", (*receiver)->port(),
+                                   {.samples = 5,
+                                    .timeout = absl::Seconds(5),
+                                    .interval = absl::ZeroDuration()});
+  (*receiver)->Stop();
+  thread.join();
+
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(result->sent, 5);
+  EXPECT_EQ(result->received, 5);
+  EXPECT_GT(result->min, absl::ZeroDuration());
+  EXPECT_LE(result->min, result->median);
+  EXPECT_LE(result->median, result->p90);
+  EXPECT_LE(result->p90, result->max);
+  EXPECT_THAT(result->status, HasSubstr("ddp_receiver"));
+  EXPECT_THAT(FormatDDPProbeResult(*result), HasSubstr("5/5 replies"));
+
+  EXPECT_EQ((*receiver)->stats().queries, 5);
+}
+
+TEST(DDPProbeTest, NoReplies) {
+  auto receiver = DDPTestReceiver::Create();
+  ASSERT_TRUE(receiver.ok()) << receiver.status();
+
+  auto conn =
+      DDPConn::Create("127.0.0.1", (*receiver)->port(), {.num_pixels = 1});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  auto result = ProbeDDPLatency(**conn, {.samples = 2,
+                                         .timeout = absl::Milliseconds(10),
+                                         .interval = absl::ZeroDuration()});
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(result->sent, 2);
+  EXPECT_EQ(result->received, 0);
+  EXPECT_EQ(result->median, absl::ZeroDuration());
+
+  // The queries went out.
+  for (int seq : {1, 2}) {
+    auto packet = (*receiver)->Receive();
+    ASSERT_TRUE(packet.ok()) << packet.status();
+    EXPECT_EQ(packet->hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_QUERY);
+    EXPECT_EQ(packet->hdr.id, DDP_ID_STATUS);
+    EXPECT_EQ(packet->hdr.seq, seq);
+  }
+}
+
+TEST(DDPProbeTest, IgnoresStaleReplies) {
+  auto receiver = DDPReceiver::Create({.num_pixels = 1});
+  ASSERT_TRUE(receiver.ok()) << receiver.status();
+
+  auto conn =
+      DDPConn::Create("127.0.0.1", (*receiver)->port(), {.num_pixels = 1});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  // Nothing's answering yet, so the first query times out...
+  auto reply = (*conn)->Query(DDP_ID_STATUS, absl::Now());
+  ASSERT_TRUE(reply.ok()) << reply.status();
+  EXPECT_FALSE(reply->has_value());
+
+  // ... and its reply, which shows up once the receiver runs, is skipped in
+  // favor of the second query's.
+  std::thread thread([&] { (*receiver)->Run(); });
+  reply = (*conn)->Query(DDP_ID_STATUS, absl::Now() + absl::Seconds(5));
+  (*receiver)->Stop();
+  thread.join();
+
+  ASSERT_TRUE(reply.ok()) << reply.status();
+  ASSERT_TRUE(reply->has_value());
+  EXPECT_EQ((*reply)->seq, 2);
+}
+
+}  // namespace
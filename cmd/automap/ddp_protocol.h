@@ -0,0 +1,54 @@
+#ifndef _CMD_AUTOMAP_DDP_PROTOCOL_H_
+#define _CMD_AUTOMAP_DDP_PROTOCOL_H_ 1
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+
+// Wire format for the Distributed Display Protocol
+// (http://www.3waylabs.com/ddp/). Multi-byte fields are big-endian.
+struct DdpHeader {
+  unsigned char flags;
+  unsigned char seq;
+  unsigned char data_type;
+  unsigned char id;
+  uint32_t offset;
+  uint16_t len;
+} __attribute__((packed));
+
+static_assert(sizeof(DdpHeader) == 10);
+
+constexpr unsigned char DDP_FLAGS_VER1 = 0x40;
+constexpr unsigned char DDP_FLAGS_REPLY = 0x04;
+constexpr unsigned char DDP_FLAGS_QUERY = 0x02;
+constexpr unsigned char DDP_FLAGS_PUSH = 0x01;
+
+constexpr unsigned char DDP_DATA_TYPE_RGB8 = 1;  // What xLights uses
+constexpr unsigned char DDP_ID_DISPLAY = 1;
+constexpr unsigned char DDP_ID_STATUS = 251;  // JSON status, read-only
+
+// Sequence numbers run from 1 to kDdpMaxSeq; 0 means unused.
+constexpr int kDdpMaxSeq = 15;
+
+inline void FillDdpHeader(unsigned char flags, int seq, uint32_t offset,
+                          uint16_t len, DdpHeader* hdr) {
+  hdr->flags = DDP_FLAGS_VER1 | flags;
+  hdr->seq = seq;
+  hdr->data_type = DDP_DATA_TYPE_RGB8;
+  hdr->id = DDP_ID_DISPLAY;
+  hdr->offset = htonl(offset);
+  hdr->len = htons(len);
+}
+
+// Fills in a header asking for the contents of `id` (e.g. DDP_ID_STATUS). The
+// reply has the REPLY flag set and the same sequence number.
+inline void FillDdpQueryHeader(int seq, unsigned char id, DdpHeader* hdr) {
+  hdr->flags = DDP_FLAGS_VER1 | DDP_FLAGS_QUERY;
+  hdr->seq = seq;
+  hdr->data_type = 0;
+  hdr->id = id;
+  hdr->offset = 0;
+  hdr->len = 0;
+}
+
+#endif  // _CMD_AUTOMAP_DDP_PROTOCOL_H_
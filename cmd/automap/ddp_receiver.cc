@@ -0,0 +1,238 @@
+#include "cmd/automap/ddp_receiver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp_protocol.h"
+
+namespace {
+
+// How often Run checks for Stop.
+constexpr absl::Duration kStopCheckInterval = absl::Milliseconds(100);
+
+// Larger than any DDP packet.
+constexpr int kMaxPacketSize = 2048;
+
+// Returned for DDP_ID_STATUS queries, in the format the DDP spec describes.
+constexpr char kStatusJson[] =
+    R"({"status":{"man":"xmaslights","mod":"ddp_receiver","ver":"1.0"}})";
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<DDPReceiver>> DDPReceiver::Create(
+    const Options& options) {
+  const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    return absl::ErrnoToStatus(errno, "failed to create socket");
+  }
+
+  auto fail = [sock](const char* what) {
+    const int err = errno;
+    close(sock);
+    return absl::ErrnoToStatus(err, what);
+  };
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(options.port);
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    return fail("failed to bind");
+  }
+
+  socklen_t len = sizeof(addr);
+  if (getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+    return fail("getsockname failed");
+  }
+
+  struct timeval timeout = {
+      .tv_sec = 0,
+      .tv_usec = absl::ToInt64Microseconds(kStopCheckInterval),
+  };
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) <
+      0) {
+    return fail("failed to set receive timeout");
+  }
+
+  return std::unique_ptr<DDPReceiver>(
+      new DDPReceiver(sock, ntohs(addr.sin_port), options));
+}
+
+DDPReceiver::DDPReceiver(int sock, int port, const Options& options)
+    : sock_(sock),
+      port_(port),
+      options_(options),
+      stop_(false),
+      pending_(options.num_pixels * 3),
+      last_seq_(0) {}
+
+DDPReceiver::~DDPReceiver() { close(sock_); }
+
+void DDPReceiver::Run() {
+  char buf[kMaxPacketSize];
+  while (!stop_) {
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    const int n = recvfrom(sock_, buf, sizeof(buf), 0,
+                           reinterpret_cast<sockaddr*>(&from), &from_len);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        LOG(ERROR) << "recv failed: " << strerror(errno);
+      }
+      continue;
+    }
+
+    std::optional<std::string> reply =
+        HandlePacket(absl::MakeConstSpan(buf, n), absl::Now());
+    if (reply.has_value() &&
+        sendto(sock_, reply->data(), reply->size(), 0,
+               reinterpret_cast<sockaddr*>(&from), from_len) < 0) {
+      LOG(ERROR) << "failed to send reply: " << strerror(errno);
+    }
+  }
+}
+
+void DDPReceiver::Stop() { stop_ = true; }
+
+std::optional<std::string> DDPReceiver::HandlePacket(
+    absl::Span<const char> packet, absl::Time now) {
+  absl::MutexLock lock(&mu_);
+
+  DdpHeader hdr;
+  if (packet.size() < sizeof(hdr)) {
+    ++stats_.packets;
+    ++stats_.bad_packets;
+    return std::nullopt;
+  }
+  memcpy(&hdr, packet.data(), sizeof(hdr));
+  packet.remove_prefix(sizeof(hdr));
+
+  if ((hdr.flags & 0xc0) != DDP_FLAGS_VER1) {
+    ++stats_.packets;
+    ++stats_.bad_packets;
+    return std::nullopt;
+  }
+
+  // Queries come from their own sequence number stream (or none at all), so
+  // they're kept out of the drop accounting.
+  if (hdr.flags & DDP_FLAGS_QUERY) {
+    ++stats_.queries;
+    return HandleQuery(hdr);
+  }
+  ++stats_.packets;
+
+  // Sequence numbers count 1..kDdpMaxSeq and wrap; 0 means the sender
+  // doesn't use them.
+  if (hdr.seq != 0) {
+    if (last_seq_ != 0) {
+      const int want = last_seq_ % kDdpMaxSeq + 1;
+      stats_.dropped_packets += (hdr.seq - want + kDdpMaxSeq) % kDdpMaxSeq;
+    }
+    last_seq_ = hdr.seq;
+  }
+
+  const uint32_t off = ntohl(hdr.offset);
+  const uint16_t len = ntohs(hdr.len);
+  // Written so that a huge offset can't wrap around and pass.
+  if (len > packet.size() || off > pending_.size() ||
+      len > pending_.size() - off) {
+    LOG_IF(INFO, options_.verbose)
+        << "bad packet: offset " << off << " len " << len << " with "
+        << packet.size() << " bytes";
+    ++stats_.bad_packets;
+    return std::nullopt;
+  }
+  memcpy(&pending_[off], packet.data(), len);
+
+  if (!(hdr.flags & DDP_FLAGS_PUSH)) {
+    return std::nullopt;
+  }
+
+  ++stats_.frames;
+  latest_ = Frame{
+      .chans = pending_,
+      .number = static_cast<uint64_t>(stats_.frames),
+      .received = now,
+  };
+
+  frame_times_.push_back(now);
+  while (frame_times_.front() <= now - absl::Seconds(1)) {
+    frame_times_.pop_front();
+  }
+
+  LOG_IF(INFO, options_.verbose) << "frame " << stats_.frames;
+  return std::nullopt;
+}
+
+std::optional<std::string> DDPReceiver::HandleQuery(const DdpHeader& hdr) {
+  LOG_IF(INFO, options_.verbose)
+      << "query for id " << static_cast<int>(hdr.id) << " seq "
+      << static_cast<int>(hdr.seq);
+  if (hdr.id != DDP_ID_STATUS) {
+    return std::nullopt;
+  }
+
+  const std::string payload = kStatusJson;
+  DdpHeader reply_hdr = {
+      .flags = DDP_FLAGS_VER1 | DDP_FLAGS_REPLY | DDP_FLAGS_PUSH,
+      .seq = hdr.seq,
+      .data_type = 0,
+      .id = DDP_ID_STATUS,
+      .offset = 0,
+      .len = htons(payload.size()),
+  };
+
+  std::string reply(reinterpret_cast<const char*>(&reply_hdr),
+                    sizeof(reply_hdr));
+  reply += payload;
+  return reply;
+}
+
+std::optional<DDPReceiver::Frame> DDPReceiver::LatestFrame() const {
+  absl::MutexLock lock(&mu_);
+  return latest_;
+}
+
+std::optional<DDPReceiver::Frame> DDPReceiver::WaitForFrame(
+    uint64_t after, absl::Time deadline) const {
+  auto has_frame = [this, after]() {
+    mu_.AssertReaderHeld();
+    return latest_.has_value() && latest_->number > after;
+  };
+
+  absl::MutexLock lock(&mu_);
+  if (!mu_.AwaitWithDeadline(absl::Condition(&has_frame), deadline)) {
+    return std::nullopt;
+  }
+  return latest_;
+}
+
+DDPReceiver::Stats DDPReceiver::stats() const {
+  absl::MutexLock lock(&mu_);
+  Stats stats = stats_;
+
+  // frame_times_ is trimmed when frames arrive, so it may include frames
+  // from more than a second ago if they've stopped.
+  const absl::Time now = absl::Now();
+  stats.fps = 0;
+  for (const absl::Time time : frame_times_) {
+    if (time > now - absl::Seconds(1)) {
+      ++stats.fps;
+    }
+  }
+  return stats;
+}
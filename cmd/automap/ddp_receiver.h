@@ -0,0 +1,109 @@
+#ifndef _CMD_AUTOMAP_DDP_RECEIVER_H_
+#define _CMD_AUTOMAP_DDP_RECEIVER_H_ 1
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "cmd/automap/ddp_protocol.h"
+
+// Emulates a DDP controller: receives packets on a UDP port and reassembles
+// them into frames, which are made available to in-process consumers. Status
+// queries are answered, so the emulator can stand in for a controller when
+// probing latency.
+class DDPReceiver {
+ public:
+  struct Options {
+    int num_pixels;
+
+    // The UDP port to listen on, or 0 to pick any free port.
+    int port = 0;
+
+    bool verbose = false;
+  };
+
+  struct Frame {
+    std::vector<char> chans;  // three per pixel
+
+    // Frames are numbered from 1.
+    uint64_t number;
+    absl::Time received;
+  };
+
+  struct Stats {
+    int64_t packets = 0;
+    int64_t frames = 0;
+
+    // Packets missing from the sequence number stream.
+    int64_t dropped_packets = 0;
+
+    // Packets that were too short, weren't DDP, or wrote past the end of the
+    // frame.
+    int64_t bad_packets = 0;
+
+    // Query packets, which aren't counted in packets.
+    int64_t queries = 0;
+
+    // Frames received in the last second.
+    double fps = 0;
+  };
+
+  static absl::StatusOr<std::unique_ptr<DDPReceiver>> Create(
+      const Options& options);
+  ~DDPReceiver();
+
+  int port() const { return port_; }
+
+  // Receives packets until Stop is called. Meant to be run in its own thread.
+  void Run();
+  void Stop();
+
+  // Processes one packet as if it had been received at `now`. Returns the
+  // reply to send to the packet's sender, if it needs one. Used by Run, and
+  // by tests.
+  std::optional<std::string> HandlePacket(absl::Span<const char> packet,
+                                          absl::Time now);
+
+  // Returns the most recent complete frame, if any.
+  std::optional<Frame> LatestFrame() const;
+
+  // Waits for a frame numbered higher than `after`. Returns nullopt if the
+  // deadline passes first.
+  std::optional<Frame> WaitForFrame(uint64_t after, absl::Time deadline) const;
+
+  Stats stats() const;
+
+ private:
+  DDPReceiver(int sock, int port, const Options& options);
+
+  std::optional<std::string> HandleQuery(const DdpHeader& hdr)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int sock_;
+  const int port_;
+  const Options options_;
+  std::atomic<bool> stop_;
+
+  mutable absl::Mutex mu_;
+
+  // The frame being assembled.
+  std::vector<char> pending_ ABSL_GUARDED_BY(mu_);
+  int last_seq_ ABSL_GUARDED_BY(mu_);
+
+  std::optional<Frame> latest_ ABSL_GUARDED_BY(mu_);
+  Stats stats_ ABSL_GUARDED_BY(mu_);
+
+  // When each frame in the last second arrived.
+  std::deque<absl::Time> frame_times_ ABSL_GUARDED_BY(mu_);
+};
+
+#endif  // _CMD_AUTOMAP_DDP_RECEIVER_H_
@@ -0,0 +1,55 @@
+// Emulates a DDP controller, reporting throughput statistics. Useful for
+// exercising send_ddp and automap without real lights.
+
+#include <thread>
+
+#include "absl/debugging/failure_signal_handler.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/check.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp.h"
+#include "cmd/automap/ddp_receiver.h"
+
+ABSL_FLAG(int, port, kDefaultDDPPort, "UDP port to listen on");
+ABSL_FLAG(int, num_pixels, -1, "Number of pixels to emulate");
+ABSL_FLAG(absl::Duration, stats_interval, absl::Seconds(5),
+          "How often to report statistics");
+ABSL_FLAG(bool, verbose, false, "Verbose mode");
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  absl::InitializeLog();
+  absl::InstallFailureSignalHandler(absl::FailureSignalHandlerOptions());
+
+  QCHECK_NE(absl::GetFlag(FLAGS_num_pixels), -1) << "--num_pixels is required";
+  QCHECK_GT(absl::GetFlag(FLAGS_num_pixels), 0) << "invalid number of pixels";
+
+  auto receiver = DDPReceiver::Create({
+      .num_pixels = absl::GetFlag(FLAGS_num_pixels),
+      .port = absl::GetFlag(FLAGS_port),
+      .verbose = absl::GetFlag(FLAGS_verbose),
+  });
+  QCHECK_OK(receiver);
+  LOG(INFO) << "listening on port " << (*receiver)->port();
+
+  std::thread thread([&] { (*receiver)->Run(); });
+
+  DDPReceiver::Stats last;
+  for (;;) {
+    absl::SleepFor(absl::GetFlag(FLAGS_stats_interval));
+
+    const DDPReceiver::Stats stats = (*receiver)->stats();
+    LOG(INFO) << "packets " << stats.packets << " (+"
+              << stats.packets - last.packets << ") frames " << stats.frames
+              << " (+" << stats.frames - last.frames << ") dropped "
+              << stats.dropped_packets << " bad " << stats.bad_packets
+              << " fps " << stats.fps;
+    last = stats;
+  }
+
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include "cmd/automap/ddp_receiver.h"
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp.h"
+#include "cmd/automap/ddp_protocol.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::vector<char> MakePacket(unsigned char flags, int seq, uint32_t off,
+                             const std::vector<char>& data) {
+  std::vector<char> packet(sizeof(DdpHeader) + data.size());
+  FillDdpHeader(flags, seq, off, data.size(),
+                reinterpret_cast<DdpHeader*>(packet.data()));
+  memcpy(packet.data() + sizeof(DdpHeader), data.data(), data.size());
+  return packet;
+}
+
+std::unique_ptr<DDPReceiver> MakeReceiver(int num_pixels) {
+  auto receiver = DDPReceiver::Create({.num_pixels = num_pixels});
+  EXPECT_TRUE(receiver.ok()) << receiver.status();
+  return receiver.ok() ? std::move(*receiver) : nullptr;
+}
+
+TEST(DDPReceiverTest, Reassemble) {
+  std::unique_ptr<DDPReceiver> receiver = MakeReceiver(2);
+  ASSERT_NE(receiver, nullptr);
+  const absl::Time now = absl::Now();
+
+  receiver->HandlePacket(MakePacket(0, 1, 3, {4, 5, 6}), now);
+  EXPECT_FALSE(receiver->LatestFrame().has_value());
+
+  receiver->HandlePacket(MakePacket(DDP_FLAGS_PUSH, 2, 0, {1, 2, 3}), now);
+  std::optional<DDPReceiver::Frame> frame = receiver->LatestFrame();
+  ASSERT_TRUE(frame.has_value());
+  EXPECT_EQ(frame->chans, std::vector<char>({1, 2, 3, 4, 5, 6}));
+  EXPECT_EQ(frame->number, 1);
+  EXPECT_EQ(frame->received, now);
+
+  // Later frames only overwrite what they send.
+  receiver->HandlePacket(MakePacket(DDP_FLAGS_PUSH, 3, 4, {9}), now);
+  frame = receiver->LatestFrame();
+  ASSERT_TRUE(frame.has_value());
+  EXPECT_EQ(frame->chans, std::vector<char>({1, 2, 3, 4, 9, 6}));
+  EXPECT_EQ(frame->number, 2);
+
+  DDPReceiver::Stats stats = receiver->stats();
+  EXPECT_EQ(stats.packets, 3);
+  EXPECT_EQ(stats.frames, 2);
+  EXPECT_EQ(stats.dropped_packets, 0);
+  EXPECT_EQ(stats.bad_packets, 0);
+}
+
+TEST(DDPReceiverTest, BadPackets) {
+  std::unique_ptr<DDPReceiver> receiver = MakeReceiver(2);
+  ASSERT_NE(receiver, nullptr);
+  const absl::Time now = absl::Now();
+
+  receiver->HandlePacket(std::vector<char>(3), now);  // short
+  receiver->HandlePacket(MakePacket(DDP_FLAGS_PUSH, 0, 4, {1, 2, 3}), now);
+
+  std::vector<char> truncated = MakePacket(DDP_FLAGS_PUSH, 0, 0, {1, 2, 3});
+  truncated.pop_back();
+  receiver->HandlePacket(truncated, now);
+
+  std::vector<char> not_ddp = MakePacket(DDP_FLAGS_PUSH, 0, 0, {1});
+  not_ddp[0] = DDP_FLAGS_PUSH;
+  receiver->HandlePacket(not_ddp, now);
+
+  EXPECT_FALSE(receiver->LatestFrame().has_value());
+  EXPECT_EQ(receiver->stats().bad_packets, 4);
+}
+
+TEST(DDPReceiverTest, WrappingOffset) {
+  std::unique_ptr<DDPReceiver> receiver = MakeReceiver(8);
+  ASSERT_NE(receiver, nullptr);
+  const absl::Time now = absl::Now();
+
+  // The end of this packet wraps around to 8 in 32 bits, which is within
+  // the 24 channels.
+  receiver->HandlePacket(
+      MakePacket(DDP_FLAGS_PUSH, 0, 0xfffffff8, std::vector<char>(16, 1)),
+      now);
+
+  EXPECT_FALSE(receiver->LatestFrame().has_value());
+  EXPECT_EQ(receiver->stats().bad_packets, 1);
+}
+
+TEST(DDPReceiverTest, Sequence) {
+  std::unique_ptr<DDPReceiver> receiver = MakeReceiver(1);
+  ASSERT_NE(receiver, nullptr);
+  const absl::Time now = absl::Now();
+
+  // 1..15 then wrapping to 1 loses nothing.
+  for (int seq = 1; seq <= kDdpMaxSeq; ++seq) {
+    receiver->HandlePacket(MakePacket(0, seq, 0, {0}), now);
+  }
+  receiver->HandlePacket(MakePacket(0, 1, 0, {0}), now);
+  EXPECT_EQ(receiver->stats().dropped_packets, 0);
+
+  // Skipping 2 and 3 loses two.
+  receiver->HandlePacket(MakePacket(0, 4, 0, {0}), now);
+  EXPECT_EQ(receiver->stats().dropped_packets, 2);
+
+  // As does skipping 15 and 1 across the wrap.
+  receiver->HandlePacket(MakePacket(0, 14, 0, {0}), now);
+  EXPECT_EQ(receiver->stats().dropped_packets, 2 + 9);
+  receiver->HandlePacket(MakePacket(0, 2, 0, {0}), now);
+  EXPECT_EQ(receiver->stats().dropped_packets, 2 + 9 + 2);
+
+  // Sequence number 0 isn't counted.
+  receiver->HandlePacket(MakePacket(0, 0, 0, {0}), now);
+  receiver->HandlePacket(MakePacket(0, 3, 0, {0}), now);
+  EXPECT_EQ(receiver->stats().dropped_packets, 2 + 9 + 2);
+}
+
+TEST(DDPReceiverTest, Query) {
+  std::unique_ptr<DDPReceiver> receiver = MakeReceiver(1);
+  ASSERT_NE(receiver, nullptr);
+  const absl::Time now = absl::Now();
+
+  std::vector<char> query(sizeof(DdpHeader));
+  FillDdpQueryHeader(7, DDP_ID_STATUS, reinterpret_cast<DdpHeader*>(&query[0]));
+  std::optional<std::string> reply = receiver->HandlePacket(query, now);
+  ASSERT_TRUE(reply.has_value());
+  ASSERT_GT(reply->size(), sizeof(DdpHeader));
+
+  DdpHeader hdr;
+  memcpy(&hdr, reply->data(), sizeof(hdr));
+  EXPECT_EQ(hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_REPLY | DDP_FLAGS_PUSH);
+  EXPECT_EQ(hdr.seq, 7);
+  EXPECT_EQ(hdr.id, DDP_ID_STATUS);
+  EXPECT_EQ(ntohs(hdr.len), reply->size() - sizeof(hdr));
+  EXPECT_EQ(reply->substr(sizeof(hdr), 10), R"({"status":)");
+
+  // Only status queries are answered.
+  FillDdpQueryHeader(8, DDP_ID_DISPLAY,
+                     reinterpret_cast<DdpHeader*>(&query[0]));
+  EXPECT_FALSE(receiver->HandlePacket(query, now).has_value());
+
+  // Queries don't disturb frame sequence accounting.
+  receiver->HandlePacket(MakePacket(0, 1, 0, {0}), now);
+  receiver->HandlePacket(MakePacket(0, 2, 0, {0}), now);
+
+  DDPReceiver::Stats stats = receiver->stats();
+  EXPECT_EQ(stats.queries, 2);
+  EXPECT_EQ(stats.packets, 2);
+  EXPECT_EQ(stats.dropped_packets, 0);
+}
+
+TEST(DDPReceiverTest, FromDDPConn) {
+  constexpr int kNumPixels = 1000;
+  std::unique_ptr<DDPReceiver> receiver = MakeReceiver(kNumPixels);
+  ASSERT_NE(receiver, nullptr);
+  std::thread thread([&] { receiver->Run(); });
+
+  // Joins the thread even if an assertion returns early, rather than
+  // destroying it joinable, which would terminate the test.
+  absl::Cleanup stop_receiver = [&] {
+    receiver->Stop();
+    thread.join();
+  };
+
+  auto conn = DDPConn::Create("127.0.0.1", receiver->port(),
+                              {.num_pixels = kNumPixels});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  ASSERT_TRUE((*conn)->OnlyOne(500, 0x010203).ok());
+  std::optional<DDPReceiver::Frame> frame =
+      receiver->WaitForFrame(0, absl::Now() + absl::Seconds(5));
+  ASSERT_TRUE(frame.has_value());
+
+  std::vector<char> want(kNumPixels * 3);
+  want[1500] = 1;
+  want[1501] = 2;
+  want[1502] = 3;
+  EXPECT_EQ(frame->chans, want);
+
+  std::move(stop_receiver).Invoke();
+
+  DDPReceiver::Stats stats = receiver->stats();
+  EXPECT_EQ(stats.packets, 3);
+  EXPECT_EQ(stats.frames, 1);
+  EXPECT_EQ(stats.fps, 1);
+  EXPECT_EQ(stats.dropped_packets, 0);
+}
+
+}  // namespace
@@ -0,0 +1,225 @@
+#include "cmd/automap/ddp.h"
+
+#include <arpa/inet.h>
+
+#include <memory>
+#include <vector>
+
+#include "cmd/automap/ddp_protocol.h"
+#include "cmd/automap/ddp_testutil.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+std::vector<ChannelRange> Diff(const std::vector<char>& prev,
+                               const std::vector<char>& next, int merge_gap) {
+  std::vector<ChannelRange> ranges;
+  DiffChannels(prev, next, merge_gap, &ranges);
+  return ranges;
+}
+
+TEST(DiffChannelsTest, Unchanged) {
+  std::vector<char> chans(300, 7);
+  EXPECT_THAT(Diff(chans, chans, 0), IsEmpty());
+}
+
+TEST(DiffChannelsTest, Ranges) {
+  std::vector<char> prev(300), next(300);
+  next[0] = 1;
+  next[150] = next[151] = next[152] = 1;
+  next[160] = 1;
+  next[299] = 1;
+
+  EXPECT_THAT(Diff(prev, next, 0),
+              ElementsAre(ChannelRange{0, 1}, ChannelRange{150, 3},
+                          ChannelRange{160, 1}, ChannelRange{299, 1}));
+
+  // The gap between 152 and 160 is 7 unchanged channels.
+  EXPECT_THAT(Diff(prev, next, 8),
+              ElementsAre(ChannelRange{0, 1}, ChannelRange{150, 11},
+                          ChannelRange{299, 1}));
+  EXPECT_THAT(Diff(prev, next, 7),
+              ElementsAre(ChannelRange{0, 1}, ChannelRange{150, 3},
+                          ChannelRange{160, 1}, ChannelRange{299, 1}));
+
+  EXPECT_THAT(Diff(prev, next, 1000), ElementsAre(ChannelRange{0, 300}));
+}
+
+using Packet = DDPTestReceiver::Packet;
+
+class DDPConnTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto receiver = DDPTestReceiver::Create();
+    ASSERT_TRUE(receiver.ok()) << receiver.status();
+    receiver_ = std::move(*receiver);
+    port_ = receiver_->port();
+  }
+
+  Packet Receive() {
+    absl::StatusOr<Packet> packet = receiver_->Receive();
+    EXPECT_TRUE(packet.ok()) << packet.status();
+    return packet.ok() ? *packet : Packet{};
+  }
+
+  std::unique_ptr<DDPTestReceiver> receiver_;
+  int port_;
+};
+
+TEST_F(DDPConnTest, SetAll) {
+  auto conn = DDPConn::Create(
+      "127.0.0.1", port_, {.num_pixels = 1000, .max_chans_per_packet = 1440});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  ASSERT_TRUE((*conn)->SetAll(0x0a0b0c).ok());
+
+  const int kWantLens[] = {1440, 1440, 120};
+  int off = 0;
+  for (int i = 0; i < 3; ++i) {
+    SCOPED_TRACE(i);
+    Packet packet = Receive();
+    EXPECT_EQ(packet.hdr.flags,
+              DDP_FLAGS_VER1 | (i == 2 ? DDP_FLAGS_PUSH : 0));
+    EXPECT_EQ(packet.hdr.seq, i + 1);
+    EXPECT_EQ(ntohl(packet.hdr.offset), off);
+    EXPECT_EQ(ntohs(packet.hdr.len), kWantLens[i]);
+    ASSERT_EQ(packet.data.size(), kWantLens[i]);
+    for (int j = 0; j < kWantLens[i]; ++j) {
+      ASSERT_EQ(packet.data[j], 0x0a + (off + j) % 3) << j;
+    }
+    off += kWantLens[i];
+  }
+}
+
+TEST_F(DDPConnTest, OnlyOne) {
+  auto conn = DDPConn::Create("127.0.0.1", port_,
+                              {.num_pixels = 10, .max_chans_per_packet = 12});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  ASSERT_TRUE((*conn)->SetAll(0xffffff).ok());
+  for (int i = 0; i < 3; ++i) {
+    Receive();
+  }
+
+  // The previous frame must not leak into this one.
+  ASSERT_TRUE((*conn)->OnlyOne(5, 0x010203).ok());
+  std::vector<char> got;
+  for (int i = 0; i < 3; ++i) {
+    Packet packet = Receive();
+    EXPECT_EQ(packet.hdr.seq, i + 4);
+    got.insert(got.end(), packet.data.begin(), packet.data.end());
+  }
+
+  std::vector<char> want(30);
+  want[15] = 1;
+  want[16] = 2;
+  want[17] = 3;
+  EXPECT_EQ(got, want);
+}
+
+TEST_F(DDPConnTest, OnlyThese) {
+  auto conn = DDPConn::Create("127.0.0.1", port_, {.num_pixels = 4});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  ASSERT_TRUE((*conn)
+                  ->OnlyThese({{.idx = 0, .color = 0xff0000},
+                               {.idx = 2, .color = 0x0000ff}})
+                  .ok());
+  Packet packet = Receive();
+  EXPECT_EQ(packet.data,
+            std::vector<char>({'\xff', 0, 0, 0, 0, 0, 0, 0, '\xff', 0, 0, 0}));
+}
+
+TEST_F(DDPConnTest, SeqWraps) {
+  auto conn = DDPConn::Create("127.0.0.1", port_,
+                              {.num_pixels = 1, .max_chans_per_packet = 3});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  std::vector<int> seqs;
+  for (int i = 0; i < 17; ++i) {
+    ASSERT_TRUE((*conn)->SetAll(0).ok());
+    seqs.push_back(Receive().hdr.seq);
+  }
+
+  EXPECT_EQ(seqs.front(), 1);
+  EXPECT_EQ(seqs[14], 15);
+  EXPECT_EQ(seqs[15], 1);
+}
+
+TEST_F(DDPConnTest, Update) {
+  auto conn = DDPConn::Create("127.0.0.1", port_,
+                              {.num_pixels = 1000,
+                               .max_chans_per_packet = 1440,
+                               .delta_updates = true});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  // The first update has nothing to compare against, so it's a full frame.
+  ASSERT_TRUE((*conn)->OnlyOne(10, 0xffffff).ok());
+  for (int i = 0; i < 3; ++i) {
+    Receive();
+  }
+
+  // Only the old and new pixels are sent.
+  ASSERT_TRUE((*conn)->OnlyOne(900, 0x010203).ok());
+
+  Packet packet = Receive();
+  EXPECT_EQ(packet.hdr.flags, DDP_FLAGS_VER1);
+  EXPECT_EQ(ntohl(packet.hdr.offset), 30);
+  EXPECT_EQ(packet.data, std::vector<char>(3, 0));
+
+  packet = Receive();
+  EXPECT_EQ(packet.hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_PUSH);
+  EXPECT_EQ(ntohl(packet.hdr.offset), 2700);
+  EXPECT_EQ(packet.data, std::vector<char>({1, 2, 3}));
+
+  // Nothing changed, so nothing is sent. The next frame's packet is the
+  // first to arrive.
+  ASSERT_TRUE((*conn)->OnlyOne(900, 0x010203).ok());
+  ASSERT_TRUE((*conn)->OnlyOne(901, 0x010203).ok());
+
+  packet = Receive();
+  EXPECT_EQ(packet.hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_PUSH);
+  EXPECT_EQ(ntohl(packet.hdr.offset), 2700);
+  EXPECT_EQ(packet.data, std::vector<char>({0, 0, 0, 1, 2, 3}));
+}
+
+TEST_F(DDPConnTest, UpdateResendsFullFrames) {
+  auto conn = DDPConn::Create("127.0.0.1", port_,
+                              {.num_pixels = 1000,
+                               .max_chans_per_packet = 1440,
+                               .delta_updates = true,
+                               .full_frame_interval = 3});
+  ASSERT_TRUE(conn.ok()) << conn.status();
+
+  // Frames 1 (which has nothing to compare against) and 3 are sent in full,
+  // and frames 2 and 4 as updates.
+  for (int frame = 1; frame <= 4; ++frame) {
+    SCOPED_TRACE(frame);
+    ASSERT_TRUE((*conn)->OnlyOne(10 + frame, 0xffffff).ok());
+
+    if (frame % 2 == 1) {
+      const int kWantLens[] = {1440, 1440, 120};
+      int off = 0;
+      for (int i = 0; i < 3; ++i) {
+        Packet packet = Receive();
+        EXPECT_EQ(ntohl(packet.hdr.offset), off);
+        EXPECT_EQ(ntohs(packet.hdr.len), kWantLens[i]);
+        off += kWantLens[i];
+      }
+      continue;
+    }
+
+    // The previous pixel and this one, which are adjacent.
+    constexpr char kOn = static_cast<char>(0xff);
+    Packet packet = Receive();
+    EXPECT_EQ(packet.hdr.flags, DDP_FLAGS_VER1 | DDP_FLAGS_PUSH);
+    EXPECT_EQ(ntohl(packet.hdr.offset), 3 * (10 + frame - 1));
+    EXPECT_EQ(packet.data, std::vector<char>({0, 0, 0, kOn, kOn, kOn}));
+  }
+}
+
+}  // namespace
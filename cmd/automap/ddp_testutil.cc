@@ -0,0 +1,62 @@
+#include "cmd/automap/ddp_testutil.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+
+absl::StatusOr<std::unique_ptr<DDPTestReceiver>> DDPTestReceiver::Create() {
+  const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) {
+    return absl::ErrnoToStatus(errno, "failed to create socket");
+  }
+  auto receiver =
+      std::unique_ptr<DDPTestReceiver>(new DDPTestReceiver(sock, 0));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    return absl::ErrnoToStatus(errno, "failed to bind");
+  }
+
+  socklen_t len = sizeof(addr);
+  if (getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+    return absl::ErrnoToStatus(errno, "getsockname failed");
+  }
+  receiver->port_ = ntohs(addr.sin_port);
+
+  struct timeval timeout = {.tv_sec = 5, .tv_usec = 0};
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) <
+      0) {
+    return absl::ErrnoToStatus(errno, "failed to set timeout");
+  }
+
+  return receiver;
+}
+
+DDPTestReceiver::~DDPTestReceiver() { close(sock_); }
+
+absl::StatusOr<DDPTestReceiver::Packet> DDPTestReceiver::Receive() {
+  char buf[2048];
+  const int n = recv(sock_, buf, sizeof(buf), 0);
+  if (n < 0) {
+    return absl::ErrnoToStatus(errno, "recv failed");
+  }
+  if (n < static_cast<int>(sizeof(DdpHeader))) {
+    return absl::InvalidArgumentError(absl::StrCat("short packet: ", n));
+  }
+
+  Packet packet;
+  memcpy(&packet.hdr, buf, sizeof(DdpHeader));
+  packet.data.assign(buf + sizeof(DdpHeader), buf + n);
+  return packet;
+}
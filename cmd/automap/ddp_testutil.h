@@ -0,0 +1,33 @@
+#ifndef _CMD_AUTOMAP_DDP_TESTUTIL_H_
+#define _CMD_AUTOMAP_DDP_TESTUTIL_H_ 1
+
+#include <memory>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "cmd/automap/ddp_protocol.h"
+
+// A UDP socket on localhost for tests to send DDP packets to.
+class DDPTestReceiver {
+ public:
+  struct Packet {
+    DdpHeader hdr;
+    std::vector<char> data;
+  };
+
+  static absl::StatusOr<std::unique_ptr<DDPTestReceiver>> Create();
+  ~DDPTestReceiver();
+
+  int port() const { return port_; }
+
+  // Waits up to five seconds for the next packet.
+  absl::StatusOr<Packet> Receive();
+
+ private:
+  DDPTestReceiver(int sock, int port) : sock_(sock), port_(port) {}
+
+  int sock_;
+  int port_;
+};
+
+#endif  // _CMD_AUTOMAP_DDP_TESTUTIL_H_
@@ -0,0 +1,144 @@
+#ifndef _CMD_AUTOMAP_FRAME_RING_H_
+#define _CMD_AUTOMAP_FRAME_RING_H_ 1
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/log/check.h"
+#include "absl/time/time.h"
+
+// A bounded ring of the most recently published frames, each tagged with a
+// sequence number and capture time. There is one writer (the stream reader
+// thread) and any number of readers, none of which ever take a lock.
+//
+// Each slot carries a state word: -1 while the writer is filling it, otherwise
+// the number of readers currently copying out of it. Readers register by
+// incrementing the count, and the writer claims a slot only when the count is
+// zero, skipping to the next slot otherwise. The writer therefore never waits
+// for readers, and readers wait for the writer only for as long as it takes to
+// assign one slot.
+template <typename T>
+class FrameRing {
+ public:
+  struct Entry {
+    T value;
+    uint64_t seq = 0;  // starts at 1; 0 means no frame
+    absl::Time captured;
+  };
+
+  explicit FrameRing(int size)
+      : size_(size),
+        slots_(new Slot[size]),
+        latest_(-1),
+        latest_seq_(0),
+        next_(0),
+        seq_(0) {
+    QCHECK_GE(size, 2);
+  }
+  ~FrameRing() = default;
+
+  // Adds a frame to the ring, replacing the oldest one not currently being
+  // read. Returns false (dropping the frame) only if every slot is being read.
+  // Must only be called by one thread at a time.
+  bool Publish(T value, absl::Time captured) {
+    for (int tries = 0; tries < size_; ++tries) {
+      const int idx = next_;
+      next_ = (next_ + 1) % size_;
+
+      Slot& slot = slots_[idx];
+      int expected = 0;
+      if (!slot.state.compare_exchange_strong(expected, kWriting,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed)) {
+        continue;
+      }
+
+      slot.entry = Entry{std::move(value), ++seq_, captured};
+      slot.state.store(0, std::memory_order_release);
+
+      latest_.store(idx, std::memory_order_release);
+      latest_seq_.store(seq_, std::memory_order_release);
+      return true;
+    }
+    return false;
+  }
+
+  // Returns the most recently published frame, if any.
+  std::optional<Entry> Latest() {
+    for (;;) {
+      const int idx = latest_.load(std::memory_order_acquire);
+      if (idx < 0) {
+        return std::nullopt;
+      }
+
+      // The slot can only be unreadable if the writer has lapped us and is
+      // refilling it, in which case there's a newer latest frame to try.
+      Slot& slot = slots_[idx];
+      if (AcquireRead(slot)) {
+        Entry entry = slot.entry;
+        ReleaseRead(slot);
+        return entry;
+      }
+    }
+  }
+
+  // Returns the oldest retained frame captured strictly after `after`, if
+  // any.
+  std::optional<Entry> FirstAfter(absl::Time after) {
+    std::optional<Entry> best;
+    for (int i = 0; i < size_; ++i) {
+      Slot& slot = slots_[i];
+      if (!AcquireRead(slot)) {
+        continue;  // being rewritten, so it wasn't going to be the oldest
+      }
+      if (slot.entry.seq != 0 && slot.entry.captured > after &&
+          (!best.has_value() || slot.entry.seq < best->seq)) {
+        best = slot.entry;
+      }
+      ReleaseRead(slot);
+    }
+    return best;
+  }
+
+  // The sequence number of the most recently published frame, or 0 if none.
+  uint64_t latest_seq() const {
+    return latest_seq_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr int kWriting = -1;
+
+  struct Slot {
+    std::atomic<int> state = 0;
+    Entry entry;
+  };
+
+  bool AcquireRead(Slot& slot) {
+    int state = slot.state.load(std::memory_order_relaxed);
+    while (state != kWriting) {
+      if (slot.state.compare_exchange_weak(state, state + 1,
+                                           std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void ReleaseRead(Slot& slot) {
+    slot.state.fetch_sub(1, std::memory_order_release);
+  }
+
+  const int size_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<int> latest_;
+  std::atomic<uint64_t> latest_seq_;
+
+  // Only touched by the writer.
+  int next_;
+  uint64_t seq_;
+};
+
+#endif  // _CMD_AUTOMAP_FRAME_RING_H_
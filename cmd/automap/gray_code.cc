@@ -0,0 +1,42 @@
+#include "cmd/automap/gray_code.h"
+
+#include <vector>
+
+#include "absl/log/check.h"
+
+int GrayCodeBits(int num_pixels) {
+  QCHECK_GT(num_pixels, 0);
+
+  int bits = 1;
+  while ((1 << bits) < num_pixels) {
+    ++bits;
+  }
+  return bits;
+}
+
+int ToGrayCode(int n) { return n ^ (n >> 1); }
+
+int FromGrayCode(int gray) {
+  int n = gray;
+  for (int shift = 1; shift < 32; shift <<= 1) {
+    n ^= n >> shift;
+  }
+  return n;
+}
+
+std::vector<char> MakeGrayCodePattern(int num_pixels, int first_pixel,
+                                      int last_pixel, int bit, bool inverted,
+                                      int color) {
+  std::vector<char> chans(num_pixels * 3);
+  for (int i = first_pixel; i <= last_pixel; ++i) {
+    const bool set = (ToGrayCode(i) & (1 << bit)) != 0;
+    if (set == inverted) {
+      continue;
+    }
+
+    chans[i * 3] = color >> 16;
+    chans[i * 3 + 1] = (color >> 8) & 0xff;
+    chans[i * 3 + 2] = color & 0xff;
+  }
+  return chans;
+}
@@ -0,0 +1,28 @@
+#ifndef _CMD_AUTOMAP_GRAY_CODE_H_
+#define _CMD_AUTOMAP_GRAY_CODE_H_ 1
+
+#include <vector>
+
+// Gray-code structured light. Rather than lighting one pixel per frame, every
+// pixel is lit according to one bit of its (Gray-coded) pixel number. Each bit
+// plane is shown twice -- once as-is and once inverted -- so that every pixel
+// is lit in exactly one frame of each pair, and the bit can be recovered by
+// comparing the two frames rather than by guessing at an absolute brightness
+// threshold. N pixels take 2*ceil(log2(N)) frames.
+
+// Returns the number of bit planes needed to give each of num_pixels pixels a
+// distinct code.
+int GrayCodeBits(int num_pixels);
+
+int ToGrayCode(int n);
+int FromGrayCode(int gray);
+
+// Returns DDP channel values for one bit plane. Pixels whose Gray code has
+// `bit` set are lit with `color` (the others are dark), or the other way
+// around if `inverted` is true. Pixels outside [first_pixel,last_pixel] are
+// always dark.
+std::vector<char> MakeGrayCodePattern(int num_pixels, int first_pixel,
+                                      int last_pixel, int bit, bool inverted,
+                                      int color);
+
+#endif  // _CMD_AUTOMAP_GRAY_CODE_H_
@@ -0,0 +1,96 @@
+#include "cmd/automap/gray_code_decoder.h"
+
+#include <climits>
+#include <map>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/types/span.h"
+#include "cmd/automap/gray_code.h"
+#include "cmd/detect/detect.h"
+#include "cmd/detect/records.h"
+#include "opencv2/opencv.hpp"
+#include "proto/points.pb.h"
+
+namespace {
+
+cv::Mat ToGray(cv::Mat image) {
+  cv::Mat gray;
+  cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+  return gray;
+}
+
+// Returns a mask of the pixels within blob.bounds that belong to the blob.
+// Lights close together can have overlapping bounds, and sampling the whole
+// of them would mix their codes.
+cv::Mat BlobMask(const DetectedBlob& blob) {
+  cv::Mat mask(blob.bounds.size(), CV_8U, cv::Scalar::all(0));
+  cv::drawContours(mask, std::vector<std::vector<cv::Point>>{blob.contour}, 0,
+                   cv::Scalar::all(255), cv::FILLED, cv::LINE_8,
+                   cv::noArray(), INT_MAX, -blob.bounds.tl());
+  return mask;
+}
+
+}  // namespace
+
+void DecodeGrayCode(cv::Mat off, cv::Mat on,
+                    absl::Span<const GrayCodePlane> planes,
+                    const GrayCodeDecodeOptions& options,
+                    proto::PixelRecords* records) {
+  cv::Mat mask(on.rows, on.cols, CV_8U, cv::Scalar::all(255));
+  std::vector<DetectedBlob> blobs = DetectBlobs(off, on, mask);
+
+  std::vector<std::pair<cv::Mat, cv::Mat>> gray_planes;
+  for (const GrayCodePlane& plane : planes) {
+    gray_planes.emplace_back(ToGray(plane.normal), ToGray(plane.inverted));
+  }
+
+  // If more than one blob decodes to the same pixel (reflections, usually),
+  // the biggest one wins.
+  std::map<int, const DetectedBlob*> found;
+  int num_undecodable = 0;
+  for (const DetectedBlob& blob : blobs) {
+    const cv::Mat blob_mask = BlobMask(blob);
+    int code = 0;
+    bool decodable = true;
+    for (int bit = 0; bit < static_cast<int>(gray_planes.size()); ++bit) {
+      const double normal =
+          cv::mean(gray_planes[bit].first(blob.bounds), blob_mask)[0];
+      const double inverted =
+          cv::mean(gray_planes[bit].second(blob.bounds), blob_mask)[0];
+      if (std::abs(normal - inverted) < options.min_contrast) {
+        decodable = false;
+        break;
+      }
+      if (normal > inverted) {
+        code |= 1 << bit;
+      }
+    }
+
+    const int pixel_num = FromGrayCode(code);
+    if (!decodable || pixel_num < options.first_pixel ||
+        pixel_num > options.last_pixel) {
+      LOG_IF(INFO, options.verbose)
+          << "undecodable blob at " << blob.centroid.x << "," << blob.centroid.y;
+      ++num_undecodable;
+      continue;
+    }
+
+    if (auto iter = found.find(pixel_num);
+        iter == found.end() || iter->second->area < blob.area) {
+      found[pixel_num] = &blob;
+    }
+  }
+
+  LOG(INFO) << "camera " << options.camera_number << ": decoded "
+            << found.size() << " pixels from " << blobs.size()
+            << " blobs (" << num_undecodable << " undecodable)";
+
+  for (int i = options.first_pixel; i <= options.last_pixel; ++i) {
+    std::optional<cv::Point2i> point;
+    if (auto iter = found.find(i); iter != found.end()) {
+      point = iter->second->centroid;
+    }
+    InsertResult(options.camera_number, i, point, records);
+  }
+}
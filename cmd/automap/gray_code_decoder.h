@@ -0,0 +1,36 @@
+#ifndef _CMD_AUTOMAP_GRAY_CODE_DECODER_H_
+#define _CMD_AUTOMAP_GRAY_CODE_DECODER_H_ 1
+
+#include "absl/types/span.h"
+#include "opencv2/core/mat.hpp"
+#include "proto/points.pb.h"
+
+// The pair of frames captured for a single Gray code bit plane (see
+// MakeGrayCodePattern).
+struct GrayCodePlane {
+  cv::Mat normal;
+  cv::Mat inverted;
+};
+
+struct GrayCodeDecodeOptions {
+  int first_pixel;
+  int last_pixel;
+  int camera_number;
+
+  // Blobs whose normal and inverted brightness differ by less than this (in
+  // grayscale levels) for any bit are considered undecodable.
+  double min_contrast = 20;
+
+  bool verbose = false;
+};
+
+// Finds the lit pixels by comparing the all-on and all-off frames, then reads
+// each one's bits out of `planes` (indexed by bit number) to recover its pixel
+// number. Every pixel in [first_pixel,last_pixel] is added to `records`, with
+// locations only for those that were decoded.
+void DecodeGrayCode(cv::Mat off, cv::Mat on,
+                    absl::Span<const GrayCodePlane> planes,
+                    const GrayCodeDecodeOptions& options,
+                    proto::PixelRecords* records);
+
+#endif  // _CMD_AUTOMAP_GRAY_CODE_DECODER_H_
@@ -0,0 +1,173 @@
+#include "cmd/automap/gray_code_decoder.h"
+
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include "cmd/automap/gray_code.h"
+#include "gtest/gtest.h"
+#include "opencv2/opencv.hpp"
+#include "proto/points.pb.h"
+
+namespace {
+
+constexpr int kRows = 100;
+constexpr int kCols = 300;
+constexpr int kNumPixels = 6;
+constexpr int kCameraNumber = 2;
+
+cv::Mat MakeImage() {
+  return cv::Mat(kRows, kCols, CV_8UC3, cv::Scalar::all(10));
+}
+
+cv::Point PixelLocation(int pixel_num) { return {25 + 45 * pixel_num, 50}; }
+
+void DrawPixel(cv::Mat image, int pixel_num) {
+  cv::circle(image, PixelLocation(pixel_num), 6, cv::Scalar::all(255),
+             cv::FILLED);
+}
+
+// Returns the location recorded for each pixel by kCameraNumber, nullopt for
+// pixels that were recorded without one.
+std::map<int, std::optional<cv::Point2i>> Locations(
+    const proto::PixelRecords& records) {
+  std::map<int, std::optional<cv::Point2i>> locations;
+  for (const proto::PixelRecord& pixel : records.pixel()) {
+    std::optional<cv::Point2i>& location = locations[pixel.pixel_number()];
+    for (const proto::CameraPixelLocation& camera : pixel.camera_pixel()) {
+      if (camera.camera_number() == kCameraNumber &&
+          camera.has_pixel_location()) {
+        location = cv::Point2i(camera.pixel_location().x(),
+                               camera.pixel_location().y());
+      }
+    }
+  }
+  return locations;
+}
+
+TEST(DecodeGrayCodeTest, Test) {
+  // Pixels 1, 4 and 5 are lit according to their codes. Pixel 2 is lit in
+  // both frames of bit 1, so it can't be decoded. The others aren't lit.
+  const std::set<int> lit = {1, 4, 5};
+  constexpr int kAmbiguous = 2;
+  constexpr int kAmbiguousBit = 1;
+
+  cv::Mat off = MakeImage(), on = MakeImage();
+  for (int pixel_num : lit) {
+    DrawPixel(on, pixel_num);
+  }
+  DrawPixel(on, kAmbiguous);
+
+  std::vector<GrayCodePlane> planes;
+  for (int bit = 0; bit < GrayCodeBits(kNumPixels); ++bit) {
+    GrayCodePlane plane = {.normal = MakeImage(), .inverted = MakeImage()};
+    for (int pixel_num = 0; pixel_num < kNumPixels; ++pixel_num) {
+      const bool set = ToGrayCode(pixel_num) & (1 << bit);
+      if (lit.contains(pixel_num) || pixel_num == kAmbiguous) {
+        DrawPixel(set ? plane.normal : plane.inverted, pixel_num);
+      }
+      if (pixel_num == kAmbiguous && bit == kAmbiguousBit) {
+        DrawPixel(set ? plane.inverted : plane.normal, pixel_num);
+      }
+    }
+    planes.push_back(std::move(plane));
+  }
+
+  proto::PixelRecords records;
+  DecodeGrayCode(off, on, planes,
+                 {
+                     .first_pixel = 0,
+                     .last_pixel = kNumPixels - 1,
+                     .camera_number = kCameraNumber,
+                 },
+                 &records);
+
+  const std::map<int, std::optional<cv::Point2i>> locations =
+      Locations(records);
+  ASSERT_EQ(locations.size(), kNumPixels);
+  for (const auto& [pixel_num, location] : locations) {
+    SCOPED_TRACE(pixel_num);
+    if (!lit.contains(pixel_num)) {
+      EXPECT_FALSE(location.has_value());
+      continue;
+    }
+
+    ASSERT_TRUE(location.has_value());
+    EXPECT_NEAR(location->x, PixelLocation(pixel_num).x, 1);
+    EXPECT_NEAR(location->y, PixelLocation(pixel_num).y, 1);
+  }
+}
+
+TEST(DecodeGrayCodeTest, OverlappingBounds) {
+  // Pixel 1 is seen as a diagonal streak, and pixel 4, lit in every bit plane
+  // that pixel 1 isn't, sits within the streak's bounding box. Each must be
+  // decoded from its own pixels only.
+  auto draw = [](cv::Mat image, int pixel_num) {
+    if (pixel_num == 1) {
+      cv::line(image, {60, 20}, {120, 80}, cv::Scalar::all(255), 4);
+    } else {
+      cv::circle(image, {105, 35}, 11, cv::Scalar::all(255), cv::FILLED);
+    }
+  };
+
+  cv::Mat off = MakeImage(), on = MakeImage();
+  draw(on, 1);
+  draw(on, 4);
+
+  std::vector<GrayCodePlane> planes;
+  for (int bit = 0; bit < GrayCodeBits(kNumPixels); ++bit) {
+    GrayCodePlane plane = {.normal = MakeImage(), .inverted = MakeImage()};
+    for (const int pixel_num : {1, 4}) {
+      draw(ToGrayCode(pixel_num) & (1 << bit) ? plane.normal : plane.inverted,
+           pixel_num);
+    }
+    planes.push_back(std::move(plane));
+  }
+
+  proto::PixelRecords records;
+  DecodeGrayCode(off, on, planes,
+                 {
+                     .first_pixel = 0,
+                     .last_pixel = kNumPixels - 1,
+                     .camera_number = kCameraNumber,
+                 },
+                 &records);
+
+  const std::map<int, std::optional<cv::Point2i>> locations =
+      Locations(records);
+  ASSERT_TRUE(locations.at(1).has_value());
+  EXPECT_NEAR(locations.at(1)->x, 90, 1);
+  EXPECT_NEAR(locations.at(1)->y, 50, 1);
+  ASSERT_TRUE(locations.at(4).has_value());
+  EXPECT_NEAR(locations.at(4)->x, 105, 1);
+  EXPECT_NEAR(locations.at(4)->y, 35, 1);
+}
+
+TEST(DecodeGrayCodeTest, OutOfRange) {
+  // Pixel 5 decodes correctly but is outside the range being mapped.
+  cv::Mat off = MakeImage(), on = MakeImage();
+  DrawPixel(on, 5);
+
+  std::vector<GrayCodePlane> planes;
+  for (int bit = 0; bit < GrayCodeBits(kNumPixels); ++bit) {
+    GrayCodePlane plane = {.normal = MakeImage(), .inverted = MakeImage()};
+    DrawPixel(ToGrayCode(5) & (1 << bit) ? plane.normal : plane.inverted, 5);
+    planes.push_back(std::move(plane));
+  }
+
+  proto::PixelRecords records;
+  DecodeGrayCode(
+      off, on, planes,
+      {.first_pixel = 0, .last_pixel = 3, .camera_number = kCameraNumber},
+      &records);
+
+  const std::map<int, std::optional<cv::Point2i>> locations =
+      Locations(records);
+  ASSERT_EQ(locations.size(), 4);
+  for (const auto& [pixel_num, location] : locations) {
+    EXPECT_FALSE(location.has_value()) << pixel_num;
+  }
+}
+
+}  // namespace
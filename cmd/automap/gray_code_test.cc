@@ -0,0 +1,82 @@
+#include "cmd/automap/gray_code.h"
+
+#include <bitset>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(GrayCodeTest, GrayCodeBits) {
+  EXPECT_EQ(GrayCodeBits(1), 1);
+  EXPECT_EQ(GrayCodeBits(2), 1);
+  EXPECT_EQ(GrayCodeBits(3), 2);
+  EXPECT_EQ(GrayCodeBits(500), 9);
+  EXPECT_EQ(GrayCodeBits(512), 9);
+  EXPECT_EQ(GrayCodeBits(513), 10);
+  EXPECT_EQ(GrayCodeBits(2000), 11);
+}
+
+TEST(GrayCodeTest, RoundTrip) {
+  for (int i = 0; i < 5000; ++i) {
+    EXPECT_EQ(FromGrayCode(ToGrayCode(i)), i) << i;
+  }
+}
+
+TEST(GrayCodeTest, AdjacentDifferByOneBit) {
+  for (int i = 1; i < 5000; ++i) {
+    std::bitset<32> diff(ToGrayCode(i) ^ ToGrayCode(i - 1));
+    EXPECT_EQ(diff.count(), 1) << i;
+  }
+}
+
+TEST(GrayCodeTest, MakeGrayCodePattern) {
+  constexpr int kNumPixels = 6;
+  constexpr int kColor = 0x102030;
+
+  // Each pixel must be lit in exactly one of the normal and inverted frames,
+  // and the normal frames must spell out the pixel's Gray code.
+  const int bits = GrayCodeBits(kNumPixels);
+  std::vector<int> codes(kNumPixels);
+  for (int bit = 0; bit < bits; ++bit) {
+    std::vector<char> normal =
+        MakeGrayCodePattern(kNumPixels, 0, kNumPixels - 1, bit, false, kColor);
+    std::vector<char> inverted =
+        MakeGrayCodePattern(kNumPixels, 0, kNumPixels - 1, bit, true, kColor);
+    ASSERT_EQ(normal.size(), kNumPixels * 3);
+    ASSERT_EQ(inverted.size(), kNumPixels * 3);
+
+    for (int i = 0; i < kNumPixels; ++i) {
+      const bool normal_lit = normal[i * 3] != 0;
+      const bool inverted_lit = inverted[i * 3] != 0;
+      EXPECT_NE(normal_lit, inverted_lit) << "pixel " << i << " bit " << bit;
+
+      const char* lit = normal_lit ? &normal[i * 3] : &inverted[i * 3];
+      EXPECT_EQ(lit[0], 0x10);
+      EXPECT_EQ(lit[1], 0x20);
+      EXPECT_EQ(lit[2], 0x30);
+
+      if (normal_lit) {
+        codes[i] |= 1 << bit;
+      }
+    }
+  }
+
+  for (int i = 0; i < kNumPixels; ++i) {
+    EXPECT_EQ(FromGrayCode(codes[i]), i);
+  }
+}
+
+TEST(GrayCodeTest, MakeGrayCodePatternRange) {
+  std::vector<char> chans = MakeGrayCodePattern(8, 2, 4, 0, true, 0xffffff);
+  for (int i = 0; i < 8; ++i) {
+    const bool lit = chans[i * 3] != 0;
+    if (i < 2 || i > 4) {
+      EXPECT_FALSE(lit) << i;
+    } else {
+      EXPECT_EQ(lit, (ToGrayCode(i) & 1) == 0) << i;
+    }
+  }
+}
+
+}  // namespace
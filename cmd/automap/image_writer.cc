@@ -0,0 +1,128 @@
+#include "cmd/automap/image_writer.h"
+
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "lib/file/file.h"
+#include "opencv2/imgcodecs.hpp"
+
+absl::Status WriteImage(const cv::Mat& image, const std::string& path,
+                        LatencyHistogram* encode_latency,
+                        LatencyHistogram* write_latency) {
+  const std::string::size_type dot = path.rfind('.');
+  if (dot == std::string::npos) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("no image format extension in ", path));
+  }
+
+  const absl::Time start = absl::Now();
+  std::vector<unsigned char> buf;
+  if (!cv::imencode(path.substr(dot), image, buf)) {
+    return absl::UnknownError(absl::StrCat("failed to encode ", path));
+  }
+
+  const absl::Time encoded = absl::Now();
+  if (encode_latency != nullptr) {
+    encode_latency->Record(encoded - start);
+  }
+
+  // Written atomically, so that an interrupted capture doesn't leave a
+  // truncated image that --resume would take as captured.
+  if (absl::Status status = WriteFileAtomically(
+          path, absl::string_view(reinterpret_cast<const char*>(buf.data()),
+                                  buf.size()));
+      !status.ok()) {
+    return status;
+  }
+
+  if (write_latency != nullptr) {
+    write_latency->Record(absl::Now() - encoded);
+  }
+  return absl::OkStatus();
+}
+
+AsyncImageWriter::AsyncImageWriter(const Options& options)
+    : options_(options), num_in_flight_(0), stopping_(false) {
+  for (int i = 0; i < options_.num_threads; ++i) {
+    threads_.emplace_back([this] { Work(); });
+  }
+}
+
+AsyncImageWriter::~AsyncImageWriter() {
+  if (absl::Status status = Flush(); !status.ok()) {
+    LOG(ERROR) << "image write failed: " << status;
+  }
+
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+absl::Status AsyncImageWriter::Write(cv::Mat image, const std::string& path) {
+  auto has_room = [this]() {
+    mu_.AssertReaderHeld();
+    return static_cast<int>(queue_.size()) < options_.max_queued;
+  };
+
+  absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(&has_room));
+  queue_.emplace_back(image, path);
+  return status_;
+}
+
+absl::Status AsyncImageWriter::Flush() {
+  auto is_idle = [this]() {
+    mu_.AssertReaderHeld();
+    return queue_.empty() && num_in_flight_ == 0;
+  };
+
+  absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(&is_idle));
+  return status_;
+}
+
+void AsyncImageWriter::Work() {
+  auto has_work = [this]() {
+    mu_.AssertReaderHeld();
+    return !queue_.empty() || stopping_;
+  };
+
+  for (;;) {
+    cv::Mat image;
+    std::string path;
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(&has_work));
+      if (queue_.empty()) {
+        return;  // stopping
+      }
+
+      std::tie(image, path) = std::move(queue_.front());
+      queue_.pop_front();
+      ++num_in_flight_;
+    }
+
+    absl::Status status = WriteImage(image, path, options_.encode_latency,
+                                     options_.write_latency);
+
+    absl::MutexLock lock(&mu_);
+    --num_in_flight_;
+    if (!status.ok() && status_.ok()) {
+      status_ = std::move(status);
+    }
+  }
+}
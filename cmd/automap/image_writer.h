@@ -0,0 +1,66 @@
+#ifndef _CMD_AUTOMAP_IMAGE_WRITER_H_
+#define _CMD_AUTOMAP_IMAGE_WRITER_H_ 1
+
+#include <deque>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "cmd/automap/latency.h"
+#include "opencv2/core/mat.hpp"
+
+// Encodes `image` in the format named by the extension of `path` and writes it
+// there, atomically (see WriteFileAtomically). If non-null, the encode and
+// write times are recorded in the given histograms.
+absl::Status WriteImage(const cv::Mat& image, const std::string& path,
+                        LatencyHistogram* encode_latency,
+                        LatencyHistogram* write_latency);
+
+// Encodes and writes images on a small pool of threads, so the capture loop
+// can move on to the next push while the previous frame is being written.
+class AsyncImageWriter {
+ public:
+  struct Options {
+    int num_threads = 2;
+
+    // Write blocks once this many images are waiting to be encoded.
+    int max_queued = 8;
+
+    // If non-null, receive the time taken to encode and write each image.
+    LatencyHistogram* encode_latency = nullptr;
+    LatencyHistogram* write_latency = nullptr;
+  };
+
+  explicit AsyncImageWriter(const Options& options);
+
+  // Waits for all queued images to be written.
+  ~AsyncImageWriter();
+
+  // Queues `image` to be written to `path`, blocking while the queue is full.
+  // The image must not be modified afterwards. Returns the first error
+  // encountered by any write so far.
+  absl::Status Write(cv::Mat image, const std::string& path);
+
+  // Waits for every queued image to be written. Returns the first error
+  // encountered by any write.
+  absl::Status Flush();
+
+ private:
+  void Work();
+
+  const Options options_;
+
+  absl::Mutex mu_;
+  std::deque<std::pair<cv::Mat, std::string>> queue_ ABSL_GUARDED_BY(mu_);
+  int num_in_flight_ ABSL_GUARDED_BY(mu_);
+  bool stopping_ ABSL_GUARDED_BY(mu_);
+  absl::Status status_ ABSL_GUARDED_BY(mu_);
+
+  std::vector<std::thread> threads_;
+};
+
+#endif  // _CMD_AUTOMAP_IMAGE_WRITER_H_
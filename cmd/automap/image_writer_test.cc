@@ -0,0 +1,70 @@
+#include "cmd/automap/image_writer.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+#include "opencv2/imgcodecs.hpp"
+
+namespace {
+
+TEST(AsyncImageWriterTest, Write) {
+  AsyncImageWriter writer({.num_threads = 2, .max_queued = 2});
+
+  std::vector<std::string> paths;
+  for (int i = 0; i < 10; ++i) {
+    cv::Mat image(16, 16, CV_8UC3, cv::Scalar::all(i * 20));
+    paths.push_back(JoinPath(
+        {testing::TempDir(), absl::StrFormat("image_writer_%d.png", i)}));
+    ASSERT_TRUE(writer.Write(image, paths.back()).ok());
+  }
+  ASSERT_TRUE(writer.Flush().ok());
+
+  for (int i = 0; i < 10; ++i) {
+    cv::Mat image = cv::imread(paths[i]);
+    ASSERT_FALSE(image.empty()) << paths[i];
+    EXPECT_EQ(image.at<cv::Vec3b>(0, 0)[0], i * 20) << paths[i];
+  }
+}
+
+TEST(AsyncImageWriterTest, Error) {
+  AsyncImageWriter writer({.num_threads = 1});
+
+  cv::Mat image(16, 16, CV_8UC3, cv::Scalar::all(0));
+  const std::string path =
+      JoinPath({testing::TempDir(), "nonexistent", "a.png"});
+  ASSERT_TRUE(writer.Write(image, path).ok());
+  EXPECT_FALSE(writer.Flush().ok());
+}
+
+TEST(AsyncImageWriterTest, Latencies) {
+  LatencyHistogram encode, write;
+  {
+    AsyncImageWriter writer(
+        {.encode_latency = &encode, .write_latency = &write});
+
+    cv::Mat image(16, 16, CV_8UC3, cv::Scalar::all(0));
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(
+          writer
+              .Write(image, JoinPath({testing::TempDir(),
+                                      absl::StrFormat("latency_%d.jpg", i)}))
+              .ok());
+    }
+    ASSERT_TRUE(writer.Flush().ok());
+  }
+
+  EXPECT_EQ(encode.count(), 3);
+  EXPECT_EQ(write.count(), 3);
+}
+
+TEST(WriteImageTest, NoExtension) {
+  cv::Mat image(16, 16, CV_8UC3, cv::Scalar::all(0));
+  EXPECT_FALSE(WriteImage(image, JoinPath({testing::TempDir(), "noext"}),
+                          nullptr, nullptr)
+                   .ok());
+}
+
+}  // namespace
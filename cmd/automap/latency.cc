@@ -0,0 +1,151 @@
+#include "cmd/automap/latency.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_usec_(0), max_usec_(0) {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+int LatencyHistogram::BucketIndex(uint64_t usec) {
+  if (usec < kSubBuckets) {
+    return static_cast<int>(usec);
+  }
+
+  const int exp = std::bit_width(usec) - 1;
+  const int sub = (usec >> (exp - kSubBucketBits)) & (kSubBuckets - 1);
+  return (exp - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketLimit(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  const int shift = index / kSubBuckets - 1;
+  const uint64_t lower =
+      static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+  return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::Record(absl::Duration latency) {
+  const uint64_t usec = static_cast<uint64_t>(
+      std::max<int64_t>(0, absl::ToInt64Microseconds(latency)));
+
+  buckets_[BucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_usec_.fetch_add(usec, std::memory_order_relaxed);
+
+  uint64_t max = max_usec_.load(std::memory_order_relaxed);
+  while (usec > max && !max_usec_.compare_exchange_weak(
+                           max, usec, std::memory_order_relaxed)) {
+  }
+}
+
+absl::Duration LatencyHistogram::max() const {
+  return absl::Microseconds(max_usec_.load(std::memory_order_relaxed));
+}
+
+absl::Duration LatencyHistogram::mean() const {
+  const int64_t n = count();
+  if (n == 0) {
+    return absl::ZeroDuration();
+  }
+  return absl::Microseconds(sum_usec_.load(std::memory_order_relaxed)) / n;
+}
+
+absl::Duration LatencyHistogram::Quantile(double q) const {
+  const int64_t n = count();
+  if (n == 0) {
+    return absl::ZeroDuration();
+  }
+
+  const int64_t rank = std::clamp<int64_t>(std::ceil(q * n), 1, n);
+  const uint64_t max_usec = max_usec_.load(std::memory_order_relaxed);
+
+  int64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return absl::Microseconds(std::min(BucketLimit(i), max_usec));
+    }
+  }
+
+  // A concurrent Record bumped count_ before its bucket.
+  return absl::Microseconds(max_usec);
+}
+
+const char* CaptureStageName(CaptureStage stage) {
+  switch (stage) {
+    case CaptureStage::kPush:
+      return "push";
+    case CaptureStage::kSettle:
+      return "settle";
+    case CaptureStage::kAcquire:
+      return "acquire";
+    case CaptureStage::kDisplay:
+      return "display";
+    case CaptureStage::kEncode:
+      return "encode";
+    case CaptureStage::kWrite:
+      return "write";
+  }
+  return "unknown";
+}
+
+namespace {
+
+double ToMs(absl::Duration d) { return absl::ToDoubleMilliseconds(d); }
+
+}  // namespace
+
+std::string CaptureLatencies::Summary() const {
+  std::string out = absl::StrFormat("%-8s %7s %9s %9s %9s %9s %9s", "stage",
+                                    "count", "mean", "p50", "p90", "p99",
+                                    "max");
+  for (int i = 0; i < kNumStages; ++i) {
+    const CaptureStage s = static_cast<CaptureStage>(i);
+    const LatencyHistogram& h = stage(s);
+    absl::StrAppend(
+        &out, "\n",
+        absl::StrFormat("%-8s %7d %7.1fms %7.1fms %7.1fms %7.1fms %7.1fms",
+                        CaptureStageName(s), h.count(), ToMs(h.mean()),
+                        ToMs(h.Quantile(0.5)), ToMs(h.Quantile(0.9)),
+                        ToMs(h.Quantile(0.99)), ToMs(h.max())));
+  }
+  return out;
+}
+
+absl::Status CaptureLatencies::WriteCsv(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out.good()) {
+    return absl::UnknownError(absl::StrCat("failed to open ", path));
+  }
+
+  out << "stage,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+  for (int i = 0; i < kNumStages; ++i) {
+    const CaptureStage s = static_cast<CaptureStage>(i);
+    const LatencyHistogram& h = stage(s);
+    out << absl::StrFormat("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                           CaptureStageName(s), h.count(), ToMs(h.mean()),
+                           ToMs(h.Quantile(0.5)), ToMs(h.Quantile(0.9)),
+                           ToMs(h.Quantile(0.99)), ToMs(h.max()));
+  }
+
+  out.close();
+  if (!out.good()) {
+    return absl::UnknownError(absl::StrCat("failed to write ", path));
+  }
+  return absl::OkStatus();
+}
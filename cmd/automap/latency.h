@@ -0,0 +1,86 @@
+#ifndef _CMD_AUTOMAP_LATENCY_H_
+#define _CMD_AUTOMAP_LATENCY_H_ 1
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+
+// A histogram of durations that any number of threads can record into without
+// taking a lock. Durations are kept in microseconds, in log-spaced buckets:
+// each power of two is split into kSubBuckets linear steps, so quantiles are
+// accurate to within 1/kSubBuckets of the value. The maximum is tracked
+// exactly.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+  ~LatencyHistogram() = default;
+
+  void Record(absl::Duration latency);
+
+  int64_t count() const { return count_.load(std::memory_order_relaxed); }
+  absl::Duration max() const;
+  absl::Duration mean() const;
+
+  // Returns the upper bound of the bucket holding the q'th quantile (0 < q <=
+  // 1), or zero if nothing was recorded. Concurrent Records may or may not be
+  // reflected.
+  absl::Duration Quantile(double q) const;
+
+ private:
+  static constexpr int kSubBucketBits = 2;
+  static constexpr int kSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kNumBuckets = 64 * kSubBuckets;
+
+  static int BucketIndex(uint64_t usec);
+  static uint64_t BucketLimit(int index);
+
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_;
+  std::atomic<int64_t> count_;
+  std::atomic<uint64_t> sum_usec_;
+  std::atomic<uint64_t> max_usec_;
+};
+
+// The steps of one automap capture.
+enum class CaptureStage {
+  kPush,     // sending the DDP frame
+  kSettle,   // waiting for the lights to settle
+  kAcquire,  // waiting for a camera frame from after the settle time
+  kDisplay,  // imshow
+  kEncode,   // JPEG encoding
+  kWrite,    // writing the encoded image
+};
+
+// Per-stage latency histograms for a capture run.
+class CaptureLatencies {
+ public:
+  static constexpr int kNumStages = static_cast<int>(CaptureStage::kWrite) + 1;
+
+  CaptureLatencies() = default;
+  ~CaptureLatencies() = default;
+
+  LatencyHistogram& stage(CaptureStage stage) {
+    return stages_[static_cast<int>(stage)];
+  }
+  const LatencyHistogram& stage(CaptureStage stage) const {
+    return stages_[static_cast<int>(stage)];
+  }
+
+  // Returns a multi-line human-readable summary of every stage.
+  std::string Summary() const;
+
+  // Writes the summary to `path` as CSV, with one row per stage and times in
+  // milliseconds.
+  absl::Status WriteCsv(const std::string& path) const;
+
+ private:
+  std::array<LatencyHistogram, kNumStages> stages_;
+};
+
+// Returns the lower-case name of a stage, as used in summaries.
+const char* CaptureStageName(CaptureStage stage);
+
+#endif  // _CMD_AUTOMAP_LATENCY_H_
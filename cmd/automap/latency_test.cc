@@ -0,0 +1,111 @@
+#include "cmd/automap/latency.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::StartsWith;
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram h;
+  EXPECT_EQ(h.count(), 0);
+  EXPECT_EQ(h.Quantile(0.5), absl::ZeroDuration());
+  EXPECT_EQ(h.max(), absl::ZeroDuration());
+  EXPECT_EQ(h.mean(), absl::ZeroDuration());
+}
+
+TEST(LatencyHistogramTest, Exact) {
+  // Small values each get their own bucket.
+  LatencyHistogram h;
+  for (int i = 1; i <= 4; ++i) {
+    h.Record(absl::Microseconds(i));
+  }
+
+  EXPECT_EQ(h.count(), 4);
+  EXPECT_EQ(h.Quantile(0.25), absl::Microseconds(1));
+  EXPECT_EQ(h.Quantile(0.5), absl::Microseconds(2));
+  EXPECT_EQ(h.Quantile(1), absl::Microseconds(4));
+  EXPECT_EQ(h.max(), absl::Microseconds(4));
+  EXPECT_EQ(h.mean(), absl::Microseconds(2.5));
+}
+
+TEST(LatencyHistogramTest, Quantiles) {
+  LatencyHistogram h;
+  for (int i = 1; i <= 1000; ++i) {
+    h.Record(absl::Milliseconds(i));
+  }
+
+  EXPECT_EQ(h.count(), 1000);
+  EXPECT_EQ(h.max(), absl::Milliseconds(1000));
+
+  // Buckets are within 25% of the value, and quantiles report the bucket's
+  // upper bound.
+  for (const double q : {0.5, 0.9, 0.99}) {
+    const absl::Duration want = absl::Milliseconds(1000 * q);
+    const absl::Duration got = h.Quantile(q);
+    EXPECT_GE(got, want) << q;
+    EXPECT_LE(got, want * 1.25) << q;
+  }
+  EXPECT_EQ(h.Quantile(1), absl::Milliseconds(1000));
+}
+
+TEST(LatencyHistogramTest, Negative) {
+  LatencyHistogram h;
+  h.Record(absl::Milliseconds(-5));
+  EXPECT_EQ(h.count(), 1);
+  EXPECT_EQ(h.max(), absl::ZeroDuration());
+}
+
+TEST(LatencyHistogramTest, Concurrent) {
+  LatencyHistogram h;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&h, t] {
+      for (int i = 0; i < 10000; ++i) {
+        h.Record(absl::Microseconds(t * 10000 + i));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(h.count(), 40000);
+  EXPECT_EQ(h.max(), absl::Microseconds(39999));
+  EXPECT_EQ(h.Quantile(1), absl::Microseconds(39999));
+}
+
+TEST(CaptureLatenciesTest, Summary) {
+  CaptureLatencies latencies;
+  latencies.stage(CaptureStage::kSettle).Record(absl::Milliseconds(500));
+  latencies.stage(CaptureStage::kWrite).Record(absl::Milliseconds(20));
+
+  const std::string summary = latencies.Summary();
+  EXPECT_THAT(summary, HasSubstr("settle         1   500.0ms"));
+  EXPECT_THAT(summary, HasSubstr("write          1    20.0ms"));
+  EXPECT_THAT(summary, HasSubstr("push           0"));
+
+  const std::string path = JoinPath({::testing::TempDir(), "latencies.csv"});
+  ASSERT_TRUE(latencies.WriteCsv(path).ok());
+
+  std::ifstream in(path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  EXPECT_THAT(contents.str(),
+              StartsWith("stage,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n"
+                         "push,0,0.000,0.000,0.000,0.000,0.000\n"
+                         "settle,1,500.000,500.000,500.000,500.000,500.000\n"));
+}
+
+}  // namespace
@@ -0,0 +1,83 @@
+#include "cmd/automap/pixel_selection.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "lib/file/file.h"
+#include "lib/file/path.h"
+#include "proto/points.pb.h"
+
+std::set<int> UnseenPixels(const proto::PixelRecords& records,
+                           const std::vector<int>& camera_numbers,
+                           int first_pixel, int last_pixel) {
+  std::set<int> unseen;
+  for (int i = first_pixel; i <= last_pixel; ++i) {
+    unseen.insert(i);
+  }
+
+  for (const proto::PixelRecord& record : records.pixel()) {
+    std::set<int> seen_by;
+    for (const proto::CameraPixelLocation& loc : record.camera_pixel()) {
+      if (loc.has_pixel_location()) {
+        seen_by.insert(loc.camera_number());
+      }
+    }
+
+    bool seen = !seen_by.empty();
+    for (const int camera_number : camera_numbers) {
+      seen = seen && seen_by.contains(camera_number);
+    }
+    if (seen) {
+      unseen.erase(record.pixel_number());
+    }
+  }
+
+  return unseen;
+}
+
+std::vector<int> SelectPixels(int first_pixel, int last_pixel,
+                              const std::set<int>* only) {
+  std::vector<int> pixels;
+  for (int i = first_pixel; i <= last_pixel; ++i) {
+    if (only == nullptr || only->contains(i)) {
+      pixels.push_back(i);
+    }
+  }
+  return pixels;
+}
+
+absl::StatusOr<std::vector<int>> RemoveCaptured(
+    const std::vector<int>& pixels, const std::vector<std::string>& dirs,
+    const std::string& pattern) {
+  const auto format = absl::ParsedFormat<'d'>::New(pattern);
+  if (format == nullptr) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("bad image name pattern %s", pattern));
+  }
+
+  std::vector<int> missing;
+  for (const int pixel : pixels) {
+    const std::string name = absl::StrFormat(*format, pixel);
+
+    bool captured = true;
+    for (const std::string& dir : dirs) {
+      absl::StatusOr<bool> exists = Exists(JoinPath({dir, name}));
+      if (!exists.ok()) {
+        return exists.status();
+      }
+      if (!*exists) {
+        captured = false;
+        break;
+      }
+    }
+
+    if (!captured) {
+      missing.push_back(pixel);
+    }
+  }
+
+  return missing;
+}
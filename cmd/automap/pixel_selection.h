@@ -0,0 +1,29 @@
+#ifndef _CMD_AUTOMAP_PIXEL_SELECTION_H_
+#define _CMD_AUTOMAP_PIXEL_SELECTION_H_ 1
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "proto/points.pb.h"
+
+// Returns the pixels in [first_pixel, last_pixel] that weren't found by every
+// one of the given cameras. An empty camera_numbers means any camera is good
+// enough.
+std::set<int> UnseenPixels(const proto::PixelRecords& records,
+                           const std::vector<int>& camera_numbers,
+                           int first_pixel, int last_pixel);
+
+// Returns the pixels in [first_pixel, last_pixel] to capture, in order. If
+// only is non-null, pixels not in it are skipped.
+std::vector<int> SelectPixels(int first_pixel, int last_pixel,
+                              const std::set<int>* only);
+
+// Removes the pixels whose images (named by the printf-style pattern, e.g.
+// "pixel_%03d.jpg") already exist in every one of dirs.
+absl::StatusOr<std::vector<int>> RemoveCaptured(
+    const std::vector<int>& pixels, const std::vector<std::string>& dirs,
+    const std::string& pattern);
+
+#endif  // _CMD_AUTOMAP_PIXEL_SELECTION_H_
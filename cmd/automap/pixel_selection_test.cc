@@ -0,0 +1,87 @@
+#include "cmd/automap/pixel_selection.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+#include "lib/file/writers.h"
+#include "lib/testing/file.h"
+#include "lib/testing/proto.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+TEST(UnseenPixelsTest, Test) {
+  const auto records = ParseTextProtoOrDie<proto::PixelRecords>(R"pb(
+    pixel {
+      pixel_number: 1
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 1 y: 1 }
+      }
+      camera_pixel {
+        camera_number: 2
+        pixel_location { x: 1 y: 1 }
+      }
+    }
+    pixel {
+      pixel_number: 2
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 1 y: 1 }
+      }
+      camera_pixel { camera_number: 2 }
+    }
+    pixel {
+      pixel_number: 3
+      camera_pixel { camera_number: 1 }
+    }
+    pixel {
+      pixel_number: 10
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 1 y: 1 }
+      }
+    }
+  )pb");
+
+  EXPECT_THAT(UnseenPixels(records, {1, 2}, 0, 4), ElementsAre(0, 2, 3, 4));
+  EXPECT_THAT(UnseenPixels(records, {1}, 0, 4), ElementsAre(0, 3, 4));
+  EXPECT_THAT(UnseenPixels(records, {}, 0, 4), ElementsAre(0, 3, 4));
+  EXPECT_THAT(UnseenPixels(records, {1}, 1, 2), IsEmpty());
+}
+
+TEST(SelectPixelsTest, Test) {
+  EXPECT_THAT(SelectPixels(2, 5, nullptr), ElementsAre(2, 3, 4, 5));
+
+  const std::set<int> only = {1, 3, 5, 7};
+  EXPECT_THAT(SelectPixels(2, 5, &only), ElementsAre(3, 5));
+}
+
+TEST(RemoveCapturedTest, Test) {
+  const std::string dir1 = MakeTestDir("camera_1");
+  const std::string dir2 = MakeTestDir("camera_2");
+
+  QCHECK_OK(WriteFile(JoinPath({dir1, "pixel_001.jpg"}), {""}));
+  QCHECK_OK(WriteFile(JoinPath({dir2, "pixel_001.jpg"}), {""}));
+  QCHECK_OK(WriteFile(JoinPath({dir1, "pixel_002.jpg"}), {""}));
+
+  absl::StatusOr<std::vector<int>> missing =
+      RemoveCaptured({0, 1, 2, 3}, {dir1, dir2}, "pixel_%03d.jpg");
+  ASSERT_TRUE(missing.ok()) << missing.status();
+  EXPECT_THAT(*missing, ElementsAre(0, 2, 3));
+
+  missing = RemoveCaptured({0, 1, 2, 3}, {dir1}, "pixel_%03d.jpg");
+  ASSERT_TRUE(missing.ok()) << missing.status();
+  EXPECT_THAT(*missing, ElementsAre(0, 3));
+
+  EXPECT_FALSE(RemoveCaptured({0}, {dir1}, "pixel.jpg").ok());
+}
+
+}  // namespace
@@ -1,47 +1,120 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/log/check.h"
 #include "ddp.h"
+#include "ddp_fanout.h"
+#include "ddp_probe.h"
 #include "net.h"
+#include "universe.h"
 
 ABSL_FLAG(std::string, controller, "", "host:port for DDP controller");
 ABSL_FLAG(int, num_pixels, -1, "Number of pixels on controller");
+ABSL_FLAG(std::string, controllers, "",
+          "Drive several controllers as one string, instead of --controller "
+          "and --num_pixels. See automap --controllers.");
 ABSL_FLAG(bool, all_on, false, "All on");
 ABSL_FLAG(bool, all_off, false, "All off");
 ABSL_FLAG(int, one_on, -1, "Pixel to turn on");
 ABSL_FLAG(int, color, 0xff'ff'ff, "color to use");
 ABSL_FLAG(int, max_chans_per_packet, 1440, "Max number of channels per packet");
 ABSL_FLAG(bool, verbose, false, "Verbose mode");
+ABSL_FLAG(int, probe, 0,
+          "Instead of setting pixels, measure each controller's round-trip "
+          "time and packet loss with this many DDP status queries");
+ABSL_FLAG(absl::Duration, probe_timeout, absl::Milliseconds(250),
+          "How long to wait for each probe reply");
+ABSL_FLAG(absl::Duration, probe_interval, absl::Milliseconds(10),
+          "Pause between probe queries");
 
 int main(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
 
-  QCHECK(!absl::GetFlag(FLAGS_controller).empty())
-      << "--controller is required";
+  if (const int samples = absl::GetFlag(FLAGS_probe); samples > 0) {
+    std::vector<std::tuple<std::string, int>> controllers;
+    if (const std::string spec = absl::GetFlag(FLAGS_controllers);
+        !spec.empty()) {
+      auto universe = ParseUniverseMap(spec, kDefaultDDPPort);
+      QCHECK_OK(universe);
+      for (const UniverseEntry& entry : *universe) {
+        controllers.emplace_back(entry.host, entry.port);
+      }
+    } else {
+      QCHECK(!absl::GetFlag(FLAGS_controller).empty())
+          << "--controller or --controllers is required";
+      controllers.push_back(
+          ParseHostPort(absl::GetFlag(FLAGS_controller), kDefaultDDPPort));
+      QCHECK(!std::get<0>(controllers.back()).empty())
+          << "Invalid controller host:port";
+    }
+
+    for (const auto& [host, port] : controllers) {
+      auto result = ProbeDDPController(
+          host, port,
+          {
+              .samples = samples,
+              .timeout = absl::GetFlag(FLAGS_probe_timeout),
+              .interval = absl::GetFlag(FLAGS_probe_interval),
+          });
+      QCHECK_OK(result);
+      std::cout << host << ":" << port << ": " << FormatDDPProbeResult(*result)
+                << "\n";
+      if (absl::GetFlag(FLAGS_verbose) && !result->status.empty()) {
+        std::cout << "  status: " << result->status << "\n";
+      }
+    }
+    return 0;
+  }
 
-  auto [host, port] =
-      ParseHostPort(absl::GetFlag(FLAGS_controller), kDefaultDDPPort);
-  QCHECK(!host.empty()) << "Invalid controller host:port";
+  std::unique_ptr<DDPOutput> conn;
+  if (const std::string spec = absl::GetFlag(FLAGS_controllers);
+      !spec.empty()) {
+    auto universe = ParseUniverseMap(spec, kDefaultDDPPort);
+    QCHECK_OK(universe);
 
-  QCHECK_NE(absl::GetFlag(FLAGS_num_pixels), -1) << "--num_pixels is required";
-  const int num_pixels = absl::GetFlag(FLAGS_num_pixels);
-  QCHECK_GT(num_pixels, 0) << "invalid number of pixels";
+    auto fanout = DDPFanout::Create(
+        *universe,
+        {
+            .max_chans_per_packet = absl::GetFlag(FLAGS_max_chans_per_packet),
+            .verbose = absl::GetFlag(FLAGS_verbose),
+        });
+    QCHECK_OK(fanout);
+    conn = std::move(*fanout);
+  } else {
+    QCHECK(!absl::GetFlag(FLAGS_controller).empty())
+        << "--controller or --controllers is required";
 
-  auto conn = DDPConn::Create(
-      host, port,
-      {
-          .num_pixels = absl::GetFlag(FLAGS_num_pixels),
-          .max_chans_per_packet = absl::GetFlag(FLAGS_max_chans_per_packet),
-          .verbose = absl::GetFlag(FLAGS_verbose),
-      });
-  QCHECK(conn.ok()) << conn.status().ToString();
+    auto [host, port] =
+        ParseHostPort(absl::GetFlag(FLAGS_controller), kDefaultDDPPort);
+    QCHECK(!host.empty()) << "Invalid controller host:port";
+
+    QCHECK_NE(absl::GetFlag(FLAGS_num_pixels), -1)
+        << "--num_pixels is required";
+    const int num_pixels = absl::GetFlag(FLAGS_num_pixels);
+    QCHECK_GT(num_pixels, 0) << "invalid number of pixels";
+
+    auto ddp_conn = DDPConn::Create(
+        host, port,
+        {
+            .num_pixels = num_pixels,
+            .max_chans_per_packet = absl::GetFlag(FLAGS_max_chans_per_packet),
+            .verbose = absl::GetFlag(FLAGS_verbose),
+        });
+    QCHECK(ddp_conn.ok()) << ddp_conn.status().ToString();
+    conn = std::move(*ddp_conn);
+  }
 
   if (absl::GetFlag(FLAGS_all_on)) {
-    QCHECK_OK((*conn)->SetAll(absl::GetFlag(FLAGS_color)));
+    QCHECK_OK(conn->SetAll(absl::GetFlag(FLAGS_color)));
   } else if (absl::GetFlag(FLAGS_all_off)) {
-    QCHECK_OK((*conn)->SetAll(0));
+    QCHECK_OK(conn->SetAll(0));
   } else if (int idx = absl::GetFlag(FLAGS_one_on); idx > 0) {
-    QCHECK_OK((*conn)->OnlyOne(idx, absl::GetFlag(FLAGS_color)));
+    QCHECK_OK(conn->OnlyOne(idx, absl::GetFlag(FLAGS_color)));
   } else {
     QCHECK(false) << "no command specified";
   }
@@ -0,0 +1,100 @@
+#include "cmd/automap/settle.h"
+
+#include "absl/log/log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/stream_reader.h"
+#include "opencv2/opencv.hpp"
+
+SettleDetector::SettleDetector(const Options& options, bool expect_change)
+    : options_(options), changed_(!expect_change), num_stable_(0) {}
+
+bool SettleDetector::Update(int changed_from_baseline,
+                            int changed_from_previous) {
+  if (!changed_) {
+    changed_ = changed_from_baseline >= options_.change_pixels;
+    return false;
+  }
+
+  if (changed_from_previous > options_.stable_pixels) {
+    num_stable_ = 0;
+    return false;
+  }
+
+  return ++num_stable_ >= options_.stable_frames;
+}
+
+cv::Mat FrameSettler::Shrink(cv::Mat frame) {
+  cv::Mat gray;
+  cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+  if (options_.scale <= 1) {
+    return gray;
+  }
+
+  // Averaging would dim a light covering a pixel or two below pixel_level,
+  // so each block is replaced by its brightest pixel instead. Dilating with
+  // the anchor at the kernel's corner puts each block's maximum at its top
+  // left pixel, which is the one nearest-neighbor resizing keeps.
+  const int scale = options_.scale;
+  cv::Mat brightest, small;
+  cv::dilate(gray, brightest,
+             cv::getStructuringElement(cv::MORPH_RECT, cv::Size(scale, scale),
+                                       cv::Point(0, 0)),
+             cv::Point(0, 0));
+  cv::resize(brightest, small, cv::Size(), 1.0 / scale, 1.0 / scale,
+             cv::INTER_NEAREST);
+  return small;
+}
+
+int FrameSettler::CountChanged(cv::Mat a, cv::Mat b) {
+  cv::Mat diff, threshold;
+  cv::absdiff(a, b, diff);
+  cv::threshold(diff, threshold, options_.pixel_level, 255, cv::THRESH_BINARY);
+  return cv::countNonZero(threshold);
+}
+
+SettleResult FrameSettler::Wait(StreamReader& reader, cv::Mat baseline,
+                                absl::Time push_time, bool expect_change) {
+  const absl::Time deadline = push_time + options_.timeout;
+  const cv::Mat small_baseline = Shrink(baseline);
+
+  // Start with the first frame captured after the push could have taken
+  // effect; anything older can't show it.
+  uint64_t seq = 0;
+  cv::Mat next;
+  if (auto first = reader.WaitForFrameAfter(push_time + options_.min_latency,
+                                            deadline);
+      first.has_value()) {
+    next = first->value;
+    seq = first->seq;
+  }
+
+  SettleDetector detector(options_.detector, expect_change);
+  cv::Mat frame, small_prev;
+  absl::Time stable_since = push_time;
+  for (; !next.empty(); next = reader.WaitForNextFrame(&seq, deadline)) {
+    frame = next;
+
+    cv::Mat small = Shrink(frame);
+    const int from_baseline = CountChanged(small_baseline, small);
+    const int from_prev =
+        small_prev.empty() ? from_baseline : CountChanged(small_prev, small);
+    small_prev = small;
+
+    if (from_prev > options_.detector.stable_pixels) {
+      stable_since = absl::Now();
+    }
+    if (detector.Update(from_baseline, from_prev)) {
+      return {.frame = frame,
+              .settled = true,
+              .latency = stable_since - push_time};
+    }
+  }
+
+  LOG(WARNING) << "timed out waiting for frames to settle (changed="
+               << detector.changed() << ")";
+  if (frame.empty()) {
+    frame = reader.CurrentFrame();
+  }
+  return {.frame = frame, .settled = false, .latency = options_.timeout};
+}
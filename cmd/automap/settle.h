@@ -0,0 +1,88 @@
+#ifndef _CMD_AUTOMAP_SETTLE_H_
+#define _CMD_AUTOMAP_SETTLE_H_ 1
+
+#include "absl/time/time.h"
+#include "cmd/automap/stream_reader.h"
+#include "opencv2/core/mat.hpp"
+
+// Decides, one frame at a time, when the lights have settled after a DDP push:
+// the frame must first differ visibly from the frame before the push, and
+// must then stop changing for a number of consecutive frames. Pushes that
+// aren't expected to change anything need only the steady frames.
+class SettleDetector {
+ public:
+  struct Options {
+    // Number of (changed) pixels that must differ from the baseline before
+    // the push is considered to have taken effect.
+    int change_pixels = 2;
+
+    // Maximum number of pixels that may differ between consecutive frames for
+    // them to be considered steady.
+    int stable_pixels = 1;
+
+    // Number of consecutive steady frames needed after the change.
+    int stable_frames = 3;
+  };
+
+  SettleDetector(const Options& options, bool expect_change);
+  ~SettleDetector() = default;
+
+  // Supplies the measurements for the next frame. Returns true once the
+  // lights have settled.
+  bool Update(int changed_from_baseline, int changed_from_previous);
+
+  bool changed() const { return changed_; }
+
+ private:
+  const Options options_;
+  bool changed_;
+  int num_stable_;
+};
+
+struct SettleResult {
+  cv::Mat frame;  // the most recent frame
+  bool settled;   // false if the timeout expired first
+  absl::Duration latency;
+};
+
+// Watches the camera stream after a DDP push, returning as soon as the lights
+// have settled rather than after a fixed delay.
+class FrameSettler {
+ public:
+  struct Options {
+    SettleDetector::Options detector;
+
+    // Upper bound on the time spent waiting.
+    absl::Duration timeout = absl::Seconds(1);
+
+    // Frames captured sooner than this after the push are assumed not to
+    // show it yet (e.g. because the controller can't have received it).
+    absl::Duration min_latency = absl::ZeroDuration();
+
+    // Grayscale level difference at which a pixel is considered changed.
+    int pixel_level = 40;
+
+    // Frames are shrunk by this factor before comparison to save time. Each
+    // shrunk pixel is the brightest of those it covers, so that a single
+    // small light still registers.
+    int scale = 4;
+  };
+
+  explicit FrameSettler(const Options& options) : options_(options) {}
+  ~FrameSettler() = default;
+
+  // Waits for `reader` to show a settled frame. `baseline` is a frame
+  // captured before the push, which was made at `push_time`. If
+  // `expect_change` is false, as for a push that may leave the lights as they
+  // were, steady frames are enough.
+  SettleResult Wait(StreamReader& reader, cv::Mat baseline,
+                    absl::Time push_time, bool expect_change);
+
+ private:
+  cv::Mat Shrink(cv::Mat frame);
+  int CountChanged(cv::Mat a, cv::Mat b);
+
+  const Options options_;
+};
+
+#endif  // _CMD_AUTOMAP_SETTLE_H_
@@ -0,0 +1,120 @@
+#include "cmd/automap/settle.h"
+
+#include <utility>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/stream_reader.h"
+#include "gtest/gtest.h"
+#include "opencv2/core/mat.hpp"
+
+namespace {
+
+TEST(SettleDetectorTest, WaitsForChangeThenStable) {
+  SettleDetector detector(
+      {.change_pixels = 5, .stable_pixels = 1, .stable_frames = 2},
+      /*expect_change=*/true);
+
+  // Nothing has changed yet, so stable frames don't count.
+  EXPECT_FALSE(detector.Update(0, 0));
+  EXPECT_FALSE(detector.Update(4, 0));
+  EXPECT_FALSE(detector.changed());
+
+  EXPECT_FALSE(detector.Update(10, 10));
+  EXPECT_TRUE(detector.changed());
+
+  EXPECT_FALSE(detector.Update(20, 10));  // still changing
+  EXPECT_FALSE(detector.Update(20, 1));   // stable 1
+  EXPECT_FALSE(detector.Update(25, 5));   // unstable again
+  EXPECT_FALSE(detector.Update(25, 0));   // stable 1
+  EXPECT_TRUE(detector.Update(25, 1));    // stable 2
+}
+
+TEST(SettleDetectorTest, ImmediatelyStable) {
+  SettleDetector detector(
+      {.change_pixels = 1, .stable_pixels = 0, .stable_frames = 1},
+      /*expect_change=*/true);
+
+  EXPECT_FALSE(detector.Update(3, 3));
+  EXPECT_TRUE(detector.Update(3, 0));
+}
+
+TEST(SettleDetectorTest, NoChangeExpected) {
+  SettleDetector detector(
+      {.change_pixels = 5, .stable_pixels = 1, .stable_frames = 2},
+      /*expect_change=*/false);
+
+  EXPECT_TRUE(detector.changed());
+  EXPECT_FALSE(detector.Update(0, 0));
+  EXPECT_TRUE(detector.Update(0, 1));
+}
+
+// Publishes the next scripted frame whenever the settler looks for one,
+// repeating the last frame once the script runs out.
+class ScriptedStreamReader : public StreamReader {
+ public:
+  explicit ScriptedStreamReader(std::vector<cv::Mat> frames)
+      : StreamReader({}), frames_(std::move(frames)), next_(0) {}
+
+  void Read() override {}
+
+ protected:
+  void Refresh(absl::Time after) override {
+    PublishFrame(frames_[next_], absl::Now());
+    if (next_ + 1 < frames_.size()) {
+      ++next_;
+    }
+  }
+
+ private:
+  const std::vector<cv::Mat> frames_;
+  size_t next_;
+};
+
+cv::Mat DarkFrame() { return cv::Mat(64, 64, CV_8UC3, cv::Scalar::all(0)); }
+
+FrameSettler::Options TestOptions() {
+  return {
+      .detector = {.change_pixels = 1, .stable_pixels = 0, .stable_frames = 2},
+      .timeout = absl::Milliseconds(100),
+  };
+}
+
+TEST(FrameSettlerTest, SettlesAfterSmallLight) {
+  // A single lit pixel is all that distinguishes the frames.
+  cv::Mat lit = DarkFrame();
+  lit.at<cv::Vec3b>(21, 33) = cv::Vec3b(255, 255, 255);
+  ScriptedStreamReader reader({DarkFrame(), lit});
+
+  FrameSettler settler(TestOptions());
+  SettleResult result =
+      settler.Wait(reader, DarkFrame(), absl::Now() - absl::Milliseconds(1),
+                   /*expect_change=*/true);
+  EXPECT_TRUE(result.settled);
+  EXPECT_EQ(result.frame.at<cv::Vec3b>(21, 33), cv::Vec3b(255, 255, 255));
+}
+
+TEST(FrameSettlerTest, TimesOutWithoutExpectedChange) {
+  ScriptedStreamReader reader({DarkFrame()});
+
+  FrameSettler settler(TestOptions());
+  SettleResult result =
+      settler.Wait(reader, DarkFrame(), absl::Now() - absl::Milliseconds(1),
+                   /*expect_change=*/true);
+  EXPECT_FALSE(result.settled);
+  EXPECT_FALSE(result.frame.empty());
+}
+
+TEST(FrameSettlerTest, SettlesWithoutChangeIfNoneExpected) {
+  ScriptedStreamReader reader({DarkFrame()});
+
+  FrameSettler settler(TestOptions());
+  SettleResult result =
+      settler.Wait(reader, DarkFrame(), absl::Now() - absl::Milliseconds(1),
+                   /*expect_change=*/false);
+  EXPECT_TRUE(result.settled);
+  EXPECT_LT(result.latency, absl::Milliseconds(100));
+}
+
+}  // namespace
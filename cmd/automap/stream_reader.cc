@@ -1,45 +1,96 @@
 #include "cmd/automap/stream_reader.h"
 
 #include "absl/log/log.h"
-#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "opencv2/opencv.hpp"
 
-cv::Mat StreamReader::WaitForFrame() {
-  auto has_frame = [this]() {
-    mu_.AssertReaderHeld();
-    return !current_frame_.empty();
-  };
+namespace {
+
+// Frames are published without locks, so waiters poll. This is far shorter
+// than any camera's frame interval.
+constexpr absl::Duration kPollInterval = absl::Milliseconds(1);
+
+}  // namespace
 
-  absl::MutexLock lock(&mu_);
-  mu_.Await(absl::Condition(&has_frame));
-  return current_frame_;
+cv::Mat StreamReader::WaitForFrame() {
+  for (;;) {
+    Refresh(absl::InfinitePast());
+    if (auto latest = ring_.Latest(); latest.has_value()) {
+      return latest->value;
+    }
+    if (should_stop()) {
+      return cv::Mat();
+    }
+    absl::SleepFor(kPollInterval);
+  }
 }
 
 cv::Mat StreamReader::CurrentFrame() {
-  absl::MutexLock lock(&mu_);
-  return current_frame_;
+  Refresh(absl::InfinitePast());
+  if (auto latest = ring_.Latest(); latest.has_value()) {
+    return latest->value;
+  }
+  return cv::Mat();
 }
 
-void StreamReader::Stop() {
-  absl::MutexLock lock(&mu_);
-  should_stop_ = true;
+cv::Mat StreamReader::WaitForNextFrame(uint64_t* seq, absl::Time deadline) {
+  for (;;) {
+    Refresh(absl::InfinitePast());
+    if (ring_.latest_seq() > *seq) {
+      if (auto latest = ring_.Latest(); latest.has_value()) {
+        *seq = latest->seq;
+        return latest->value;
+      }
+    }
+    if (absl::Now() >= deadline || should_stop()) {
+      return cv::Mat();
+    }
+    absl::SleepFor(kPollInterval);
+  }
 }
 
-void VideoCaptureStreamReader::Read() {
+std::optional<StreamFrame> StreamReader::WaitForFrameAfter(
+    absl::Time after, absl::Time deadline) {
+  uint64_t checked_seq = 0;
   for (;;) {
-    {
-      absl::MutexLock lock(&mu_);
-      if (should_stop_) {
-        return;
+    Refresh(after);
+    if (const uint64_t seq = ring_.latest_seq(); seq > checked_seq) {
+      if (auto frame = ring_.FirstAfter(after); frame.has_value()) {
+        return frame;
       }
+      checked_seq = seq;
     }
+    if (absl::Now() >= deadline || should_stop()) {
+      return std::nullopt;
+    }
+    absl::SleepFor(kPollInterval);
+  }
+}
+
+void StreamReader::Stop() { should_stop_ = true; }
 
+void StreamReader::PublishFrame(cv::Mat frame, absl::Time captured) {
+  if (!ring_.Publish(frame, captured)) {
+    LOG(WARNING) << "frame ring full; dropped frame";
+  }
+}
+
+void VideoCaptureStreamReader::Read() {
+  if (options_.lazy_decode) {
+    ReadLazy();
+  } else {
+    ReadEager();
+  }
+}
+
+void VideoCaptureStreamReader::ReadEager() {
+  while (!should_stop()) {
     if (!stream_->grab()) {
-      absl::MutexLock lock(&mu_);
-      mu_.AwaitWithTimeout(absl::Condition(&should_stop_),
-                           absl::Milliseconds(10));
+      absl::SleepFor(absl::Milliseconds(10));
       continue;
     }
+    const absl::Time captured = absl::Now();
 
     cv::Mat frame;
     stream_->retrieve(frame);
@@ -50,7 +101,90 @@ void VideoCaptureStreamReader::Read() {
 
     LOG_IF(INFO, options_.verbose) << "read frame";
 
-    absl::MutexLock lock(&mu_);
-    current_frame_ = frame;
+    PublishFrame(frame, captured);
+  }
+}
+
+void VideoCaptureStreamReader::ReadLazy() {
+  auto can_grab = [this]() {
+    stream_mu_.AssertReaderHeld();
+    return !stream_busy_ && num_waiting_to_retrieve_ == 0;
+  };
+
+  while (!should_stop()) {
+    {
+      absl::MutexLock lock(&stream_mu_);
+      stream_mu_.Await(absl::Condition(&can_grab));
+      stream_busy_ = true;
+    }
+
+    const bool grabbed = stream_->grab();
+
+    {
+      absl::MutexLock lock(&stream_mu_);
+      stream_busy_ = false;
+      if (grabbed) {
+        grab_time_ns_ = absl::ToUnixNanos(absl::Now());
+        ++num_grabbed_;
+      }
+    }
+
+    if (!grabbed) {
+      absl::SleepFor(absl::Milliseconds(10));
+      continue;
+    }
+
+    LOG_IF(INFO, options_.verbose) << "grabbed frame";
+  }
+}
+
+void VideoCaptureStreamReader::Refresh(absl::Time after) {
+  if (!options_.lazy_decode) {
+    return;
+  }
+
+  // Cheap checks first, so pollers don't contend with the reader thread.
+  if (absl::FromUnixNanos(grab_time_ns_.load()) <= after) {
+    return;
   }
+
+  auto stream_idle = [this]() {
+    stream_mu_.AssertReaderHeld();
+    return !stream_busy_;
+  };
+
+  uint64_t num_grabbed;
+  {
+    absl::MutexLock lock(&stream_mu_);
+    if (num_grabbed_.load() == num_decoded_) {
+      return;
+    }
+
+    // Waits for any grab in progress, which yields a newer frame.
+    ++num_waiting_to_retrieve_;
+    stream_mu_.Await(absl::Condition(&stream_idle));
+    --num_waiting_to_retrieve_;
+
+    // Another caller may have decoded the frame while this one waited.
+    num_grabbed = num_grabbed_.load();
+    if (num_grabbed == num_decoded_) {
+      return;
+    }
+    num_decoded_ = num_grabbed;
+    stream_busy_ = true;
+  }
+
+  // Publishing while the stream is still marked busy keeps decoders from
+  // publishing at the same time.
+  cv::Mat frame;
+  stream_->retrieve(frame);
+  if (frame.empty()) {
+    LOG(WARNING) << "empty frame retrieved";
+  } else {
+    LOG_IF(INFO, options_.verbose) << "decoded frame " << num_grabbed;
+    PublishFrame(frame, absl::FromUnixNanos(grab_time_ns_.load()));
+  }
+
+  absl::MutexLock lock(&stream_mu_);
+  stream_busy_ = false;
 }
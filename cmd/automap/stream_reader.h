@@ -1,30 +1,68 @@
 #ifndef _CMD_AUTOMAP_STREAM_READER_H_
 #define _CMD_AUTOMAP_STREAM_READER_H_ 1
 
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+#include "absl/base/thread_annotations.h"
 #include "absl/log/log.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "cmd/automap/frame_ring.h"
 #include "opencv2/opencv.hpp"
 
+using StreamFrame = FrameRing<cv::Mat>::Entry;
+
 class StreamReader {
  public:
   struct Options {
     bool verbose = false;
+
+    // Number of recent frames to retain.
+    int ring_size = 8;
+
+    // If true, the reader thread only grabs frames to keep the stream
+    // current, and the most recent one is decoded when a caller asks for it.
+    // Supported by VideoCaptureStreamReader.
+    bool lazy_decode = false;
   };
 
   StreamReader(const Options& options)
-      : should_stop_(false), options_(options) {}
+      : ring_(options.ring_size), should_stop_(false), options_(options) {}
   virtual ~StreamReader() = default;
 
   virtual void Read() = 0;
 
   cv::Mat WaitForFrame();
   cv::Mat CurrentFrame();
+
+  // Waits for a frame newer than the one identified by *seq (0 for any
+  // frame). On success *seq is updated to identify the returned frame. Returns
+  // an empty Mat if no such frame arrives by the deadline.
+  cv::Mat WaitForNextFrame(uint64_t* seq, absl::Time deadline);
+
+  // Waits for the first frame captured after `after`, which is typically the
+  // time of a DDP push. Returns nullopt if no such frame arrives by the
+  // deadline.
+  std::optional<StreamFrame> WaitForFrameAfter(absl::Time after,
+                                               absl::Time deadline);
+
   void Stop();
 
  protected:
-  absl::Mutex mu_;
-  cv::Mat current_frame_;
-  bool should_stop_;
+  // Publishes a newly-captured frame. Must only be called by one thread at a
+  // time.
+  void PublishFrame(cv::Mat frame, absl::Time captured);
+
+  // Called before frames are read from the ring, giving lazily-decoding
+  // readers a chance to publish a frame captured after `after`.
+  virtual void Refresh(absl::Time after) {}
+
+  bool should_stop() const { return should_stop_.load(); }
+
+  FrameRing<cv::Mat> ring_;
+  std::atomic<bool> should_stop_;
   const Options options_;
 };
 
@@ -32,14 +70,42 @@ class VideoCaptureStreamReader : public StreamReader {
  public:
   VideoCaptureStreamReader(const Options& options,
                            std::unique_ptr<cv::VideoCapture> stream)
-      : StreamReader(options), stream_(std::move(stream)) {}
+      : StreamReader(options),
+        stream_(std::move(stream)),
+        stream_busy_(false),
+        num_waiting_to_retrieve_(0),
+        num_grabbed_(0),
+        grab_time_ns_(0),
+        num_decoded_(0) {}
 
   ~VideoCaptureStreamReader() override { stream_.release(); }
 
   void Read() override;
 
+ protected:
+  void Refresh(absl::Time after) override;
+
  private:
+  void ReadEager();
+  void ReadLazy();
+
+  // In lazy mode the stream is shared between the reader thread, which grabs,
+  // and callers, which retrieve. Only one of them may use it at a time, but
+  // grabbing waits for the camera, so stream_mu_ isn't held while they do.
+  // Instead, stream_busy_ marks the stream as in use.
+  absl::Mutex stream_mu_;
   std::unique_ptr<cv::VideoCapture> stream_;
+  bool stream_busy_ ABSL_GUARDED_BY(stream_mu_);
+
+  // Callers waiting to retrieve, who go before the reader thread's next grab
+  // so that it can't starve them.
+  int num_waiting_to_retrieve_ ABSL_GUARDED_BY(stream_mu_);
+
+  // Lazy mode bookkeeping. The atomics let callers check for new frames
+  // without taking stream_mu_.
+  std::atomic<uint64_t> num_grabbed_;
+  std::atomic<int64_t> grab_time_ns_;
+  uint64_t num_decoded_ ABSL_GUARDED_BY(stream_mu_);
 };
 
 #endif  // _CMD_AUTOMAP_STREAM_READER_H_
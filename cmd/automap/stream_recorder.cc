@@ -0,0 +1,96 @@
+#include "cmd/automap/stream_recorder.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "lib/file/stream_align.h"
+#include "lib/file/writers.h"
+#include "opencv2/videoio.hpp"
+
+namespace {
+
+// How long the recording thread waits for a frame before checking whether
+// it's been stopped.
+constexpr absl::Duration kFrameWait = absl::Milliseconds(100);
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<StreamRecorder>> StreamRecorder::Create(
+    StreamReader* reader, const Options& options) {
+  cv::Mat first = reader->WaitForFrame();
+  if (first.empty()) {
+    return absl::UnavailableError("stream stopped before its first frame");
+  }
+
+  auto writer = std::make_unique<cv::VideoWriter>(
+      options.video_path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+      options.fps, first.size());
+  if (!writer->isOpened()) {
+    return absl::UnknownError(
+        absl::StrCat("failed to open ", options.video_path));
+  }
+
+  return std::unique_ptr<StreamRecorder>(
+      new StreamRecorder(reader, options, std::move(writer)));
+}
+
+StreamRecorder::StreamRecorder(StreamReader* reader, const Options& options,
+                               std::unique_ptr<cv::VideoWriter> writer)
+    : reader_(reader),
+      options_(options),
+      start_(absl::Now()),
+      writer_(std::move(writer)),
+      stopping_(false) {
+  thread_ = std::thread([this] { Run(); });
+}
+
+StreamRecorder::~StreamRecorder() {
+  if (thread_.joinable()) {
+    Stop().IgnoreError();
+  }
+}
+
+void StreamRecorder::Run() {
+  absl::Time last = start_;
+  for (;;) {
+    // Checked before waiting, so that one last pass picks up everything
+    // captured before Stop was called.
+    const bool stopping = stopping_.load();
+
+    std::optional<StreamFrame> frame = reader_->WaitForFrameAfter(
+        last, stopping ? absl::Now() : absl::Now() + kFrameWait);
+    if (!frame.has_value()) {
+      if (stopping) {
+        return;
+      }
+      continue;
+    }
+
+    writer_->write(frame->value);
+    times_.push_back(frame->captured);
+    last = frame->captured;
+  }
+}
+
+absl::Status StreamRecorder::Stop() {
+  stopping_ = true;
+  thread_.join();
+  writer_->release();
+
+  LOG(INFO) << "recorded " << times_.size() << " frames to "
+            << options_.video_path;
+
+  std::vector<std::string> lines;
+  for (int i = 0; i < static_cast<int>(times_.size()); ++i) {
+    lines.push_back(FormatStreamFrameTime({.index = i, .time = times_[i]}));
+  }
+  return WriteFile(options_.times_path, lines);
+}
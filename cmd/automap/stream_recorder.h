@@ -0,0 +1,63 @@
+#ifndef _CMD_AUTOMAP_STREAM_RECORDER_H_
+#define _CMD_AUTOMAP_STREAM_RECORDER_H_ 1
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "cmd/automap/stream_reader.h"
+#include "opencv2/videoio.hpp"
+
+// Records every frame a camera delivers, from when the recorder is created
+// until it's stopped, to a video file. The capture time of each frame is
+// written to a separate file (see lib/file/stream_align.h) so the frames
+// can later be matched with the pushes made while recording.
+class StreamRecorder {
+ public:
+  struct Options {
+    // Motion JPEG in an AVI container, which OpenCV can always write.
+    std::string video_path;
+    std::string times_path;
+
+    // Only used for the video's metadata; frames are recorded as they
+    // arrive.
+    double fps = 30;
+  };
+
+  // Waits for the reader's first frame, to learn the frame size, then starts
+  // recording.
+  static absl::StatusOr<std::unique_ptr<StreamRecorder>> Create(
+      StreamReader* reader, const Options& options);
+
+  ~StreamRecorder();
+
+  // Records any frames captured before the call, stops recording, and writes
+  // the frame times.
+  absl::Status Stop();
+
+  int num_frames() const { return times_.size(); }
+
+ private:
+  StreamRecorder(StreamReader* reader, const Options& options,
+                 std::unique_ptr<cv::VideoWriter> writer);
+
+  void Run();
+
+  StreamReader* const reader_;
+  const Options options_;
+  const absl::Time start_;
+  std::unique_ptr<cv::VideoWriter> writer_;
+
+  // Written only by the recording thread until it's joined.
+  std::vector<absl::Time> times_;
+
+  std::atomic<bool> stopping_;
+  std::thread thread_;
+};
+
+#endif  // _CMD_AUTOMAP_STREAM_RECORDER_H_
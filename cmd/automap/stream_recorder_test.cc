@@ -0,0 +1,67 @@
+#include "cmd/automap/stream_recorder.h"
+
+#include <string>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+#include "lib/file/stream_align.h"
+#include "opencv2/opencv.hpp"
+
+namespace {
+
+// A stream whose frames are published by the test.
+class TestStreamReader : public StreamReader {
+ public:
+  TestStreamReader() : StreamReader({.ring_size = 16}) {}
+
+  void Read() override {}
+
+  void Publish(int value, absl::Time captured) {
+    PublishFrame(cv::Mat(48, 64, CV_8UC3, cv::Scalar::all(value)), captured);
+  }
+};
+
+TEST(StreamRecorderTest, Test) {
+  TestStreamReader reader;
+  reader.Publish(0, absl::Now() - absl::Seconds(1));
+
+  const std::string video_path =
+      JoinPath({testing::TempDir(), "stream_recorder.avi"});
+  const std::string times_path =
+      JoinPath({testing::TempDir(), "stream_recorder.csv"});
+  auto recorder = StreamRecorder::Create(
+      &reader, {.video_path = video_path, .times_path = times_path});
+  ASSERT_TRUE(recorder.ok()) << recorder.status();
+
+  // Frames captured before the recorder was created aren't recorded.
+  const absl::Time start = absl::Now();
+  for (int i = 1; i <= 5; ++i) {
+    reader.Publish(i * 40, start + absl::Milliseconds(i * 33));
+  }
+  ASSERT_TRUE((*recorder)->Stop().ok());
+  EXPECT_EQ((*recorder)->num_frames(), 5);
+
+  auto times = ReadStreamFrameTimes(times_path);
+  ASSERT_TRUE(times.ok()) << times.status();
+  ASSERT_EQ(times->size(), 5);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ((*times)[i].index, i);
+    EXPECT_EQ((*times)[i].time,
+              absl::FromUnixMicros(absl::ToUnixMicros(
+                  start + absl::Milliseconds((i + 1) * 33))));
+  }
+
+  cv::VideoCapture video(video_path);
+  ASSERT_TRUE(video.isOpened());
+  cv::Mat frame;
+  for (int i = 1; i <= 5; ++i) {
+    ASSERT_TRUE(video.read(frame)) << i;
+    EXPECT_EQ(frame.size(), cv::Size(64, 48));
+    EXPECT_NEAR(frame.at<cv::Vec3b>(10, 10)[0], i * 40, 5) << i;
+  }
+  EXPECT_FALSE(video.read(frame));
+}
+
+}  // namespace
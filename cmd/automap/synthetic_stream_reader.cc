@@ -0,0 +1,76 @@
+#include "cmd/automap/synthetic_stream_reader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "cmd/automap/ddp_receiver.h"
+#include "lib/geometry/projection.h"
+#include "opencv2/core/mat.hpp"
+#include "opencv2/imgproc.hpp"
+
+SyntheticStreamReader::SyntheticStreamReader(const Options& options,
+                                             const DDPReceiver* receiver)
+    : StreamReader(options.reader),
+      synthetic_options_(options),
+      receiver_(receiver) {
+  for (const std::optional<XYZPos>& pixel : options.pixels) {
+    if (!pixel.has_value()) {
+      image_coords_.push_back(std::nullopt);
+      continue;
+    }
+
+    const XYPos pos =
+        ProjectToCamera(options.camera_number, *pixel, options.metadata);
+    image_coords_.push_back(cv::Point(std::lround(pos.x), std::lround(pos.y)));
+  }
+}
+
+void SyntheticStreamReader::Read() {
+  const Options& options = synthetic_options_;
+
+  uint64_t shown_number = 0;
+  cv::Mat frame = Render({});
+
+  while (!should_stop()) {
+    const absl::Time now = absl::Now();
+
+    std::optional<DDPReceiver::Frame> ddp_frame = receiver_->LatestFrame();
+    if (ddp_frame.has_value() && ddp_frame->number != shown_number &&
+        ddp_frame->received + options.latency <= now) {
+      frame = Render(ddp_frame->chans);
+      shown_number = ddp_frame->number;
+    }
+
+    // Published frames are never modified, because Render always returns a
+    // new Mat.
+    PublishFrame(frame, now);
+    absl::SleepFor(options.frame_interval);
+  }
+}
+
+cv::Mat SyntheticStreamReader::Render(const std::vector<char>& chans) const {
+  const Options& options = synthetic_options_;
+
+  cv::Mat frame(options.metadata.res_v, options.metadata.res_h, CV_8UC3,
+                options.background);
+
+  const int num_pixels =
+      std::min<int>(chans.size() / 3, image_coords_.size());
+  for (int i = 0; i < num_pixels; ++i) {
+    const unsigned char r = chans[i * 3];
+    const unsigned char g = chans[i * 3 + 1];
+    const unsigned char b = chans[i * 3 + 2];
+    if ((r == 0 && g == 0 && b == 0) || !image_coords_[i].has_value()) {
+      continue;
+    }
+
+    cv::circle(frame, *image_coords_[i], options.blob_radius,
+               cv::Scalar(b, g, r), cv::FILLED);
+  }
+
+  return frame;
+}
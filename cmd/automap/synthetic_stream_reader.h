@@ -0,0 +1,54 @@
+#ifndef _CMD_AUTOMAP_SYNTHETIC_STREAM_READER_H_
+#define _CMD_AUTOMAP_SYNTHETIC_STREAM_READER_H_ 1
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "cmd/automap/ddp_receiver.h"
+#include "cmd/automap/stream_reader.h"
+#include "lib/geometry/camera_metadata.h"
+#include "lib/geometry/points.h"
+#include "opencv2/core/types.hpp"
+
+// A camera that renders the frames sent to an in-process DDPReceiver, given
+// the ground-truth world location of each pixel. Lit pixels are drawn as
+// blobs in their colors at the positions where the camera would see them.
+class SyntheticStreamReader : public StreamReader {
+ public:
+  struct Options {
+    StreamReader::Options reader;
+
+    int camera_number;
+    CameraMetadata metadata;
+
+    // World location of each pixel, indexed by pixel number. Pixels without
+    // locations are never seen.
+    std::vector<std::optional<XYZPos>> pixels;
+
+    int blob_radius = 4;
+    cv::Scalar background = cv::Scalar(20, 20, 20);
+
+    // How often frames are produced, and how long DDP frames take to show up
+    // in them.
+    absl::Duration frame_interval = absl::Milliseconds(33);
+    absl::Duration latency = absl::Milliseconds(50);
+  };
+
+  SyntheticStreamReader(const Options& options, const DDPReceiver* receiver);
+
+  void Read() override;
+
+  // Renders the camera's view of a set of channel values.
+  cv::Mat Render(const std::vector<char>& chans) const;
+
+ private:
+  const Options synthetic_options_;
+  const DDPReceiver* const receiver_;
+
+  // Where each pixel appears in the image.
+  std::vector<std::optional<cv::Point>> image_coords_;
+};
+
+#endif  // _CMD_AUTOMAP_SYNTHETIC_STREAM_READER_H_
@@ -0,0 +1,50 @@
+#include "cmd/automap/synthetic_stream_reader.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/geometry/camera_metadata.h"
+#include "lib/geometry/translation.h"
+#include "opencv2/core/mat.hpp"
+
+namespace {
+
+const CameraMetadata kMetadata = {
+    .distance_from_center = 10,
+    .fov_h = Radians(90),
+    .fov_v = Radians(60),
+    .res_h = 100,
+    .res_v = 60,
+};
+
+TEST(SyntheticStreamReaderTest, Render) {
+  // Pixel 0 is at the center of the image, pixel 1 42 degrees left of center
+  // (column 3), and pixel 2 has no location.
+  SyntheticStreamReader reader(
+      {
+          .camera_number = 1,
+          .metadata = kMetadata,
+          .pixels = {XYZPos{0, 0, 0}, XYZPos{0, -9, 0}, std::nullopt},
+          .blob_radius = 2,
+          .background = cv::Scalar(10, 10, 10),
+      },
+      /*receiver=*/nullptr);
+
+  cv::Mat frame = reader.Render({});
+  ASSERT_EQ(frame.rows, 60);
+  ASSERT_EQ(frame.cols, 100);
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 50), cv::Vec3b(10, 10, 10));
+
+  // Channels are RGB; the image is BGR.
+  frame = reader.Render({1, 2, 3, 0, 0, 0, 4, 5, 6});
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 50), cv::Vec3b(3, 2, 1));
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 52), cv::Vec3b(3, 2, 1));
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 54), cv::Vec3b(10, 10, 10));
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 3), cv::Vec3b(10, 10, 10));
+
+  frame = reader.Render({0, 0, 0, 7, 8, 9});
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 50), cv::Vec3b(10, 10, 10));
+  EXPECT_EQ(frame.at<cv::Vec3b>(30, 3), cv::Vec3b(9, 8, 7));
+}
+
+}  // namespace
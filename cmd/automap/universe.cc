@@ -0,0 +1,71 @@
+#include "cmd/automap/universe.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "cmd/automap/net.h"
+
+absl::StatusOr<std::vector<UniverseEntry>> ParseUniverseMap(
+    const std::string& spec, int default_port) {
+  std::vector<UniverseEntry> universe;
+  int first_pixel = 0;
+
+  const std::vector<std::string> parts =
+      absl::StrSplit(spec, ',', absl::SkipEmpty());
+  for (const std::string& part : parts) {
+    auto invalid = [&](const std::string& why) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("bad universe entry '", part, "': ", why));
+    };
+
+    std::vector<std::string> host_count =
+        absl::StrSplit(part, absl::MaxSplits('=', 1));
+    if (host_count.size() != 2) {
+      return invalid("missing pixel count");
+    }
+
+    auto [host, port] = ParseHostPort(host_count[0], default_port);
+    if (host.empty()) {
+      return invalid("bad host:port");
+    }
+
+    std::vector<std::string> count_offset =
+        absl::StrSplit(host_count[1], absl::MaxSplits('@', 1));
+    int num_pixels, controller_offset = 0;
+    if (!absl::SimpleAtoi(count_offset[0], &num_pixels) || num_pixels <= 0) {
+      return invalid("bad pixel count");
+    }
+    if (count_offset.size() == 2 &&
+        (!absl::SimpleAtoi(count_offset[1], &controller_offset) ||
+         controller_offset < 0)) {
+      return invalid("bad offset");
+    }
+
+    universe.push_back({
+        .host = host,
+        .port = port,
+        .first_pixel = first_pixel,
+        .num_pixels = num_pixels,
+        .controller_offset = controller_offset,
+    });
+    first_pixel += num_pixels;
+  }
+
+  if (universe.empty()) {
+    return absl::InvalidArgumentError("empty universe map");
+  }
+  return universe;
+}
+
+int UniverseSize(const std::vector<UniverseEntry>& universe) {
+  int size = 0;
+  for (const UniverseEntry& entry : universe) {
+    size += entry.num_pixels;
+  }
+  return size;
+}
@@ -0,0 +1,35 @@
+#ifndef _CMD_AUTOMAP_UNIVERSE_H_
+#define _CMD_AUTOMAP_UNIVERSE_H_ 1
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+
+// One controller's share of the global pixel address space: global pixels
+// [first_pixel, first_pixel+num_pixels) are sent to host:port starting at
+// the controller's pixel controller_offset.
+struct UniverseEntry {
+  std::string host;
+  int port;
+  int first_pixel;
+  int num_pixels;
+  int controller_offset;
+
+  bool operator==(const UniverseEntry& other) const = default;
+};
+
+// Parses a universe map of the form
+//
+//   host[:port]=num_pixels[@controller_offset],...
+//
+// Global pixel ranges are assigned to the controllers in order, so the first
+// controller's pixels start at 0, the second's start where the first's end,
+// and so on.
+absl::StatusOr<std::vector<UniverseEntry>> ParseUniverseMap(
+    const std::string& spec, int default_port);
+
+// Returns the number of pixels in the universe.
+int UniverseSize(const std::vector<UniverseEntry>& universe);
+
+#endif  // _CMD_AUTOMAP_UNIVERSE_H_
@@ -0,0 +1,30 @@
+#include "cmd/automap/universe.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+
+constexpr int kDefaultPort = 9999;
+
+TEST(ParseUniverseMapTest, Valid) {
+  auto universe = ParseUniverseMap("a=100,b:1234=50@10,c=25", kDefaultPort);
+  ASSERT_TRUE(universe.ok()) << universe.status();
+
+  EXPECT_THAT(*universe,
+              ElementsAre(UniverseEntry{"a", kDefaultPort, 0, 100, 0},
+                          UniverseEntry{"b", 1234, 100, 50, 10},
+                          UniverseEntry{"c", kDefaultPort, 150, 25, 0}));
+  EXPECT_EQ(UniverseSize(*universe), 175);
+}
+
+TEST(ParseUniverseMapTest, Invalid) {
+  for (const char* spec :
+       {"", "a", "a=", "a=0", "a=-1", "a=x", "a=10@x", "a=10@-1", "a:x=10"}) {
+    EXPECT_FALSE(ParseUniverseMap(spec, kDefaultPort).ok()) << spec;
+  }
+}
+
+}  // namespace
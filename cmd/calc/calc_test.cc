@@ -5,6 +5,7 @@
 #include "gtest/gtest.h"
 #include "lib/geometry/points.h"
 #include "lib/geometry/points_testutil.h"
+#include "lib/geometry/projection.h"
 #include "lib/geometry/translation.h"
 
 namespace {
@@ -86,4 +87,31 @@ TEST_F(CalcTest, FindDetectionLocation) {
   EXPECT_THAT(result.pixel_y_error, DoubleEq(10));
 }
 
+// ProjectToCamera is the inverse of FindDetectionLocation, up to the latter
+// working with whole pixels.
+TEST_F(CalcTest, ProjectToCameraRoundTrip) {
+  const CameraMetadata metadata = {
+      .distance_from_center = 10,
+      .fov_h = Radians(90),
+      .fov_v = Radians(60),
+      .res_h = 720,
+      .res_v = 1080,
+  };
+
+  EXPECT_THAT(ProjectToCamera(1, {0.4808, 0.8328, 1.30517}, metadata),
+              XYPosNear(XYPos{.x = 400, .y = 400}, 0.05));
+  EXPECT_THAT(ProjectToCamera(2, {0.4808, 0.8328, 1.30517}, metadata),
+              XYPosNear(XYPos{.x = 320, .y = 400}, 0.05));
+
+  for (const XYZPos& want : {XYZPos{0, 0, 0}, XYZPos{1, -2, 0.5},
+                             XYZPos{-1.5, 1, -1}, XYZPos{2, 2, 2}}) {
+    const XYPos c1 = ProjectToCamera(1, want, metadata);
+    const XYPos c2 = ProjectToCamera(2, want, metadata);
+    const Result result = FindDetectionLocation(
+        {.x = std::round(c1.x), .y = std::round(c1.y)},
+        {.x = std::round(c2.x), .y = std::round(c2.y)}, metadata);
+    EXPECT_THAT(result.detection, XYZPosNear(want, 0.1));
+  }
+}
+
 }  // namespace
@@ -0,0 +1,175 @@
+#include "cmd/detect/batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "cmd/detect/detect.h"
+#include "cmd/detect/roi.h"
+#include "lib/cv/decoded_cache.h"
+#include "lib/file/path.h"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+absl::StatusOr<std::vector<NumberedImage>> FindNumberedImages(
+    const std::string& dir, const std::string& prefix) {
+  constexpr char kSuffix[] = ".jpg";
+
+  std::vector<NumberedImage> images;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (!absl::StartsWith(name, prefix) || !absl::EndsWith(name, kSuffix)) {
+      continue;
+    }
+
+    const std::string num_str = name.substr(
+        prefix.size(), name.size() - prefix.size() - strlen(kSuffix));
+    int number;
+    if (!absl::SimpleAtoi(num_str, &number)) {
+      continue;
+    }
+    images.push_back({.number = number, .path = JoinPath({dir, name})});
+  }
+  if (ec) {
+    return absl::UnknownError(
+        absl::StrCat("failed to read directory ", dir, ": ", ec.message()));
+  }
+
+  std::sort(images.begin(), images.end(),
+            [](const NumberedImage& a, const NumberedImage& b) {
+              return a.number < b.number;
+            });
+  return images;
+}
+
+bool DetectsGray(const BatchDetectOptions& options) {
+  return options.decoded_cache && !options.channel.has_value() &&
+         options.marked_dir.empty();
+}
+
+absl::StatusOr<std::vector<std::optional<cv::Point2i>>> DetectBatch(
+    cv::Mat off, cv::Mat mask, const std::vector<NumberedImage>& images,
+    const BatchDetectOptions& options) {
+  std::vector<std::optional<cv::Point2i>> results(images.size());
+
+  absl::Mutex mu;
+  absl::Status status;
+  const bool predict = options.roi.has_value() && !options.channel.has_value();
+
+  const bool gray = DetectsGray(options);
+  if (gray && off.type() != CV_8U) {
+    cv::Mat gray_off;
+    cv::cvtColor(off, gray_off, cv::COLOR_BGR2GRAY);
+    off = gray_off;
+  }
+
+  auto fail = [&](absl::Status error) {
+    absl::MutexLock lock(&mu);
+    if (status.ok()) {
+      status = std::move(error);
+    }
+  };
+  auto failed = [&]() {
+    absl::MutexLock lock(&mu);
+    return !status.ok();
+  };
+
+  // Workers claim images one at a time, so a slow image doesn't hold up a
+  // whole share of the batch. Once any image fails the batch is abandoned,
+  // so the others stop claiming.
+  std::atomic<int> next(0);
+  auto work = [&]() {
+    for (int i = next++; i < static_cast<int>(images.size()) && !failed();
+         i = next++) {
+      const NumberedImage& image = images[i];
+
+      // Keeps a cached image's mapping alive while `on` is in use.
+      std::optional<MappedImage> mapped;
+      cv::Mat on;
+      if (options.decoded_cache) {
+        absl::StatusOr<MappedImage> read =
+            ReadCachedImage(image.path, {.gray = gray});
+        if (!read.ok()) {
+          fail(read.status());
+          return;
+        }
+        mapped.emplace(std::move(*read));
+        on = mapped->image();
+      } else {
+        on = cv::imread(image.path);
+      }
+      if (on.empty()) {
+        fail(absl::UnknownError(absl::StrCat("failed to read ", image.path)));
+        return;
+      }
+      if (on.rows != off.rows || on.cols != off.cols) {
+        fail(absl::InvalidArgumentError(
+            absl::StrCat(image.path, " doesn't match the off image's size")));
+        return;
+      }
+
+      const bool keep_intermediates = !options.marked_dir.empty();
+      DetectOptions detect_options = {
+          .keep_intermediates = keep_intermediates,
+          .tile_size = options.tile_size,
+          .mask_bounds = options.mask_bounds,
+      };
+      if (predict) {
+        detect_options.region =
+            PredictRegion(options.known_locations, image.number, *options.roi);
+      }
+
+      std::unique_ptr<DetectResults> result =
+          options.channel.has_value()
+              ? DetectChannel(off, on, mask, *options.channel,
+                              keep_intermediates)
+              : Detect(off, on, mask, detect_options);
+      if (!result->found) {
+        continue;
+      }
+      results[i] = result->centroid;
+
+      if (!options.marked_dir.empty()) {
+        const std::string path = JoinPath(
+            {options.marked_dir,
+             std::filesystem::path(image.path).filename().string()});
+        if (!cv::imwrite(path, result->intermediates["marked"])) {
+          fail(absl::UnknownError(absl::StrCat("failed to write ", path)));
+          return;
+        }
+      }
+    }
+  };
+
+  int num_threads = options.num_threads > 0
+                        ? options.num_threads
+                        : std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min<int>(num_threads, images.size());
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(work);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  if (!status.ok()) {
+    return status;
+  }
+  return results;
+}
@@ -0,0 +1,65 @@
+#ifndef _CMD_DETECT_BATCH_H_
+#define _CMD_DETECT_BATCH_H_ 1
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "cmd/detect/detect.h"
+#include "cmd/detect/roi.h"
+#include "opencv2/core/mat.hpp"
+#include "opencv2/core/types.hpp"
+
+// An image in a capture directory, named <prefix><number>.jpg.
+struct NumberedImage {
+  int number;
+  std::string path;
+};
+
+// Returns the images named <prefix><number>.jpg in dir (e.g. automap's
+// pixel_NNN.jpg), sorted by number.
+absl::StatusOr<std::vector<NumberedImage>> FindNumberedImages(
+    const std::string& dir, const std::string& prefix);
+
+struct BatchDetectOptions {
+  // Number of images to work on at once; 0 means one per CPU.
+  int num_threads = 0;
+
+  // As for DetectChannel; nullopt to use Detect.
+  std::optional<ColorChannel> channel;
+
+  // If set, each image in which a pixel is found is written here with the
+  // detection marked, under its original name.
+  std::string marked_dir;
+
+  // If set, each pixel is searched for first in the region predicted from
+  // its neighbors' locations in known_locations. Locations found in the batch
+  // aren't used, since which of them a worker would see depends on timing.
+  // Ignored with channel, whose images each hold several pixels.
+  std::optional<RoiOptions> roi;
+  PixelLocations known_locations;
+
+  // As for DetectOptions.
+  std::optional<cv::Rect> mask_bounds;
+  int tile_size = 0;
+
+  // Read images through ReadCachedImage, so that later runs over the same
+  // images skip decoding. Unless channel or marked_dir is set, they're read
+  // gray, which is all Detect needs.
+  bool decoded_cache = false;
+};
+
+// Whether DetectBatch reads the images gray with these options.
+bool DetectsGray(const BatchDetectOptions& options);
+
+// Detects the lit pixel in each of `images` against the same off image and
+// mask, which are shared (read-only) by every worker. The off image may be
+// gray if DetectsGray(options). Returns the centroids
+// in the same order as images, nullopt where nothing was found. Fails if any
+// image can't be read or doesn't match the off image's size.
+absl::StatusOr<std::vector<std::optional<cv::Point2i>>> DetectBatch(
+    cv::Mat off, cv::Mat mask, const std::vector<NumberedImage>& images,
+    const BatchDetectOptions& options);
+
+#endif  // _CMD_DETECT_BATCH_H_
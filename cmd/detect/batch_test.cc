@@ -0,0 +1,142 @@
+#include "cmd/detect/batch.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/strings/str_format.h"
+#include "cmd/detect/test_images.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+#include "lib/file/writers.h"
+#include "lib/testing/file.h"
+#include "opencv2/opencv.hpp"
+
+namespace {
+
+using ::detect_testing::AllMask;
+using ::detect_testing::DrawPixel;
+using ::detect_testing::MakeImage;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::IsEmpty;
+
+TEST(FindNumberedImagesTest, Test) {
+  const std::string dir = MakeTestDir("find_numbered");
+  for (const std::string name :
+       {"pixel_010.jpg", "pixel_002.jpg", "pixel_x.jpg", "pixel_003.png",
+        "rgb_004.jpg", "off.jpg"}) {
+    QCHECK_OK(WriteFile(JoinPath({dir, name}), {""}));
+  }
+
+  auto images = FindNumberedImages(dir, "pixel_");
+  ASSERT_TRUE(images.ok()) << images.status();
+  EXPECT_THAT(*images,
+              ElementsAre(Field(&NumberedImage::number, 2),
+                          Field(&NumberedImage::number, 10)));
+  EXPECT_EQ((*images)[0].path, JoinPath({dir, "pixel_002.jpg"}));
+
+  images = FindNumberedImages(dir, "rgb_");
+  ASSERT_TRUE(images.ok()) << images.status();
+  EXPECT_THAT(*images, ElementsAre(Field(&NumberedImage::number, 4)));
+
+  EXPECT_FALSE(FindNumberedImages(JoinPath({dir, "nonexistent"}), "pixel_")
+                   .ok());
+}
+
+TEST(DetectBatchTest, Test) {
+  const std::string dir = MakeTestDir("detect_batch");
+  const std::string marked_dir = MakeTestDir("detect_batch_marked");
+
+  // Pixel n is lit at (10n+20, 50), except for pixel 3, which isn't found.
+  std::vector<NumberedImage> images;
+  for (int i = 0; i < 8; ++i) {
+    cv::Mat on = MakeImage();
+    if (i != 3) {
+      DrawPixel(on, {10 * i + 20, 50}, cv::Scalar::all(255));
+    }
+
+    const std::string name = absl::StrFormat("pixel_%03d.jpg", i);
+    images.push_back({.number = i, .path = JoinPath({dir, name})});
+    ASSERT_TRUE(cv::imwrite(images.back().path, on));
+  }
+
+  cv::Mat mask = AllMask();
+  auto results = DetectBatch(MakeImage(), mask, images,
+                             {.num_threads = 3, .marked_dir = marked_dir});
+  ASSERT_TRUE(results.ok()) << results.status();
+  ASSERT_EQ(results->size(), images.size());
+
+  for (int i = 0; i < 8; ++i) {
+    SCOPED_TRACE(i);
+    if (i == 3) {
+      EXPECT_FALSE((*results)[i].has_value());
+      EXPECT_TRUE(
+          cv::imread(JoinPath({marked_dir, "pixel_003.jpg"})).empty());
+      continue;
+    }
+
+    ASSERT_TRUE((*results)[i].has_value());
+    EXPECT_NEAR((*results)[i]->x, 10 * i + 20, 1);
+    EXPECT_NEAR((*results)[i]->y, 50, 1);
+    const std::string marked =
+        JoinPath({marked_dir, absl::StrFormat("pixel_%03d.jpg", i)});
+    EXPECT_FALSE(cv::imread(marked).empty()) << marked;
+  }
+
+  // The same results from gray images read through the decoded image cache,
+  // both when it's filled and when it's read.
+  for (int run = 0; run < 2; ++run) {
+    SCOPED_TRACE(run);
+    auto cached = DetectBatch(MakeImage(), mask, images,
+                              {.num_threads = 3, .decoded_cache = true});
+    ASSERT_TRUE(cached.ok()) << cached.status();
+    EXPECT_EQ(*cached, *results);
+  }
+
+  // The off image may be gray too when the others are read gray.
+  ASSERT_TRUE(DetectsGray({.decoded_cache = true}));
+  cv::Mat gray_off;
+  cv::cvtColor(MakeImage(), gray_off, cv::COLOR_BGR2GRAY);
+  auto gray = DetectBatch(gray_off, mask, images,
+                          {.num_threads = 3, .decoded_cache = true});
+  ASSERT_TRUE(gray.ok()) << gray.status();
+  EXPECT_EQ(*gray, *results);
+
+  // Tiled detection finds the same pixels, to within a pixel.
+  auto tiled = DetectBatch(MakeImage(), mask, images,
+                           {.num_threads = 3, .tile_size = 16});
+  ASSERT_TRUE(tiled.ok()) << tiled.status();
+  ASSERT_EQ(tiled->size(), images.size());
+  for (int i = 0; i < 8; ++i) {
+    SCOPED_TRACE(i);
+    ASSERT_EQ((*tiled)[i].has_value(), (*results)[i].has_value());
+    if ((*tiled)[i].has_value()) {
+      EXPECT_NEAR((*tiled)[i]->x, (*results)[i]->x, 1);
+      EXPECT_NEAR((*tiled)[i]->y, (*results)[i]->y, 1);
+    }
+  }
+}
+
+TEST(DetectBatchTest, Errors) {
+  cv::Mat mask = AllMask();
+
+  EXPECT_FALSE(
+      DetectBatch(MakeImage(), mask,
+                  {{.number = 1, .path = JoinPath({::testing::TempDir(),
+                                                   "nonexistent.jpg"})}},
+                  {})
+          .ok());
+
+  const std::string small = JoinPath({::testing::TempDir(), "small.jpg"});
+  ASSERT_TRUE(cv::imwrite(small, cv::Mat(10, 10, CV_8UC3)));
+  EXPECT_FALSE(
+      DetectBatch(MakeImage(), mask, {{.number = 1, .path = small}}, {}).ok());
+
+  auto results = DetectBatch(MakeImage(), mask, {}, {});
+  ASSERT_TRUE(results.ok());
+  EXPECT_THAT(*results, IsEmpty());
+}
+
+}  // namespace
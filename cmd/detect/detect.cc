@@ -1,6 +1,14 @@
 #include "cmd/detect/detect.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "opencv2/core/hal/intrin.hpp"
 #include "opencv2/opencv.hpp"
 #include "opencv2/viz/types.hpp"
 
@@ -8,7 +16,140 @@
 // get. But it works with images gathered in pitch darkness, which is
 // easy enough to do.
 
-std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask) {
+namespace {
+
+// Gray level at which a difference counts as a change.
+constexpr int kDiffThreshold = 80;
+
+// The threshold in coarse images, where averaging has dimmed the edges of
+// lit regions.
+constexpr int kCoarseDiffThreshold = kDiffThreshold / 2;
+
+// Padding around coarse candidates, in coarse pixels.
+constexpr int kCoarseMargin = 4;
+
+// The BGR to gray weights cv::cvtColor uses for 8-bit images: 0.114, 0.587
+// and 0.299 in 14-bit fixed point.
+constexpr int kGrayShift = 14;
+constexpr int kBlueWeight = 1868;
+constexpr int kGreenWeight = 9617;
+constexpr int kRedWeight = 4899;
+
+inline int GrayLevel(const uchar* bgr) {
+  return (bgr[0] * kBlueWeight + bgr[1] * kGreenWeight + bgr[2] * kRedWeight +
+          (1 << (kGrayShift - 1))) >>
+         kGrayShift;
+}
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+
+// GrayLevel for vectors of 16-bit blue, green and red levels. Each pair of
+// adjacent lanes is multiplied and summed by v_dotprod, so blue and green
+// are paired with their weights, and red with the rounding term.
+cv::v_int16 GrayLevels(const cv::v_int16& b, const cv::v_int16& g,
+                       const cv::v_int16& r) {
+  const cv::v_int16 bg_weights = cv::v_reinterpret_as_s16(
+      cv::vx_setall_s32((kGreenWeight << 16) | kBlueWeight));
+  const cv::v_int16 r_weights = cv::v_reinterpret_as_s16(
+      cv::vx_setall_s32(((1 << (kGrayShift - 1)) << 16) | kRedWeight));
+  const cv::v_int16 one = cv::vx_setall_s16(1);
+
+  cv::v_int16 bg0, bg1, r0, r1;
+  cv::v_zip(b, g, bg0, bg1);
+  cv::v_zip(r, one, r0, r1);
+  const cv::v_int32 sum0 = cv::v_add(cv::v_dotprod(bg0, bg_weights),
+                                     cv::v_dotprod(r0, r_weights));
+  const cv::v_int32 sum1 = cv::v_add(cv::v_dotprod(bg1, bg_weights),
+                                     cv::v_dotprod(r1, r_weights));
+  return cv::v_pack(cv::v_shr<kGrayShift>(sum0),
+                    cv::v_shr<kGrayShift>(sum1));
+}
+
+// GrayLevel for a vector's worth of BGR pixels.
+cv::v_uint8 GrayLevels(const uchar* bgr) {
+  cv::v_uint8 b, g, r;
+  cv::v_load_deinterleave(bgr, b, g, r);
+
+  cv::v_uint16 b0, b1, g0, g1, r0, r1;
+  cv::v_expand(b, b0, b1);
+  cv::v_expand(g, g0, g1);
+  cv::v_expand(r, r0, r1);
+  return cv::v_pack_u(
+      GrayLevels(cv::v_reinterpret_as_s16(b0), cv::v_reinterpret_as_s16(g0),
+                 cv::v_reinterpret_as_s16(r0)),
+      GrayLevels(cv::v_reinterpret_as_s16(b1), cv::v_reinterpret_as_s16(g1),
+                 cv::v_reinterpret_as_s16(r1)));
+}
+
+#endif  // CV_SIMD || CV_SIMD_SCALABLE
+
+// Computes one row of ThresholdGrayDiff. Whole vectors are handled with
+// OpenCV's universal intrinsics, and the remainder one pixel at a time.
+void ThresholdGrayDiffRow(const uchar* off, const uchar* on,
+                          const uchar* mask, int cols, bool gray,
+                          int threshold, uchar* out) {
+  int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+  const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+  const cv::v_uint8 vthreshold = cv::vx_setall_u8(threshold);
+  const cv::v_uint8 zero = cv::vx_setzero_u8();
+  if (gray) {
+    for (; x <= cols - lanes; x += lanes) {
+      const cv::v_uint8 diff =
+          cv::v_absdiff(cv::vx_load(on + x), cv::vx_load(off + x));
+      cv::v_store(out + x, cv::v_and(cv::v_gt(diff, vthreshold),
+                                     cv::v_ne(cv::vx_load(mask + x), zero)));
+    }
+  } else {
+    for (; x <= cols - lanes; x += lanes) {
+      const cv::v_uint8 diff =
+          cv::v_absdiff(GrayLevels(on + 3 * x), GrayLevels(off + 3 * x));
+      cv::v_store(out + x, cv::v_and(cv::v_gt(diff, vthreshold),
+                                     cv::v_ne(cv::vx_load(mask + x), zero)));
+    }
+  }
+  cv::vx_cleanup();
+#endif  // CV_SIMD || CV_SIMD_SCALABLE
+
+  if (gray) {
+    for (; x < cols; ++x) {
+      const int diff = std::abs(on[x] - off[x]);
+      out[x] = ((diff > threshold) & (mask[x] != 0)) * 255;
+    }
+  } else {
+    for (; x < cols; ++x) {
+      const int diff = std::abs(GrayLevel(on + 3 * x) - GrayLevel(off + 3 * x));
+      out[x] = ((diff > threshold) & (mask[x] != 0)) * 255;
+    }
+  }
+}
+
+cv::Mat Erode(cv::Mat thresholded) {
+  cv::Mat eroded;
+  cv::erode(thresholded, eroded,
+            cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2)));
+  return eroded;
+}
+
+// Thresholds and erodes a difference image.
+cv::Mat ThresholdDiff(cv::Mat diff,
+                      std::unordered_map<std::string, cv::Mat>* intermediates) {
+  cv::Mat threshold;
+  cv::threshold(diff, threshold, kDiffThreshold, 255, cv::THRESH_BINARY);
+  cv::Mat eroded = Erode(threshold);
+
+  if (intermediates != nullptr) {
+    (*intermediates)["threshold"] = threshold;
+    (*intermediates)["eroded"] = eroded;
+  }
+
+  return eroded;
+}
+
+// Returns the thresholded, eroded difference between the on and off images.
+// Saves intermediate images in `intermediates` if it's non-null.
+cv::Mat DiffImages(cv::Mat off, cv::Mat on, cv::Mat mask,
+                   std::unordered_map<std::string, cv::Mat>* intermediates) {
   cv::Mat masked_off, masked_on;
   cv::bitwise_and(off, off, masked_off, mask);
   cv::bitwise_and(on, on, masked_on, mask);
@@ -17,21 +158,81 @@ std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask) {
   cv::cvtColor(masked_off, gray_off, cv::COLOR_BGR2GRAY);
   cv::cvtColor(masked_on, gray_on, cv::COLOR_BGR2GRAY);
 
-  cv::Mat absdiff, threshold, eroded;
+  cv::Mat absdiff;
   cv::absdiff(gray_off, gray_on, absdiff);
-  cv::threshold(absdiff, threshold, 80, 255, cv::THRESH_BINARY);
-  cv::erode(threshold, eroded,
-            cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2)));
 
-  auto results = std::make_unique<DetectResults>();
-  results->intermediates["gray_off"] = gray_off;
-  results->intermediates["gray_on"] = gray_on;
-  results->intermediates["absdiff"] = absdiff;
-  results->intermediates["threshold"] = threshold;
-  results->intermediates["eroded"] = eroded;
+  if (intermediates != nullptr) {
+    (*intermediates)["gray_off"] = gray_off;
+    (*intermediates)["gray_on"] = gray_on;
+    (*intermediates)["absdiff"] = absdiff;
+  }
+
+  return ThresholdDiff(absdiff, intermediates);
+}
+
+// Like DiffImages, but using ThresholdGrayDiff. Only the threshold and eroded
+// images are saved in `intermediates`.
+cv::Mat FusedDiffImages(
+    cv::Mat off, cv::Mat on, cv::Mat mask,
+    std::unordered_map<std::string, cv::Mat>* intermediates) {
+  cv::Mat threshold = ThresholdGrayDiff(off, on, mask, kDiffThreshold);
+  cv::Mat eroded = Erode(threshold);
+
+  if (intermediates != nullptr) {
+    (*intermediates)["threshold"] = threshold;
+    (*intermediates)["eroded"] = eroded;
+  }
 
+  return eroded;
+}
+
+// Like DiffImages, but for one color channel. The difference is how much the
+// channel brightened beyond the larger of the other two channels' increases.
+cv::Mat DiffChannel(cv::Mat off, cv::Mat on, cv::Mat mask,
+                    ColorChannel channel,
+                    std::unordered_map<std::string, cv::Mat>* intermediates) {
+  cv::Mat masked_off, masked_on;
+  cv::bitwise_and(off, off, masked_off, mask);
+  cv::bitwise_and(on, on, masked_on, mask);
+
+  // Saturating subtraction, so only increases count.
+  cv::Mat increase;
+  cv::subtract(masked_on, masked_off, increase);
+
+  std::vector<cv::Mat> increases;
+  cv::split(increase, increases);
+
+  const int target = static_cast<int>(channel);
+  cv::Mat others;
+  cv::max(increases[(target + 1) % 3], increases[(target + 2) % 3], others);
+
+  cv::Mat dominance;
+  cv::subtract(increases[target], others, dominance);
+
+  if (intermediates != nullptr) {
+    (*intermediates)["channel_increase"] = increases[target];
+    (*intermediates)["other_increase"] = others;
+    (*intermediates)["dominance"] = dominance;
+  }
+
+  return ThresholdDiff(dominance, intermediates);
+}
+
+// Returns a copy of `on` with the centroid marked.
+cv::Mat MarkCentroid(cv::Mat on, cv::Point centroid) {
+  cv::Mat marked = on.clone();
+  cv::drawMarker(marked, centroid, cv::viz::Color::red(), cv::MARKER_CROSS,
+                 50, 2);
+  return marked;
+}
+
+// Finds the biggest contour in a thresholded image, marking it on `on` if
+// `mark` is set.
+std::unique_ptr<DetectResults> FindBiggest(
+    cv::Mat thresholded, cv::Mat on, bool mark,
+    std::unique_ptr<DetectResults> results) {
   std::vector<std::vector<cv::Point>> found_contours;
-  cv::findContours(eroded, found_contours, cv::RETR_TREE,
+  cv::findContours(thresholded, found_contours, cv::RETR_TREE,
                    cv::CHAIN_APPROX_SIMPLE);
 
   if (found_contours.empty()) {
@@ -70,11 +271,421 @@ std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask) {
   results->centroid.y = int(moments.m01 / moments.m00);
 
   results->found = true;
+  if (mark) {
+    results->intermediates["marked"] = MarkCentroid(on, results->centroid);
+  }
 
-  cv::Mat marked = on.clone();
-  cv::drawMarker(marked, results->centroid, cv::viz::Color::red(),
-                 cv::MARKER_CROSS, 50, 2);
-  results->intermediates["marked"] = marked;
+  return results;
+}
+
+// Detects in the whole of the given images.
+std::unique_ptr<DetectResults> DetectFrame(cv::Mat off, cv::Mat on,
+                                           cv::Mat mask,
+                                           const DetectOptions& options) {
+  auto results = std::make_unique<DetectResults>();
+  results->searched = cv::Rect(0, 0, on.cols, on.rows);
+  std::unordered_map<std::string, cv::Mat>* intermediates =
+      options.keep_intermediates ? &results->intermediates : nullptr;
+  cv::Mat eroded = options.fused
+                       ? FusedDiffImages(off, on, mask, intermediates)
+                       : DiffImages(off, on, mask, intermediates);
+  return FindBiggest(eroded, on, options.keep_intermediates,
+                     std::move(results));
+}
+
+// Lit regions found in separate tiles, merged with a union-find as they're
+// found to touch across tile edges. Regions that nothing further can touch
+// are retired after each row of tiles, so only those along the current row
+// are held, along with the biggest so far.
+class TiledComponents {
+ public:
+  // Adds a region with the given pixel count and centroid, returning its id.
+  int Add(int area, cv::Point2d centroid) {
+    ++num_added_;
+    components_.push_back({
+        .parent = static_cast<int>(components_.size()),
+        .area = area,
+        .sum_x = centroid.x * area,
+        .sum_y = centroid.y * area,
+    });
+    return components_.size() - 1;
+  }
+
+  void Merge(int a, int b) {
+    a = Find(a);
+    b = Find(b);
+    if (a == b) {
+      return;
+    }
+    if (components_[a].area < components_[b].area) {
+      std::swap(a, b);
+    }
+    Component& to = components_[a];
+    const Component& from = components_[b];
+    to.area += from.area;
+    to.sum_x += from.sum_x;
+    to.sum_y += from.sum_y;
+    components_[b].parent = a;
+  }
+
+  // Retires every region that none of the ids in `edge` (-1 for none)
+  // belongs to, keeping it only if it's the biggest so far. The rest are
+  // renumbered, and `edge` is updated to match, so ids from before the call
+  // are otherwise invalid.
+  void Retire(std::vector<int>* edge) {
+    std::vector<int> renumbered(components_.size(), -1);
+    std::vector<Component> live;
+    for (int& id : *edge) {
+      if (id < 0) {
+        continue;
+      }
+      const int root = Find(id);
+      if (renumbered[root] < 0) {
+        renumbered[root] = live.size();
+        live.push_back(components_[root]);
+        live.back().parent = renumbered[root];
+      }
+      id = renumbered[root];
+    }
+
+    for (int i = 0; i < static_cast<int>(components_.size()); ++i) {
+      if (components_[i].parent == i && renumbered[i] < 0) {
+        KeepBigger(components_[i], &biggest_);
+      }
+    }
+    components_ = std::move(live);
+  }
+
+  // Finds the merged region with the most pixels, returning false if there
+  // are none. Single pixels are ignored, as FindBiggest ignores contours
+  // without area.
+  bool Biggest(int* area, cv::Point* centroid) {
+    std::optional<Component> biggest = biggest_;
+    for (int i = 0; i < static_cast<int>(components_.size()); ++i) {
+      if (Find(i) == i) {
+        KeepBigger(components_[i], &biggest);
+      }
+    }
+    if (!biggest.has_value()) {
+      return false;
+    }
+
+    *area = biggest->area;
+    centroid->x = int(biggest->sum_x / biggest->area);
+    centroid->y = int(biggest->sum_y / biggest->area);
+    return true;
+  }
+
+  // The number of regions added, before merging.
+  int num_added() const { return num_added_; }
 
+ private:
+  struct Component {
+    int parent;
+    int area;
+    double sum_x, sum_y;
+  };
+
+  static void KeepBigger(const Component& component,
+                         std::optional<Component>* biggest) {
+    if (component.area > 1 &&
+        (!biggest->has_value() || component.area > (*biggest)->area)) {
+      *biggest = component;
+    }
+  }
+
+  int Find(int id) {
+    while (components_[id].parent != id) {
+      components_[id].parent = components_[components_[id].parent].parent;
+      id = components_[id].parent;
+    }
+    return id;
+  }
+
+  std::vector<Component> components_;
+  std::optional<Component> biggest_;
+  int num_added_ = 0;
+};
+
+// Like DetectFrame with a fused diff, but working on tiles of
+// options.tile_size at a time. Only the component ids along the tile edges
+// are carried from one tile to the next.
+std::unique_ptr<DetectResults> DetectTiled(cv::Mat off, cv::Mat on,
+                                           cv::Mat mask,
+                                           const DetectOptions& options) {
+  const int tile_size = options.tile_size;
+  TiledComponents components;
+
+  // Component ids (or -1) of the bottom row of the previous row of tiles,
+  // the bottom row of this one, and the right column of the previous tile.
+  std::vector<int> above(on.cols, -1), below(on.cols, -1);
+  std::vector<int> left(tile_size, -1);
+
+  for (int ty = 0; ty < on.rows; ty += tile_size) {
+    const int th = std::min(tile_size, on.rows - ty);
+    for (int tx = 0; tx < on.cols; tx += tile_size) {
+      const int tw = std::min(tile_size, on.cols - tx);
+
+      // Erosion looks one pixel up and to the left, so each tile is diffed
+      // with the row and column before it, as it would be in the whole
+      // image, and they're dropped afterwards.
+      const int ox = tx > 0 ? 1 : 0, oy = ty > 0 ? 1 : 0;
+      const cv::Rect window(tx - ox, ty - oy, tw + ox, th + oy);
+      cv::Mat eroded = Erode(ThresholdGrayDiff(off(window), on(window),
+                                               mask(window), kDiffThreshold))(
+          cv::Rect(ox, oy, tw, th));
+
+      cv::Mat labels, stats, centroids;
+      const int num_labels = cv::connectedComponentsWithStats(
+          eroded, labels, stats, centroids, 8, CV_32S);
+
+      // Label 0 is the background.
+      std::vector<int> ids(num_labels, -1);
+      for (int i = 1; i < num_labels; ++i) {
+        ids[i] = components.Add(stats.at<int>(i, cv::CC_STAT_AREA),
+                                {centroids.at<double>(i, 0) + tx,
+                                 centroids.at<double>(i, 1) + ty});
+      }
+
+      // Merge with the regions that touch this tile from above (including
+      // diagonally) and from the left.
+      if (ty > 0) {
+        for (int x = 0; x < tw; ++x) {
+          const int id = ids[labels.at<int>(0, x)];
+          if (id < 0) {
+            continue;
+          }
+          for (int ax = std::max(0, tx + x - 1);
+               ax <= std::min(on.cols - 1, tx + x + 1); ++ax) {
+            if (above[ax] >= 0) {
+              components.Merge(id, above[ax]);
+            }
+          }
+        }
+      }
+      if (tx > 0) {
+        for (int y = 0; y < th; ++y) {
+          const int id = ids[labels.at<int>(y, 0)];
+          if (id < 0) {
+            continue;
+          }
+          for (int ly = std::max(0, y - 1); ly <= std::min(th - 1, y + 1);
+               ++ly) {
+            if (left[ly] >= 0) {
+              components.Merge(id, left[ly]);
+            }
+          }
+        }
+      }
+
+      for (int x = 0; x < tw; ++x) {
+        below[tx + x] = ids[labels.at<int>(th - 1, x)];
+      }
+      for (int y = 0; y < th; ++y) {
+        left[y] = ids[labels.at<int>(y, tw - 1)];
+      }
+    }
+
+    // Only regions along the bottom of this row can touch the next.
+    components.Retire(&below);
+    std::swap(above, below);
+  }
+
+  auto results = std::make_unique<DetectResults>();
+  results->searched = cv::Rect(0, 0, on.cols, on.rows);
+
+  LOG(INFO) << "#components: " << components.num_added();
+  int area;
+  if (!components.Biggest(&area, &results->centroid)) {
+    LOG(INFO) << "no components large enough";
+    return results;
+  }
+  LOG(INFO) << "biggest component area " << area;
+
+  results->found = true;
+  if (options.keep_intermediates) {
+    results->intermediates["marked"] = MarkCentroid(on, results->centroid);
+  }
   return results;
 }
+
+// Detects in the `area` part of the given images, returning the centroid in
+// image coordinates.
+std::unique_ptr<DetectResults> DetectWithin(cv::Mat off, cv::Mat on,
+                                            cv::Mat mask, cv::Rect area,
+                                            const DetectOptions& options) {
+  auto detect = options.tile_size > 0 ? DetectTiled : DetectFrame;
+  if (area == cv::Rect(0, 0, on.cols, on.rows)) {
+    return detect(off, on, mask, options);
+  }
+
+  // Submatrices share the images' data, so nothing outside the area is read.
+  std::unique_ptr<DetectResults> results =
+      detect(off(area), on(area), mask(area), options);
+  results->searched = area;
+  if (results->found) {
+    results->centroid.x += area.x;
+    results->centroid.y += area.y;
+    if (options.keep_intermediates) {
+      results->intermediates["marked"] = MarkCentroid(on, results->centroid);
+    }
+  }
+  return results;
+}
+
+}  // namespace
+
+cv::Mat ThresholdGrayDiff(cv::Mat off, cv::Mat on, cv::Mat mask,
+                          int threshold) {
+  QCHECK(on.type() == CV_8UC3 || on.type() == CV_8U);
+  QCHECK_EQ(off.type(), on.type());
+  QCHECK_EQ(mask.type(), CV_8U);
+  QCHECK(off.size() == on.size() && mask.size() == on.size());
+
+  QCHECK(threshold >= 0 && threshold <= 255) << threshold;
+
+  const bool gray = on.type() == CV_8U;
+  const int cols = on.cols;
+  cv::Mat out(on.rows, cols, CV_8U);
+  cv::parallel_for_(cv::Range(0, on.rows), [&](const cv::Range& rows) {
+    for (int y = rows.start; y < rows.end; ++y) {
+      ThresholdGrayDiffRow(off.ptr<uchar>(y), on.ptr<uchar>(y),
+                           mask.ptr<uchar>(y), cols, gray, threshold,
+                           out.ptr<uchar>(y));
+    }
+  });
+
+  return out;
+}
+
+CoarseImages MakeCoarseImages(cv::Mat off, cv::Mat on, int scale) {
+  // The same size as cv::imread's reduced modes produce.
+  const cv::Size size((on.cols + scale - 1) / scale,
+                      (on.rows + scale - 1) / scale);
+  CoarseImages coarse = {.scale = scale};
+  cv::resize(off, coarse.off, size, 0, 0, cv::INTER_AREA);
+  cv::resize(on, coarse.on, size, 0, 0, cv::INTER_AREA);
+  return coarse;
+}
+
+std::optional<int> ReducedReadMode(int scale) {
+  switch (scale) {
+    case 2:
+      return cv::IMREAD_REDUCED_COLOR_2;
+    case 4:
+      return cv::IMREAD_REDUCED_COLOR_4;
+    case 8:
+      return cv::IMREAD_REDUCED_COLOR_8;
+    default:
+      return std::nullopt;
+  }
+}
+
+std::vector<cv::Rect> FindCoarseCandidates(const CoarseImages& coarse,
+                                           cv::Mat mask) {
+  cv::Mat coarse_mask;
+  cv::resize(mask, coarse_mask, coarse.on.size(), 0, 0, cv::INTER_NEAREST);
+
+  // Not eroded, as a lit pixel may be only a coarse pixel or two across.
+  cv::Mat threshold = ThresholdGrayDiff(coarse.off, coarse.on, coarse_mask,
+                                        kCoarseDiffThreshold);
+
+  std::vector<std::vector<cv::Point>> found_contours;
+  cv::findContours(threshold, found_contours, cv::RETR_EXTERNAL,
+                   cv::CHAIN_APPROX_SIMPLE);
+
+  std::vector<cv::Rect> candidates;
+  for (const std::vector<cv::Point>& contour : found_contours) {
+    const cv::Rect bounds = cv::boundingRect(contour);
+    candidates.push_back(
+        cv::Rect((bounds.x - kCoarseMargin) * coarse.scale,
+                 (bounds.y - kCoarseMargin) * coarse.scale,
+                 (bounds.width + 2 * kCoarseMargin) * coarse.scale,
+                 (bounds.height + 2 * kCoarseMargin) * coarse.scale));
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const cv::Rect& a, const cv::Rect& b) {
+              return a.area() > b.area();
+            });
+  return candidates;
+}
+
+std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask) {
+  return Detect(off, on, mask, DetectOptions());
+}
+
+std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask,
+                                      const DetectOptions& options) {
+  std::optional<cv::Rect> predicted = options.region;
+  if (!predicted.has_value() && options.coarse.has_value()) {
+    std::vector<cv::Rect> candidates =
+        FindCoarseCandidates(*options.coarse, mask);
+    LOG(INFO) << "#coarse candidates: " << candidates.size();
+    if (!candidates.empty()) {
+      predicted = candidates.front();
+    }
+  }
+
+  const cv::Rect frame = options.mask_bounds.value_or(
+                            cv::Rect(0, 0, on.cols, on.rows)) &
+                        cv::Rect(0, 0, on.cols, on.rows);
+  if (predicted.has_value()) {
+    const cv::Rect region = *predicted & frame;
+    if (!region.empty()) {
+      std::unique_ptr<DetectResults> results =
+          DetectWithin(off, on, mask, region, options);
+      if (results->found) {
+        return results;
+      }
+    }
+
+    LOG(INFO) << "nothing found in region, widening search";
+  }
+
+  return DetectWithin(off, on, mask, frame, options);
+}
+
+std::unique_ptr<DetectResults> DetectChannel(cv::Mat off, cv::Mat on,
+                                             cv::Mat mask,
+                                             ColorChannel channel,
+                                             bool keep_intermediates) {
+  auto results = std::make_unique<DetectResults>();
+  results->searched = cv::Rect(0, 0, on.cols, on.rows);
+  cv::Mat eroded = DiffChannel(
+      off, on, mask, channel,
+      keep_intermediates ? &results->intermediates : nullptr);
+
+  // The saturated center of a bright pixel is white rather than colored, so
+  // the colored region may be a ring. The centroid of its outer contour is
+  // still the center of the pixel.
+  return FindBiggest(eroded, on, keep_intermediates, std::move(results));
+}
+
+std::vector<DetectedBlob> DetectBlobs(cv::Mat off, cv::Mat on, cv::Mat mask) {
+  cv::Mat eroded = FusedDiffImages(off, on, mask, nullptr);
+
+  std::vector<std::vector<cv::Point>> found_contours;
+  cv::findContours(eroded, found_contours, cv::RETR_EXTERNAL,
+                   cv::CHAIN_APPROX_SIMPLE);
+
+  std::vector<DetectedBlob> blobs;
+  for (const std::vector<cv::Point>& contour : found_contours) {
+    double area = cv::contourArea(contour);
+    if (area < 1) {
+      continue;
+    }
+
+    cv::Moments moments = cv::moments(contour);
+    blobs.push_back({
+        .centroid = cv::Point(int(moments.m10 / moments.m00),
+                              int(moments.m01 / moments.m00)),
+        .bounds = cv::boundingRect(contour),
+        .area = area,
+        .contour = contour,
+    });
+  }
+
+  LOG(INFO) << "#blobs: " << blobs.size();
+  return blobs;
+}
@@ -1,17 +1,133 @@
 #ifndef _CMD_DETECT_DETECT_H_
 #define _CMD_DETECT_DETECT_H_ 1
 
+#include <optional>
 #include <vector>
 
 #include "opencv2/opencv.hpp"
 
 struct DetectResults {
+  // Images from the steps of detection, by name, if
+  // DetectOptions::keep_intermediates was set. "marked" is a copy of the on
+  // image with the centroid marked, if one was found.
   std::unordered_map<std::string, cv::Mat> intermediates;
 
   bool found;
   cv::Point centroid;
+
+  // The part of the image that was searched to produce this result.
+  cv::Rect searched;
+};
+
+// Copies of the off and on images downscaled by an integer factor, for
+// coarse-to-fine detection.
+struct CoarseImages {
+  int scale;
+  cv::Mat off;
+  cv::Mat on;
+};
+
+// Downscales off and on by `scale` by averaging, for when they weren't read
+// reduced.
+CoarseImages MakeCoarseImages(cv::Mat off, cv::Mat on, int scale);
+
+// Returns the cv::imread mode that decodes color JPEGs downscaled by `scale`
+// (2, 4 or 8), which is several times faster than decoding them at full
+// resolution. Returns nullopt for other scales.
+std::optional<int> ReducedReadMode(int scale);
+
+struct DetectOptions {
+  // Compute the thresholded grayscale difference with ThresholdGrayDiff. If
+  // false, each step is a separate OpenCV operation whose output is kept in
+  // the intermediates, which is slower but useful for debugging. Only the
+  // fused version accepts gray images.
+  bool fused = true;
+
+  // Keep each step's image in DetectResults::intermediates. Each is as big
+  // as the area searched, and "marked" as big as the frame, so this is off
+  // unless they're wanted for debugging or display.
+  bool keep_intermediates = false;
+
+  // If nonzero, search in square tiles of this size, one at a time. Instead
+  // of several frame-sized images, the working memory is a few tile-sized
+  // images, two ids per column, and a record for each region touching the
+  // current row of tiles. Lit regions that cross tile edges are merged as
+  // though the whole area had been searched at once. The diff is always
+  // fused, and the biggest region is the one with the most pixels rather
+  // than the biggest contour, which can move the centroid by a pixel.
+  // Intermediates other than "marked" aren't kept.
+  int tile_size = 0;
+
+  // If set, only this part of the image (see PredictRegion) is searched at
+  // first, which is much faster when it's a small part of the frame. The
+  // whole frame is searched if nothing is found there. The intermediates
+  // other than "marked" cover only the part that was searched last.
+  std::optional<cv::Rect> region;
+
+  // If set (and region isn't), the lit regions are first found in these
+  // downscaled images, and the biggest is used as the region. This skips
+  // most of the full-resolution work, but a pixel that's too small or dim
+  // to survive the downscaling is only found by the full-frame fallback.
+  std::optional<CoarseImages> coarse;
+
+  // The bounds of the mask's nonzero area (see MakeSearchMask), if known.
+  // Nothing outside them is searched.
+  std::optional<cv::Rect> mask_bounds;
 };
 
 std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask);
+std::unique_ptr<DetectResults> Detect(cv::Mat off, cv::Mat on, cv::Mat mask,
+                                      const DetectOptions& options);
+
+// Returns a CV_8U map that is 255 where `mask` is set and the gray level of
+// `on` differs from that of `off` by more than `threshold`, and 0 elsewhere.
+// Gray levels are computed exactly as cv::cvtColor does for COLOR_BGR2GRAY,
+// so the result matches masking, converting, diffing and thresholding with
+// OpenCV. Unlike that sequence, it reads each input once and allocates only
+// the output, and works on whole SIMD vectors of pixels at a time. off and
+// on may instead both be gray already, such as images from ReadCachedImage
+// with DecodeOptions::gray. threshold must be between 0 and 255.
+cv::Mat ThresholdGrayDiff(cv::Mat off, cv::Mat on, cv::Mat mask,
+                          int threshold);
+
+// Returns the bounds of the regions in which the coarse on image differs
+// from the coarse off image, biggest first. The bounds are in
+// full-resolution coordinates, and are padded to cover what the downscaling
+// blurred away. mask is at full resolution.
+std::vector<cv::Rect> FindCoarseCandidates(const CoarseImages& coarse,
+                                           cv::Mat mask);
+
+// Channels of a BGR image.
+enum class ColorChannel {
+  kBlue = 0,
+  kGreen = 1,
+  kRed = 2,
+};
+
+// Like Detect, but looks for a pixel lit in pure red, green or blue, for
+// frames in which pixels are lit in different colors at once. Rather than
+// comparing gray levels, it compares how much brighter the channel got than
+// the other two did, so that other colors (and white, such as the saturated
+// centers of bright pixels) are ignored. The intermediates, including
+// "marked", are kept only if `keep_intermediates` is set, as for
+// DetectOptions::keep_intermediates.
+std::unique_ptr<DetectResults> DetectChannel(cv::Mat off, cv::Mat on,
+                                             cv::Mat mask,
+                                             ColorChannel channel,
+                                             bool keep_intermediates);
+
+struct DetectedBlob {
+  cv::Point centroid;
+  cv::Rect bounds;
+  double area;
+
+  // The blob's outline, in image coordinates. Unlike bounds, it excludes
+  // nearby blobs.
+  std::vector<cv::Point> contour;
+};
+
+// Finds every lit region in `on` rather than just the biggest one. Used when
+// more than one pixel is lit in a single frame.
+std::vector<DetectedBlob> DetectBlobs(cv::Mat off, cv::Mat on, cv::Mat mask);
 
 #endif  // _CMD_DETECT_DETECT_H_
@@ -0,0 +1,145 @@
+// Times the detection paths against each other, on a pair of captured images
+// or on a synthetic frame, and measures how closely coarse-to-fine detection
+// matches Detect.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/log/check.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "cmd/detect/detect.h"
+#include "lib/base/benchmark.h"
+#include "opencv2/opencv.hpp"
+
+ABSL_FLAG(std::string, off_file, "", "Off image; synthetic if unset");
+ABSL_FLAG(std::string, on_file, "", "On image; synthetic if unset");
+ABSL_FLAG(int, width, 1920, "Width of the synthetic images");
+ABSL_FLAG(int, height, 1080, "Height of the synthetic images");
+ABSL_FLAG(int, iterations, 50, "Number of times to run each path");
+ABSL_FLAG(int, coarse_scale, 4,
+          "Downscaling factor for coarse-to-fine detection: 2, 4 or 8");
+ABSL_FLAG(int, tile_size, 256, "Tile size for tiled detection");
+ABSL_FLAG(int, accuracy_scenes, 100,
+          "Number of synthetic scenes on which to compare coarse-to-fine "
+          "centroids with Detect's");
+
+namespace {
+
+// Returns the mean time taken by fn over --iterations runs.
+absl::Duration Time(const std::function<void()>& fn) {
+  return MeanRunTime(absl::GetFlag(FLAGS_iterations), fn);
+}
+
+// Compares coarse-to-fine centroids with Detect's on synthetic scenes of
+// off, each with one lit pixel of random size and brightness.
+void ReportAccuracy(cv::Mat off, cv::Mat mask, int scale) {
+  cv::RNG rng(2);
+  int found = 0, missed = 0, different = 0;
+  double total_error = 0, max_error = 0;
+  for (int i = 0; i < absl::GetFlag(FLAGS_accuracy_scenes); ++i) {
+    cv::Mat on = off.clone();
+    cv::circle(on, {rng.uniform(0, off.cols), rng.uniform(0, off.rows)},
+               rng.uniform(2, 20), cv::Scalar::all(rng.uniform(120, 256)),
+               cv::FILLED);
+
+    std::unique_ptr<DetectResults> want = Detect(off, on, mask);
+    std::unique_ptr<DetectResults> got =
+        Detect(off, on, mask, {.coarse = MakeCoarseImages(off, on, scale)});
+    if (!want->found) {
+      continue;
+    }
+    ++found;
+    if (got->searched.area() == off.size().area()) {
+      ++missed;  // found only by the full-frame fallback
+    }
+
+    const double error = std::hypot(got->centroid.x - want->centroid.x,
+                                    got->centroid.y - want->centroid.y);
+    different += error > 0;
+    total_error += error;
+    max_error = std::max(max_error, error);
+  }
+
+  std::cout << absl::StrFormat(
+      "coarse 1/%d accuracy: %d scenes, %d needed the full frame, %d "
+      "centroids differ, mean error %.2fpx, max %.2fpx\n",
+      scale, found, missed, different, found > 0 ? total_error / found : 0,
+      max_error);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage("benchmarks pixel detection");
+  absl::ParseCommandLine(argc, argv);
+
+  const int scale = absl::GetFlag(FLAGS_coarse_scale);
+  const std::optional<int> reduced_mode = ReducedReadMode(scale);
+  QCHECK(reduced_mode.has_value()) << "invalid --coarse_scale " << scale;
+
+  cv::Mat off, on;
+  CoarseImages coarse;
+  if (!absl::GetFlag(FLAGS_off_file).empty()) {
+    QCHECK(!absl::GetFlag(FLAGS_on_file).empty()) << "--on_file is required";
+    off = cv::imread(absl::GetFlag(FLAGS_off_file));
+    on = cv::imread(absl::GetFlag(FLAGS_on_file));
+    QCHECK(!off.empty() && !on.empty()) << "failed to read images";
+    coarse = {
+        .scale = scale,
+        .off = cv::imread(absl::GetFlag(FLAGS_off_file), *reduced_mode),
+        .on = cv::imread(absl::GetFlag(FLAGS_on_file), *reduced_mode),
+    };
+  } else {
+    // A dim, noisy scene with one lit pixel.
+    const int width = absl::GetFlag(FLAGS_width);
+    const int height = absl::GetFlag(FLAGS_height);
+    cv::RNG rng(1);
+    off = cv::Mat(height, width, CV_8UC3);
+    rng.fill(off, cv::RNG::UNIFORM, 0, 40);
+    on = off.clone();
+    cv::circle(on, {width / 3, height / 2}, 10, cv::Scalar::all(255),
+               cv::FILLED);
+    coarse = MakeCoarseImages(off, on, scale);
+  }
+  cv::Mat mask(off.rows, off.cols, CV_8U, cv::Scalar::all(255));
+
+  std::cout << absl::StrFormat("%dx%d, %d iterations\n", off.cols, off.rows,
+                               absl::GetFlag(FLAGS_iterations));
+
+  const absl::Duration multi =
+      Time([&] { Detect(off, on, mask, {.fused = false}); });
+  ReportRunTime("Detect (multi-pass)", multi, multi);
+  ReportRunTime("Detect (fused)",
+                Time([&] { Detect(off, on, mask, {.fused = true}); }), multi);
+  ReportRunTime("ThresholdGrayDiff",
+                Time([&] { ThresholdGrayDiff(off, on, mask, 80); }), multi);
+  ReportRunTime(absl::StrFormat("Detect (coarse 1/%d)", scale),
+                Time([&] { Detect(off, on, mask, {.coarse = coarse}); }),
+                multi);
+  const int tile_size = absl::GetFlag(FLAGS_tile_size);
+  ReportRunTime(absl::StrFormat("Detect (tiled %d)", tile_size),
+                Time([&] { Detect(off, on, mask, {.tile_size = tile_size}); }),
+                multi);
+
+  // Decoding is often the bigger cost, and the coarse images can be decoded
+  // reduced.
+  if (const std::string path = absl::GetFlag(FLAGS_on_file); !path.empty()) {
+    const absl::Duration full = Time([&] { cv::imread(path); });
+    ReportRunTime("imread", full, full);
+    ReportRunTime(absl::StrFormat("imread (1/%d)", scale),
+                  Time([&] { cv::imread(path, *reduced_mode); }), full);
+  }
+
+  ReportAccuracy(off, mask, scale);
+
+  return 0;
+}
@@ -1,4 +1,8 @@
+#include <filesystem>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "absl/debugging/failure_signal_handler.h"
 #include "absl/flags/flag.h"
@@ -10,10 +14,16 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "cmd/detect/batch.h"
 #include "cmd/detect/detect.h"
+#include "cmd/detect/records.h"
+#include "cmd/detect/roi.h"
+#include "cmd/detect/search_mask.h"
+#include "lib/cv/decoded_cache.h"
 #include "lib/file/file.h"
 #include "lib/file/path.h"
 #include "lib/file/proto.h"
+#include "lib/file/writers.h"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/opencv.hpp"
 #include "proto/points.pb.h"
@@ -23,15 +33,72 @@ ABSL_FLAG(std::string, off_file, "", "Off file");
 ABSL_FLAG(std::string, intermediates_dir, "",
           "Directory for intermediate results");
 ABSL_FLAG(bool, show_result, false, "imshow result");
+ABSL_FLAG(std::string, channel, "gray",
+          "Which light to look for: 'gray' for a white pixel, or 'red', "
+          "'green' or 'blue' for one of the pixels in an automap "
+          "--capture_mode=rgb image");
 ABSL_FLAG(int, camera_number, -1, "Camera number");
 ABSL_FLAG(int, pixel_number, -1, "Pixel number");
 ABSL_FLAG(std::string, input_coords, "",
           "File containing coordinates in proto.PixelRecords textproto format");
 ABSL_FLAG(std::string, output_coords, "",
           "File containing coordinates in proto.PixelRecords textproto format");
+ABSL_FLAG(std::string, batch_dir, "",
+          "Detect every pixel_NNN.jpg (rgb_NNN.jpg with --channel) in this "
+          "directory in one run, instead of --on_file and --pixel_number. "
+          "--off_file defaults to off.jpg in the directory, and results go to "
+          "--output_coords.");
+ABSL_FLAG(int, end_pixel, -1,
+          "Batch mode: the last pixel captured (automap's --end_pixel), if "
+          "not the last on the string. With --channel the final rgb_NNN.jpg "
+          "may light fewer than three pixels, and the channels past this "
+          "pixel are skipped rather than reported missed.");
+ABSL_FLAG(int, threads, 0,
+          "Number of images to process at once in batch mode; 0 means one "
+          "per CPU");
+ABSL_FLAG(std::string, marked_dir, "",
+          "Batch mode: directory to receive a copy of each image in which a "
+          "pixel was found, with the detection marked");
+ABSL_FLAG(std::string, missed_file, "",
+          "Batch mode: file to receive the numbers of the pixels that weren't "
+          "found, one per line (see automap --pixels_file)");
+ABSL_FLAG(bool, roi, false,
+          "Search first near the locations of the pixel's neighbors on the "
+          "string, taken from --input_coords. The whole frame is searched "
+          "if the pixel isn't found there. Not used with --channel.");
+ABSL_FLAG(int, coarse_scale, 0,
+          "If 2, 4 or 8, first look for the pixel in copies of the images "
+          "decoded at this fraction of their size, then only near what was "
+          "found there at full size. Not used with --channel, or when --roi "
+          "predicts where the pixel is.");
+ABSL_FLAG(bool, search_mask, false,
+          "Only search where automap's on.jpg shows lights, using a mask made "
+          "from on.jpg and off.jpg in the capture directory (--batch_dir, or "
+          "--on_file's directory) and saved there for later runs");
+ABSL_FLAG(int, search_mask_dilation, SearchMaskOptions().dilation,
+          "Distance, in image pixels, by which --search_mask grows the lit "
+          "area");
+ABSL_FLAG(bool, decoded_cache, false,
+          "Keep decoded gray copies of the images in a .decoded directory "
+          "beside them, so that later runs don't have to decode them. Not "
+          "used with --channel, --marked_dir, --intermediates_dir or "
+          "--show_result, which need the images in color");
+ABSL_FLAG(int, roi_min_radius, RoiOptions().min_radius,
+          "Smallest distance searched around a neighbor with --roi");
+ABSL_FLAG(int, tile_size, 0,
+          "If nonzero, search in tiles of this many pixels square, to bound "
+          "the memory used for each image (useful for large images and many "
+          "--threads). Not used with --channel or --intermediates_dir.");
 
 namespace {
 
+std::optional<RoiOptions> RoiOptionsFromFlags() {
+  if (!absl::GetFlag(FLAGS_roi)) {
+    return std::nullopt;
+  }
+  return RoiOptions{.min_radius = absl::GetFlag(FLAGS_roi_min_radius)};
+}
+
 absl::Status SaveImage(cv::Mat mat, const std::string& filename) {
   if (!cv::imwrite(filename, mat)) {
     return absl::UnknownError(
@@ -49,42 +116,123 @@ absl::StatusOr<std::unique_ptr<proto::PixelRecords>> ReadPixelsFromProto(
   return records;
 }
 
-void InsertResult(int camera_num, int pixel_num,
-                  std::optional<cv::Point2i> point,
-                  proto::PixelRecords* pixels) {
-  for (proto::PixelRecord& pixel : *pixels->mutable_pixel()) {
-    if (pixel.pixel_number() == pixel_num) {
-      if (point.has_value()) {
-        bool added = false;
-        for (proto::CameraPixelLocation& camera :
-             *pixel.mutable_camera_pixel()) {
-          if (camera.camera_number() == camera_num) {
-            camera.mutable_pixel_location()->set_x(point->x);
-            camera.mutable_pixel_location()->set_y(point->y);
-            camera.clear_manually_adjusted();
-            added = true;
-            break;
-          }
-        }
-
-        if (!added) {
-          proto::CameraPixelLocation* camera = pixel.add_camera_pixel();
-          camera->set_camera_number(camera_num);
-          camera->mutable_pixel_location()->set_x(point->x);
-          camera->mutable_pixel_location()->set_y(point->y);
-        }
-      }
-      return;
+std::optional<ColorChannel> ParseChannel(const std::string& str) {
+  if (str == "gray") {
+    return std::nullopt;
+  } else if (str == "red") {
+    return ColorChannel::kRed;
+  } else if (str == "green") {
+    return ColorChannel::kGreen;
+  } else if (str == "blue") {
+    return ColorChannel::kBlue;
+  }
+
+  QCHECK(false) << "invalid --channel " << str;
+  return std::nullopt;
+}
+
+// The pixel lit in each channel of an automap --capture_mode=rgb image,
+// relative to the image's number.
+int ChannelPixelOffset(std::optional<ColorChannel> channel) {
+  if (!channel.has_value()) {
+    return 0;
+  }
+  switch (*channel) {
+    case ColorChannel::kRed:
+      return 0;
+    case ColorChannel::kGreen:
+      return 1;
+    case ColorChannel::kBlue:
+      return 2;
+  }
+  return 0;
+}
+
+// Reads an image, which is valid for as long as the returned MappedImage
+// exists. If `gray` is set and --decoded_cache is, it's read gray through the
+// decoded image cache. Color images aren't cached, since a full-resolution
+// color copy of every image would take several times the JPEGs' space.
+MappedImage ReadImage(const std::string& path, bool gray) {
+  if (!absl::GetFlag(FLAGS_decoded_cache) || !gray) {
+    return MappedImage(cv::imread(path));
+  }
+
+  absl::StatusOr<MappedImage> image = ReadCachedImage(path, {.gray = true});
+  QCHECK_OK(image);
+  return std::move(*image);
+}
+
+// Returns the mask to detect with in the images in dir, which are of the
+// given size: the directory's search mask with --search_mask, and otherwise
+// the whole frame.
+SearchMask MaskFromFlags(const std::string& dir, int rows, int cols) {
+  if (!absl::GetFlag(FLAGS_search_mask)) {
+    return {
+        .mask = cv::Mat(rows, cols, CV_8U, cv::Scalar::all(255)),
+        .bounds = cv::Rect(0, 0, cols, rows),
+    };
+  }
+
+  auto mask = CameraSearchMask(
+      dir, {.dilation = absl::GetFlag(FLAGS_search_mask_dilation)});
+  QCHECK_OK(mask);
+  QCHECK(mask->mask.rows == rows && mask->mask.cols == cols)
+      << "search mask size doesn't match the images'";
+  return *mask;
+}
+
+// Detects every image in --batch_dir, adding the results to coords.
+void RunBatch(int camera_num, std::optional<ColorChannel> channel,
+              proto::PixelRecords* coords) {
+  const std::string dir = absl::GetFlag(FLAGS_batch_dir);
+  const std::string off_file = absl::GetFlag(FLAGS_off_file).empty()
+                                   ? JoinPath({dir, "off.jpg"})
+                                   : absl::GetFlag(FLAGS_off_file);
+
+  BatchDetectOptions batch_options = {
+      .num_threads = absl::GetFlag(FLAGS_threads),
+      .channel = channel,
+      .marked_dir = absl::GetFlag(FLAGS_marked_dir),
+      .roi = RoiOptionsFromFlags(),
+      .known_locations = CameraLocations(*coords, camera_num),
+      .tile_size = absl::GetFlag(FLAGS_tile_size),
+      .decoded_cache = absl::GetFlag(FLAGS_decoded_cache),
+  };
+  const MappedImage off_mapped =
+      ReadImage(off_file, DetectsGray(batch_options));
+  cv::Mat off_image = off_mapped.image();
+  QCHECK(!off_image.empty()) << "failed to read " << off_file;
+  const SearchMask mask = MaskFromFlags(dir, off_image.rows, off_image.cols);
+  batch_options.mask_bounds = mask.bounds;
+
+  auto images =
+      FindNumberedImages(dir, channel.has_value() ? "rgb_" : "pixel_");
+  QCHECK_OK(images);
+  const int offset = ChannelPixelOffset(channel);
+  if (const int end_pixel = absl::GetFlag(FLAGS_end_pixel); end_pixel >= 0) {
+    std::erase_if(*images, [&](const NumberedImage& image) {
+      return image.number + offset > end_pixel;
+    });
+  }
+  LOG(INFO) << "detecting " << images->size() << " images in " << dir;
+
+  auto results = DetectBatch(off_image, mask.mask, *images, batch_options);
+  QCHECK_OK(results);
+
+  std::vector<std::string> missed;
+  for (int i = 0; i < static_cast<int>(images->size()); ++i) {
+    const int pixel_num = (*images)[i].number + offset;
+    InsertResult(camera_num, pixel_num, (*results)[i], coords);
+    if (!(*results)[i].has_value()) {
+      missed.push_back(absl::StrFormat("%03d", pixel_num));
     }
   }
+  LOG(INFO) << "found " << images->size() - missed.size() << " of "
+            << images->size();
 
-  proto::PixelRecord* pixel = pixels->add_pixel();
-  pixel->set_pixel_number(pixel_num);
-  if (point.has_value()) {
-    proto::CameraPixelLocation* camera = pixel->add_camera_pixel();
-    camera->set_camera_number(camera_num);
-    camera->mutable_pixel_location()->set_x(point->x);
-    camera->mutable_pixel_location()->set_y(point->y);
+  if (const std::string path = absl::GetFlag(FLAGS_missed_file);
+      !path.empty()) {
+    QCHECK_OK(WriteFile(path, missed));
   }
 }
 
@@ -98,6 +246,25 @@ int main(int argc, char** argv) {
 
   const int camera_num = absl::GetFlag(FLAGS_camera_number);
   QCHECK_GT(camera_num, 0) << "--camera_number is required";
+
+  const std::optional<ColorChannel> channel =
+      ParseChannel(absl::GetFlag(FLAGS_channel));
+
+  if (!absl::GetFlag(FLAGS_batch_dir).empty()) {
+    const std::string output_path = absl::GetFlag(FLAGS_output_coords);
+    QCHECK(!output_path.empty()) << "--output_coords is required";
+
+    proto::PixelRecords coords;
+    if (const std::string& path = absl::GetFlag(FLAGS_input_coords);
+        !path.empty() && Exists(path).value_or(false)) {
+      QCHECK_OK(ReadProto(path, &coords));
+    }
+
+    RunBatch(camera_num, channel, &coords);
+    QCHECK_OK(WriteTextProto(output_path, coords));
+    return 0;
+  }
+
   const int pixel_num = absl::GetFlag(FLAGS_pixel_number);
   QCHECK_GE(pixel_num, 0) << "--pixel_number is required";
 
@@ -118,17 +285,57 @@ int main(int argc, char** argv) {
   LOG(INFO) << "off is " << absl::GetFlag(FLAGS_off_file);
   LOG(INFO) << "on  is " << absl::GetFlag(FLAGS_on_file);
 
-  cv::Mat on_image = cv::imread(absl::GetFlag(FLAGS_on_file));
-  cv::Mat off_image = cv::imread(absl::GetFlag(FLAGS_off_file));
+  // The multi-pass diff keeps every step's image for --intermediates_dir.
+  const bool save_intermediates =
+      !absl::GetFlag(FLAGS_intermediates_dir).empty();
+  const bool keep_intermediates =
+      save_intermediates || absl::GetFlag(FLAGS_show_result);
+
+  // Gray images are enough unless a channel is wanted or the images are to
+  // be saved or shown.
+  const bool gray = !channel.has_value() && !keep_intermediates;
+  const MappedImage on_mapped = ReadImage(absl::GetFlag(FLAGS_on_file), gray);
+  const MappedImage off_mapped =
+      ReadImage(absl::GetFlag(FLAGS_off_file), gray);
+  cv::Mat on_image = on_mapped.image();
+  cv::Mat off_image = off_mapped.image();
 
   QCHECK_EQ(on_image.rows, off_image.rows) << "size mismatch";
   QCHECK_EQ(on_image.cols, off_image.cols) << "size mismatch";
 
-  cv::Mat blank(on_image.rows, on_image.cols, CV_8U, cv::Scalar::all(0));
-  cv::Mat mask;
-  cv::bitwise_not(blank, mask);
+  const std::string dir =
+      std::filesystem::path(absl::GetFlag(FLAGS_on_file)).parent_path();
+  const SearchMask search_mask =
+      MaskFromFlags(dir.empty() ? "." : dir, on_image.rows, on_image.cols);
+  cv::Mat mask = search_mask.mask;
 
-  std::unique_ptr<DetectResults> results = Detect(off_image, on_image, mask);
+  DetectOptions detect_options = {
+      .fused = !save_intermediates,
+      .keep_intermediates = keep_intermediates,
+      .tile_size = save_intermediates ? 0 : absl::GetFlag(FLAGS_tile_size),
+      .mask_bounds = search_mask.bounds,
+  };
+  if (const int scale = absl::GetFlag(FLAGS_coarse_scale); scale != 0) {
+    const std::optional<int> mode = ReducedReadMode(scale);
+    QCHECK(mode.has_value()) << "invalid --coarse_scale " << scale;
+    detect_options.coarse = {
+        .scale = scale,
+        .off = cv::imread(absl::GetFlag(FLAGS_off_file), *mode),
+        .on = cv::imread(absl::GetFlag(FLAGS_on_file), *mode),
+    };
+  }
+  if (std::optional<RoiOptions> roi = RoiOptionsFromFlags(); roi.has_value()) {
+    detect_options.region =
+        PredictRegion(CameraLocations(*coords, camera_num), pixel_num, *roi);
+    if (!detect_options.region.has_value()) {
+      LOG(INFO) << "no neighbors known; searching whole frame";
+    }
+  }
+  std::unique_ptr<DetectResults> results =
+      channel.has_value()
+          ? DetectChannel(off_image, on_image, mask, *channel,
+                          keep_intermediates)
+          : Detect(off_image, on_image, mask, detect_options);
 
   if (!absl::GetFlag(FLAGS_intermediates_dir).empty()) {
     const std::string& dir = absl::GetFlag(FLAGS_intermediates_dir);
@@ -0,0 +1,320 @@
+#include "cmd/detect/detect.h"
+
+#include "cmd/detect/test_images.h"
+#include "gtest/gtest.h"
+#include "opencv2/opencv.hpp"
+
+namespace {
+
+using ::detect_testing::AllMask;
+using ::detect_testing::DrawPixel;
+using ::detect_testing::kCols;
+using ::detect_testing::kRows;
+using ::detect_testing::MakeImage;
+
+TEST(DetectTest, Detect) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {40, 60}, cv::Scalar::all(255));
+
+  std::unique_ptr<DetectResults> results = Detect(off, on, AllMask());
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 40, 1);
+  EXPECT_NEAR(results->centroid.y, 60, 1);
+
+  results = Detect(off, off, AllMask());
+  EXPECT_FALSE(results->found);
+}
+
+TEST(DetectTest, Region) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {40, 60}, cv::Scalar::all(255));
+
+  // The centroid is in image coordinates, and only the region was searched.
+  std::unique_ptr<DetectResults> results =
+      Detect(off, on, AllMask(),
+             {.keep_intermediates = true, .region = cv::Rect(20, 40, 50, 50)});
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 40, 1);
+  EXPECT_NEAR(results->centroid.y, 60, 1);
+  EXPECT_EQ(results->searched, cv::Rect(20, 40, 50, 50));
+  EXPECT_EQ(results->intermediates["marked"].size(), on.size());
+
+  // Regions are clipped to the image.
+  results = Detect(off, on, AllMask(), {.region = cv::Rect(0, 30, 500, 500)});
+  ASSERT_TRUE(results->found);
+  EXPECT_EQ(results->searched, cv::Rect(0, 30, kCols, kRows - 30));
+
+  // A brighter pixel outside the region is ignored.
+  DrawPixel(on, {120, 20}, cv::Scalar::all(255));
+  cv::circle(on, {120, 20}, 12, cv::Scalar::all(255), cv::FILLED);
+  results = Detect(off, on, AllMask(), {.region = cv::Rect(20, 40, 50, 50)});
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 40, 1);
+
+  // The whole frame is searched if the pixel isn't in the region.
+  results = Detect(off, on, AllMask(), {.region = cv::Rect(0, 0, 10, 10)});
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 120, 1);
+  EXPECT_NEAR(results->centroid.y, 20, 1);
+  EXPECT_EQ(results->searched, cv::Rect(0, 0, kCols, kRows));
+}
+
+TEST(DetectTest, MaskBounds) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {40, 60}, cv::Scalar::all(255));
+
+  std::unique_ptr<DetectResults> results =
+      Detect(off, on, AllMask(), {.mask_bounds = cv::Rect(20, 30, 60, 60)});
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 40, 1);
+  EXPECT_NEAR(results->centroid.y, 60, 1);
+  EXPECT_EQ(results->searched, cv::Rect(20, 30, 60, 60));
+
+  // A region that misses the pixel widens only to the bounds.
+  results = Detect(off, on, AllMask(),
+                   {.region = cv::Rect(0, 0, 30, 30),
+                    .mask_bounds = cv::Rect(20, 30, 60, 60)});
+  ASSERT_TRUE(results->found);
+  EXPECT_EQ(results->searched, cv::Rect(20, 30, 60, 60));
+
+  results =
+      Detect(off, on, AllMask(), {.mask_bounds = cv::Rect(80, 0, 70, 40)});
+  EXPECT_FALSE(results->found);
+}
+
+TEST(DetectTest, Coarse) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {40, 60}, cv::Scalar::all(255));
+  const std::unique_ptr<DetectResults> want = Detect(off, on, AllMask());
+  ASSERT_TRUE(want->found);
+
+  const CoarseImages coarse = MakeCoarseImages(off, on, 4);
+  std::vector<cv::Rect> candidates = FindCoarseCandidates(coarse, AllMask());
+  ASSERT_EQ(candidates.size(), 1);
+  EXPECT_TRUE(candidates[0].contains({40, 60}));
+
+  // The centroid is refined at full resolution, but only near the candidate.
+  std::unique_ptr<DetectResults> results =
+      Detect(off, on, AllMask(), {.coarse = coarse});
+  ASSERT_TRUE(results->found);
+  EXPECT_EQ(results->centroid, want->centroid);
+  EXPECT_LT(results->searched.area(), on.size().area() / 2);
+
+  // Nothing in the coarse images, so the whole frame is searched.
+  results =
+      Detect(off, on, AllMask(), {.coarse = MakeCoarseImages(off, off, 4)});
+  ASSERT_TRUE(results->found);
+  EXPECT_EQ(results->centroid, want->centroid);
+  EXPECT_EQ(results->searched, cv::Rect(0, 0, kCols, kRows));
+}
+
+TEST(DetectTest, ThresholdGrayDiffMatchesOpenCV) {
+  cv::RNG rng(1);
+  cv::Mat off(kRows, kCols, CV_8UC3), on(kRows, kCols, CV_8UC3);
+  rng.fill(off, cv::RNG::UNIFORM, 0, 256);
+  rng.fill(on, cv::RNG::UNIFORM, 0, 256);
+
+  cv::Mat mask(kRows, kCols, CV_8U);
+  rng.fill(mask, cv::RNG::UNIFORM, 0, 2);
+  mask *= 255;
+
+  // The multi-step version of what ThresholdGrayDiff does.
+  cv::Mat masked_off, masked_on;
+  cv::bitwise_and(off, off, masked_off, mask);
+  cv::bitwise_and(on, on, masked_on, mask);
+  cv::Mat gray_off, gray_on;
+  cv::cvtColor(masked_off, gray_off, cv::COLOR_BGR2GRAY);
+  cv::cvtColor(masked_on, gray_on, cv::COLOR_BGR2GRAY);
+  cv::Mat diff, want;
+  cv::absdiff(gray_off, gray_on, diff);
+  cv::threshold(diff, want, 80, 255, cv::THRESH_BINARY);
+
+  cv::Mat got = ThresholdGrayDiff(off, on, mask, 80);
+  ASSERT_EQ(got.type(), CV_8U);
+  EXPECT_EQ(cv::countNonZero(got != want), 0);
+  EXPECT_GT(cv::countNonZero(got), 0);
+}
+
+TEST(DetectTest, ThresholdGrayDiffGray) {
+  cv::RNG rng(3);
+  cv::Mat off(kRows, kCols, CV_8UC3), on(kRows, kCols, CV_8UC3);
+  rng.fill(off, cv::RNG::UNIFORM, 0, 256);
+  rng.fill(on, cv::RNG::UNIFORM, 0, 256);
+
+  cv::Mat gray_off, gray_on;
+  cv::cvtColor(off, gray_off, cv::COLOR_BGR2GRAY);
+  cv::cvtColor(on, gray_on, cv::COLOR_BGR2GRAY);
+
+  cv::Mat want = ThresholdGrayDiff(off, on, AllMask(), 80);
+  cv::Mat got = ThresholdGrayDiff(gray_off, gray_on, AllMask(), 80);
+  EXPECT_EQ(cv::countNonZero(got != want), 0);
+  EXPECT_GT(cv::countNonZero(got), 0);
+}
+
+TEST(DetectTest, FusedMatchesMultiPass) {
+  cv::RNG rng(2);
+  for (int i = 0; i < 20; ++i) {
+    SCOPED_TRACE(i);
+
+    // A noisy background with a few lit pixels of varying brightness, some
+    // of them too dim to be found.
+    cv::Mat off = MakeImage(), noise(kRows, kCols, CV_8UC3);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 10);
+    cv::add(off, noise, off);
+
+    cv::Mat on = off.clone();
+    rng.fill(noise, cv::RNG::NORMAL, 0, 10);
+    cv::add(on, noise, on);
+    for (int j = rng.uniform(0, 4); j > 0; --j) {
+      cv::circle(on, {rng.uniform(0, kCols), rng.uniform(0, kRows)},
+                 rng.uniform(1, 8), cv::Scalar::all(rng.uniform(50, 256)),
+                 cv::FILLED);
+    }
+
+    std::unique_ptr<DetectResults> fused =
+        Detect(off, on, AllMask(), {.fused = true, .keep_intermediates = true});
+    std::unique_ptr<DetectResults> multi = Detect(
+        off, on, AllMask(), {.fused = false, .keep_intermediates = true});
+    ASSERT_EQ(fused->found, multi->found);
+    if (fused->found) {
+      EXPECT_EQ(fused->centroid, multi->centroid);
+    }
+    EXPECT_EQ(cv::countNonZero(fused->intermediates["eroded"] !=
+                               multi->intermediates["eroded"]),
+              0);
+  }
+}
+
+TEST(DetectTest, Intermediates) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {40, 60}, cv::Scalar::all(255));
+
+  EXPECT_TRUE(Detect(off, on, AllMask())->intermediates.empty());
+
+  std::unique_ptr<DetectResults> results =
+      Detect(off, on, AllMask(), {.keep_intermediates = true});
+  EXPECT_EQ(results->intermediates["marked"].size(), on.size());
+  EXPECT_EQ(results->intermediates["eroded"].size(), on.size());
+}
+
+TEST(DetectTest, Tiled) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+
+  // A pixel at the corner of four tiles, each of which holds less of it
+  // than the whole of a smaller pixel within one tile.
+  DrawPixel(on, {64, 64}, cv::Scalar::all(255));
+  cv::circle(on, {64, 64}, 10, cv::Scalar::all(255), cv::FILLED);
+  cv::circle(on, {112, 48}, 7, cv::Scalar::all(255), cv::FILLED);
+
+  std::unique_ptr<DetectResults> results =
+      Detect(off, on, AllMask(), {.tile_size = 32});
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 64, 1);
+  EXPECT_NEAR(results->centroid.y, 64, 1);
+  EXPECT_EQ(results->searched, cv::Rect(0, 0, kCols, kRows));
+  EXPECT_TRUE(results->intermediates.empty());
+
+  // Tiles are laid out from the region's corner, and the centroid is in
+  // image coordinates.
+  results = Detect(
+      off, on, AllMask(),
+      {.keep_intermediates = true, .tile_size = 8,
+       .region = cv::Rect(90, 30, 40, 40)});
+  ASSERT_TRUE(results->found);
+  EXPECT_NEAR(results->centroid.x, 112, 1);
+  EXPECT_NEAR(results->centroid.y, 48, 1);
+  EXPECT_EQ(results->searched, cv::Rect(90, 30, 40, 40));
+  EXPECT_EQ(results->intermediates.size(), 1);
+  EXPECT_EQ(results->intermediates["marked"].size(), on.size());
+
+  EXPECT_FALSE(Detect(off, off, AllMask(), {.tile_size = 32})->found);
+}
+
+TEST(DetectTest, TiledMatchesUntiled) {
+  cv::RNG rng(4);
+  for (int i = 0; i < 20; ++i) {
+    SCOPED_TRACE(i);
+
+    cv::Mat off = MakeImage(), noise(kRows, kCols, CV_8UC3);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 10);
+    cv::add(off, noise, off);
+
+    cv::Mat on = off.clone();
+    rng.fill(noise, cv::RNG::NORMAL, 0, 10);
+    cv::add(on, noise, on);
+    cv::circle(on, {rng.uniform(0, kCols), rng.uniform(0, kRows)},
+               rng.uniform(3, 16), cv::Scalar::all(255), cv::FILLED);
+
+    std::unique_ptr<DetectResults> want = Detect(off, on, AllMask());
+    ASSERT_TRUE(want->found);
+    for (const int tile_size : {7, 16, 32}) {
+      SCOPED_TRACE(tile_size);
+      std::unique_ptr<DetectResults> got =
+          Detect(off, on, AllMask(), {.tile_size = tile_size});
+      ASSERT_TRUE(got->found);
+      EXPECT_NEAR(got->centroid.x, want->centroid.x, 1);
+      EXPECT_NEAR(got->centroid.y, want->centroid.y, 1);
+    }
+  }
+}
+
+TEST(DetectTest, DetectChannel) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {30, 30}, cv::Scalar(0, 0, 255));   // red
+  DrawPixel(on, {75, 50}, cv::Scalar(0, 255, 0));   // green
+  DrawPixel(on, {120, 70}, cv::Scalar(255, 0, 0));  // blue
+
+  const struct {
+    ColorChannel channel;
+    cv::Point want;
+  } kTestCases[] = {
+      {ColorChannel::kRed, {30, 30}},
+      {ColorChannel::kGreen, {75, 50}},
+      {ColorChannel::kBlue, {120, 70}},
+  };
+
+  for (const auto& tc : kTestCases) {
+    SCOPED_TRACE(static_cast<int>(tc.channel));
+    std::unique_ptr<DetectResults> results =
+        DetectChannel(off, on, AllMask(), tc.channel,
+                      /*keep_intermediates=*/false);
+    ASSERT_TRUE(results->found);
+    EXPECT_NEAR(results->centroid.x, tc.want.x, 1);
+    EXPECT_NEAR(results->centroid.y, tc.want.y, 1);
+    EXPECT_TRUE(results->intermediates.empty());
+  }
+}
+
+TEST(DetectTest, DetectChannelIntermediates) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {30, 30}, cv::Scalar(0, 0, 255));
+
+  std::unique_ptr<DetectResults> results =
+      DetectChannel(off, on, AllMask(), ColorChannel::kRed,
+                    /*keep_intermediates=*/true);
+  ASSERT_TRUE(results->found);
+  EXPECT_EQ(results->intermediates["dominance"].size(), on.size());
+  EXPECT_EQ(results->intermediates["eroded"].size(), on.size());
+  EXPECT_EQ(results->intermediates["marked"].size(), on.size());
+}
+
+TEST(DetectTest, DetectChannelIgnoresWhite) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  DrawPixel(on, {40, 60}, cv::Scalar::all(255));
+
+  EXPECT_FALSE(
+      DetectChannel(off, on, AllMask(), ColorChannel::kRed,
+                    /*keep_intermediates=*/false)
+          ->found);
+}
+
+}  // namespace
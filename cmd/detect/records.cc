@@ -0,0 +1,45 @@
+#include "cmd/detect/records.h"
+
+#include <optional>
+
+#include "opencv2/core/types.hpp"
+#include "proto/points.pb.h"
+
+void InsertResult(int camera_num, int pixel_num,
+                  std::optional<cv::Point2i> point,
+                  proto::PixelRecords* pixels) {
+  for (proto::PixelRecord& pixel : *pixels->mutable_pixel()) {
+    if (pixel.pixel_number() == pixel_num) {
+      if (point.has_value()) {
+        bool added = false;
+        for (proto::CameraPixelLocation& camera :
+             *pixel.mutable_camera_pixel()) {
+          if (camera.camera_number() == camera_num) {
+            camera.mutable_pixel_location()->set_x(point->x);
+            camera.mutable_pixel_location()->set_y(point->y);
+            camera.clear_manually_adjusted();
+            added = true;
+            break;
+          }
+        }
+
+        if (!added) {
+          proto::CameraPixelLocation* camera = pixel.add_camera_pixel();
+          camera->set_camera_number(camera_num);
+          camera->mutable_pixel_location()->set_x(point->x);
+          camera->mutable_pixel_location()->set_y(point->y);
+        }
+      }
+      return;
+    }
+  }
+
+  proto::PixelRecord* pixel = pixels->add_pixel();
+  pixel->set_pixel_number(pixel_num);
+  if (point.has_value()) {
+    proto::CameraPixelLocation* camera = pixel->add_camera_pixel();
+    camera->set_camera_number(camera_num);
+    camera->mutable_pixel_location()->set_x(point->x);
+    camera->mutable_pixel_location()->set_y(point->y);
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef _CMD_DETECT_RECORDS_H_
+#define _CMD_DETECT_RECORDS_H_ 1
+
+#include <optional>
+
+#include "opencv2/core/types.hpp"
+#include "proto/points.pb.h"
+
+// Records the detection result for one pixel as seen by one camera. A record
+// is created for the pixel if necessary, even if it wasn't found (point is
+// nullopt), so that the output enumerates every pixel that was examined.
+void InsertResult(int camera_num, int pixel_num,
+                  std::optional<cv::Point2i> point,
+                  proto::PixelRecords* pixels);
+
+#endif  // _CMD_DETECT_RECORDS_H_
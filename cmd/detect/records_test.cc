@@ -0,0 +1,52 @@
+#include "cmd/detect/records.h"
+
+#include "gtest/gtest.h"
+#include "lib/testing/proto.h"
+#include "proto/points.pb.h"
+
+namespace {
+
+TEST(InsertResultTest, Test) {
+  proto::PixelRecords records = ParseTextProtoOrDie<proto::PixelRecords>(R"(
+    pixel {
+      pixel_number: 1
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 1 y: 2 }
+        manually_adjusted: true
+      }
+    }
+  )");
+
+  InsertResult(1, 1, cv::Point2i(3, 4), &records);
+  InsertResult(2, 1, cv::Point2i(5, 6), &records);
+  InsertResult(1, 2, std::nullopt, &records);
+  InsertResult(1, 3, cv::Point2i(7, 8), &records);
+
+  const proto::PixelRecords want = ParseTextProtoOrDie<proto::PixelRecords>(R"(
+    pixel {
+      pixel_number: 1
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 3 y: 4 }
+      }
+      camera_pixel {
+        camera_number: 2
+        pixel_location { x: 5 y: 6 }
+      }
+    }
+    pixel { pixel_number: 2 }
+    pixel {
+      pixel_number: 3
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 7 y: 8 }
+      }
+    }
+  )");
+
+  std::string diffs;
+  EXPECT_TRUE(ProtoDiff(want, records, &diffs)) << diffs;
+}
+
+}  // namespace
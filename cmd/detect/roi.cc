@@ -0,0 +1,86 @@
+#include "cmd/detect/roi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#include "opencv2/core/types.hpp"
+#include "proto/points.pb.h"
+
+namespace {
+
+std::optional<cv::Point2i> Find(const PixelLocations& known, int pixel_num) {
+  auto iter = known.find(pixel_num);
+  if (iter == known.end()) {
+    return std::nullopt;
+  }
+  return iter->second;
+}
+
+// Returns the region around the nearest neighbor of pixel_num in direction
+// dir (+1 or -1), or nullopt if there isn't one within options.max_gap.
+std::optional<cv::Rect> RegionFromSide(const PixelLocations& known,
+                                       int pixel_num, int dir,
+                                       const RoiOptions& options) {
+  for (int gap = 1; gap <= options.max_gap; ++gap) {
+    std::optional<cv::Point2i> neighbor = Find(known, pixel_num + dir * gap);
+    if (!neighbor.has_value()) {
+      continue;
+    }
+
+    // The distance from the neighbor to the next one out on the same side
+    // estimates the spacing between pixels in this part of the image.
+    double spacing = 0;
+    if (std::optional<cv::Point2i> next =
+            Find(known, pixel_num + dir * (gap + 1));
+        next.has_value()) {
+      spacing = std::hypot(neighbor->x - next->x, neighbor->y - next->y);
+    }
+
+    const int radius = static_cast<int>(std::ceil(
+        gap * std::max<double>(options.min_radius,
+                               options.spacing_factor * spacing)));
+    return cv::Rect(neighbor->x - radius, neighbor->y - radius,
+                    2 * radius + 1, 2 * radius + 1);
+  }
+  return std::nullopt;
+}
+
+}  // namespace
+
+PixelLocations CameraLocations(const proto::PixelRecords& records,
+                               int camera_num) {
+  PixelLocations locations;
+  for (const proto::PixelRecord& pixel : records.pixel()) {
+    for (const proto::CameraPixelLocation& camera : pixel.camera_pixel()) {
+      if (camera.camera_number() == camera_num &&
+          camera.has_pixel_location()) {
+        locations[pixel.pixel_number()] = cv::Point2i(
+            camera.pixel_location().x(), camera.pixel_location().y());
+      }
+    }
+  }
+  return locations;
+}
+
+std::optional<cv::Rect> PredictRegion(const PixelLocations& known,
+                                      int pixel_num,
+                                      const RoiOptions& options) {
+  std::optional<cv::Rect> before =
+      RegionFromSide(known, pixel_num, -1, options);
+  std::optional<cv::Rect> after = RegionFromSide(known, pixel_num, 1, options);
+  if (!before.has_value()) {
+    return after;
+  } else if (!after.has_value()) {
+    return before;
+  }
+
+  // Search around both neighbors, which also covers the space between them.
+  const int left = std::min(before->x, after->x);
+  const int top = std::min(before->y, after->y);
+  const int right =
+      std::max(before->x + before->width, after->x + after->width);
+  const int bottom =
+      std::max(before->y + before->height, after->y + after->height);
+  return cv::Rect(left, top, right - left, bottom - top);
+}
@@ -0,0 +1,40 @@
+#ifndef _CMD_DETECT_ROI_H_
+#define _CMD_DETECT_ROI_H_ 1
+
+#include <map>
+#include <optional>
+
+#include "opencv2/core/types.hpp"
+#include "proto/points.pb.h"
+
+// Image locations of pixels as seen by one camera, keyed by pixel number.
+using PixelLocations = std::map<int, cv::Point2i>;
+
+// Returns the locations recorded for camera_num in records.
+PixelLocations CameraLocations(const proto::PixelRecords& records,
+                               int camera_num);
+
+struct RoiOptions {
+  // Smallest distance from the nearest known neighbor to the edge of the
+  // region. Used as-is when the spacing between pixels can't be estimated.
+  int min_radius = 100;
+
+  // How many times the distance between adjacent pixels near the neighbor
+  // the region extends from it, which allows for the string changing
+  // direction and for uneven spacing.
+  double spacing_factor = 2.0;
+
+  // How far along the string to look for a known neighbor, so that a pixel
+  // the camera missed doesn't prevent prediction of the pixels next to it.
+  int max_gap = 3;
+};
+
+// Predicts the region of the image in which pixel_num will be found, from the
+// locations of its nearest known neighbors on the string (pixel_num-1 and
+// pixel_num-2, and likewise after it). Returns nullopt if no neighbor within
+// max_gap is known. The region is not clipped to the image.
+std::optional<cv::Rect> PredictRegion(const PixelLocations& known,
+                                      int pixel_num,
+                                      const RoiOptions& options);
+
+#endif  // _CMD_DETECT_ROI_H_
@@ -0,0 +1,109 @@
+#include "cmd/detect/roi.h"
+
+#include <optional>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/testing/proto.h"
+#include "proto/points.pb.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Pair;
+
+MATCHER_P4(RectIs, x, y, width, height, "") {
+  return arg.x == x && arg.y == y && arg.width == width &&
+         arg.height == height;
+}
+
+TEST(CameraLocationsTest, Test) {
+  proto::PixelRecords records = ParseTextProtoOrDie<proto::PixelRecords>(R"(
+    pixel {
+      pixel_number: 1
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 1 y: 2 }
+      }
+      camera_pixel {
+        camera_number: 2
+        pixel_location { x: 3 y: 4 }
+      }
+    }
+    pixel { pixel_number: 2 }
+    pixel {
+      pixel_number: 3
+      camera_pixel {
+        camera_number: 1
+        pixel_location { x: 5 y: 6 }
+      }
+    }
+  )");
+
+  PixelLocations locations = CameraLocations(records, 1);
+  ASSERT_THAT(locations, ElementsAre(Pair(1, testing::_), Pair(3, testing::_)));
+  EXPECT_EQ(locations[1].x, 1);
+  EXPECT_EQ(locations[1].y, 2);
+  EXPECT_EQ(locations[3].x, 5);
+  EXPECT_EQ(locations[3].y, 6);
+
+  EXPECT_THAT(CameraLocations(records, 2), ElementsAre(Pair(1, testing::_)));
+}
+
+TEST(PredictRegionTest, NoNeighbors) {
+  const RoiOptions options = {.min_radius = 10};
+  EXPECT_EQ(PredictRegion({}, 5, options), std::nullopt);
+
+  // Too far away along the string.
+  EXPECT_EQ(PredictRegion({{1, cv::Point2i(100, 100)}}, 5, options),
+            std::nullopt);
+}
+
+TEST(PredictRegionTest, OneNeighbor) {
+  const RoiOptions options = {.min_radius = 10};
+  std::optional<cv::Rect> region =
+      PredictRegion({{4, cv::Point2i(100, 200)}}, 5, options);
+  ASSERT_TRUE(region.has_value());
+  EXPECT_THAT(*region, RectIs(90, 190, 21, 21));
+
+  // Neighbors after the pixel work too.
+  region = PredictRegion({{6, cv::Point2i(100, 200)}}, 5, options);
+  ASSERT_TRUE(region.has_value());
+  EXPECT_THAT(*region, RectIs(90, 190, 21, 21));
+}
+
+TEST(PredictRegionTest, Spacing) {
+  const RoiOptions options = {.min_radius = 10, .spacing_factor = 2.0};
+
+  // Pixels 30 apart, so the region extends 60 from pixel 4.
+  std::optional<cv::Rect> region = PredictRegion(
+      {{3, cv::Point2i(70, 200)}, {4, cv::Point2i(100, 200)}}, 5, options);
+  ASSERT_TRUE(region.has_value());
+  EXPECT_THAT(*region, RectIs(40, 140, 121, 121));
+
+  // Closer than min_radius.
+  region = PredictRegion(
+      {{3, cv::Point2i(97, 200)}, {4, cv::Point2i(100, 200)}}, 5, options);
+  ASSERT_TRUE(region.has_value());
+  EXPECT_THAT(*region, RectIs(90, 190, 21, 21));
+}
+
+TEST(PredictRegionTest, Gap) {
+  const RoiOptions options = {.min_radius = 10, .max_gap = 3};
+
+  // Pixel 4 was missed, so the region around pixel 3 allows for two steps.
+  std::optional<cv::Rect> region =
+      PredictRegion({{3, cv::Point2i(100, 200)}}, 5, options);
+  ASSERT_TRUE(region.has_value());
+  EXPECT_THAT(*region, RectIs(80, 180, 41, 41));
+}
+
+TEST(PredictRegionTest, BothSides) {
+  const RoiOptions options = {.min_radius = 10};
+  std::optional<cv::Rect> region = PredictRegion(
+      {{4, cv::Point2i(100, 200)}, {6, cv::Point2i(130, 180)}}, 5, options);
+  ASSERT_TRUE(region.has_value());
+  EXPECT_THAT(*region, RectIs(90, 170, 51, 41));
+}
+
+}  // namespace
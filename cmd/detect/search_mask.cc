@@ -0,0 +1,121 @@
+#include "cmd/detect/search_mask.h"
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "cmd/detect/detect.h"
+#include "lib/file/file.h"
+#include "lib/file/path.h"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+SearchMask MakeSearchMask(cv::Mat off, cv::Mat on,
+                          const SearchMaskOptions& options) {
+  cv::Mat all(on.rows, on.cols, CV_8U, cv::Scalar::all(255));
+  cv::Mat lit = ThresholdGrayDiff(off, on, all, options.threshold);
+
+  SearchMask out;
+  const int size = 2 * options.dilation + 1;
+  cv::dilate(lit, out.mask,
+             cv::getStructuringElement(cv::MORPH_ELLIPSE,
+                                       cv::Size(size, size)));
+  out.bounds = cv::boundingRect(out.mask);
+  return out;
+}
+
+namespace {
+
+// Returns whether the saved mask at `path` exists and was written after each
+// of `sources` that exists.
+absl::StatusOr<bool> IsFresh(const std::string& path,
+                             const std::vector<std::string>& sources) {
+  std::error_code ec;
+  const std::filesystem::file_time_type written =
+      std::filesystem::last_write_time(path, ec);
+  if (ec == std::errc::no_such_file_or_directory) {
+    return false;
+  } else if (ec) {
+    return absl::UnknownError(
+        absl::StrCat("failed to stat ", path, ": ", ec.message()));
+  }
+
+  for (const std::string& source : sources) {
+    const std::filesystem::file_time_type modified =
+        std::filesystem::last_write_time(source, ec);
+    if (ec == std::errc::no_such_file_or_directory) {
+      continue;
+    } else if (ec) {
+      return absl::UnknownError(
+          absl::StrCat("failed to stat ", source, ": ", ec.message()));
+    }
+    if (modified > written) {
+      LOG(INFO) << source << " is newer than " << path;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+absl::StatusOr<SearchMask> CameraSearchMask(const std::string& dir,
+                                            const SearchMaskOptions& options) {
+  const std::string path =
+      JoinPath({dir, absl::StrFormat("search_mask_t%d_d%d.png",
+                                     options.threshold, options.dilation)});
+  const std::string off_path = JoinPath({dir, "off.jpg"});
+  const std::string on_path = JoinPath({dir, "on.jpg"});
+
+  absl::StatusOr<bool> cached = IsFresh(path, {off_path, on_path});
+  if (!cached.ok()) {
+    return cached.status();
+  }
+  if (*cached) {
+    cv::Mat mask = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    if (mask.empty()) {
+      return absl::UnknownError(absl::StrCat("failed to read ", path));
+    }
+    return SearchMask{.mask = mask, .bounds = cv::boundingRect(mask)};
+  }
+
+  cv::Mat off = cv::imread(off_path);
+  cv::Mat on = cv::imread(on_path);
+  if (off.empty() || on.empty()) {
+    return absl::NotFoundError(
+        absl::StrCat("failed to read ", off_path, " and ", on_path));
+  }
+  if (off.size() != on.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(off_path, " and ", on_path, " differ in size"));
+  }
+
+  SearchMask mask = MakeSearchMask(off, on, options);
+  if (mask.bounds.empty()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("no lights are lit in ", on_path));
+  }
+  LOG(INFO) << "search area is " << mask.bounds.width << "x"
+            << mask.bounds.height << " of " << on.cols << "x" << on.rows;
+
+  // PNG is lossless, which the mask must be. It's written atomically so
+  // that an interrupted run can't leave a corrupt mask for later ones.
+  std::vector<unsigned char> png;
+  if (!cv::imencode(".png", mask.mask, png)) {
+    return absl::UnknownError(absl::StrCat("failed to encode ", path));
+  }
+  if (absl::Status status = WriteFileAtomically(
+          path, absl::string_view(reinterpret_cast<const char*>(png.data()),
+                                  png.size()));
+      !status.ok()) {
+    return status;
+  }
+  return mask;
+}
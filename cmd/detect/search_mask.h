@@ -0,0 +1,40 @@
+#ifndef _CMD_DETECT_SEARCH_MASK_H_
+#define _CMD_DETECT_SEARCH_MASK_H_ 1
+
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "opencv2/core/mat.hpp"
+#include "opencv2/core/types.hpp"
+
+struct SearchMaskOptions {
+  // Gray level difference between the on and off images at which an image
+  // pixel counts as lit. Lower than Detect's, as lights seen edge-on are
+  // dim.
+  int threshold = 40;
+
+  // Distance, in image pixels, by which the lit area is grown, so that
+  // lights that were dim or hidden in the on image are still inside it.
+  int dilation = 50;
+};
+
+// The part of a camera's view in which lights can appear.
+struct SearchMask {
+  cv::Mat mask;     // CV_8U, 255 where lights can appear
+  cv::Rect bounds;  // of mask's nonzero area
+};
+
+// Returns the area lit in `on`, an image with every light on, and not in
+// `off`, grown by options.dilation. This leaves out the sky, street lights
+// and anything else the lights don't cover.
+SearchMask MakeSearchMask(cv::Mat off, cv::Mat on,
+                          const SearchMaskOptions& options);
+
+// Returns the search mask for a capture directory containing automap's
+// off.jpg and on.jpg. It's made the first time it's asked for and saved in
+// the directory, named for the options, for later runs to read. It's made
+// again if either image has been written since.
+absl::StatusOr<SearchMask> CameraSearchMask(const std::string& dir,
+                                            const SearchMaskOptions& options);
+
+#endif  // _CMD_DETECT_SEARCH_MASK_H_
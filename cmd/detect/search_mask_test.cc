@@ -0,0 +1,77 @@
+#include "cmd/detect/search_mask.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "cmd/detect/test_images.h"
+#include "gtest/gtest.h"
+#include "lib/file/file.h"
+#include "lib/file/path.h"
+#include "lib/testing/file.h"
+#include "opencv2/opencv.hpp"
+
+namespace {
+
+using ::detect_testing::kCols;
+using ::detect_testing::kRows;
+using ::detect_testing::MakeImage;
+
+TEST(MakeSearchMaskTest, Test) {
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  cv::circle(on, {40, 50}, 3, cv::Scalar::all(255), cv::FILLED);
+  cv::circle(on, {60, 50}, 3, cv::Scalar::all(255), cv::FILLED);
+
+  // A street light, lit in both.
+  cv::circle(off, {130, 10}, 5, cv::Scalar::all(255), cv::FILLED);
+  cv::circle(on, {130, 10}, 5, cv::Scalar::all(255), cv::FILLED);
+
+  SearchMask mask = MakeSearchMask(off, on, {.dilation = 10});
+  ASSERT_EQ(mask.mask.type(), CV_8U);
+  EXPECT_EQ(mask.mask.at<uchar>(50, 40), 255);
+  EXPECT_EQ(mask.mask.at<uchar>(50, 50), 255);  // between the lights
+  EXPECT_EQ(mask.mask.at<uchar>(58, 40), 255);  // within the dilation
+  EXPECT_EQ(mask.mask.at<uchar>(70, 40), 0);
+  EXPECT_EQ(mask.mask.at<uchar>(10, 130), 0);
+  EXPECT_EQ(mask.bounds, cv::Rect(27, 37, 47, 27));
+}
+
+TEST(CameraSearchMaskTest, Test) {
+  const std::string dir = MakeTestDir("search_mask");
+  const std::string on_path = JoinPath({dir, "on.jpg"});
+  const std::string mask_path = JoinPath({dir, "search_mask_t40_d5.png"});
+
+  EXPECT_FALSE(CameraSearchMask(dir, {}).ok());
+
+  cv::Mat off = MakeImage();
+  cv::Mat on = MakeImage();
+  cv::circle(on, {40, 50}, 3, cv::Scalar::all(255), cv::FILLED);
+  ASSERT_TRUE(cv::imwrite(JoinPath({dir, "off.jpg"}), off));
+  ASSERT_TRUE(cv::imwrite(on_path, on));
+
+  auto made = CameraSearchMask(dir, {.dilation = 5});
+  ASSERT_TRUE(made.ok()) << made.status();
+  EXPECT_EQ(Exists(mask_path).value_or(false), true);
+
+  // Later calls read the saved mask.
+  cv::Mat saved(kRows, kCols, CV_8U, cv::Scalar(0));
+  saved(cv::Rect(10, 20, 30, 40)).setTo(255);
+  ASSERT_TRUE(cv::imwrite(mask_path, saved));
+  auto cached = CameraSearchMask(dir, {.dilation = 5});
+  ASSERT_TRUE(cached.ok()) << cached.status();
+  EXPECT_EQ(cached->bounds, cv::Rect(10, 20, 30, 40));
+
+  // Until the images are captured again. The new on image has nothing lit.
+  // It's made newer explicitly, in case timestamps are coarse.
+  ASSERT_TRUE(cv::imwrite(on_path, off));
+  std::filesystem::last_write_time(
+      on_path,
+      std::filesystem::last_write_time(mask_path) + std::chrono::seconds(1));
+  EXPECT_FALSE(CameraSearchMask(dir, {.dilation = 5}).ok());
+
+  // Different options make a different mask.
+  EXPECT_FALSE(CameraSearchMask(dir, {.dilation = 6}).ok());
+}
+
+}  // namespace
@@ -0,0 +1,164 @@
+// Finds the pixels in a video recorded by automap --capture_mode=stream,
+// using the pushes automap recorded to pick the frames showing each pixel.
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/debugging/failure_signal_handler.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/log/check.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "cmd/detect/detect.h"
+#include "cmd/detect/records.h"
+#include "lib/file/file.h"
+#include "lib/file/path.h"
+#include "lib/file/proto.h"
+#include "lib/file/stream_align.h"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/opencv.hpp"
+#include "proto/points.pb.h"
+
+ABSL_FLAG(std::string, camera_dir, "",
+          "Camera directory written by automap --capture_mode=stream, "
+          "containing stream.avi and stream_frames.csv");
+ABSL_FLAG(std::string, pushes, "",
+          "Pushes file written by automap; defaults to stream_pushes.csv in "
+          "--camera_dir");
+ABSL_FLAG(int, camera_number, -1, "Camera number");
+ABSL_FLAG(std::string, input_coords, "",
+          "File containing coordinates in proto.PixelRecords textproto format");
+ABSL_FLAG(std::string, output_coords, "",
+          "File to receive coordinates in proto.PixelRecords textproto format");
+ABSL_FLAG(absl::Duration, latency, StreamAlignOptions().latency,
+          "Time from a push until captured frames show it (see automap "
+          "--probe_samples for the controller's share)");
+ABSL_FLAG(absl::Duration, margin, StreamAlignOptions().margin,
+          "Frames this close to the start or end of a pixel's window are not "
+          "used");
+ABSL_FLAG(std::string, extract_dir, "",
+          "If set, the frame used for each pixel is written here as "
+          "pixel_NNN.jpg, with off.jpg, as automap --capture_mode=single "
+          "would have");
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::SetProgramUsageMessage("detects pixels in a recorded stream");
+  absl::ParseCommandLine(argc, argv);
+  absl::InstallFailureSignalHandler(absl::FailureSignalHandlerOptions());
+
+  const int camera_num = absl::GetFlag(FLAGS_camera_number);
+  QCHECK_GT(camera_num, 0) << "--camera_number is required";
+  const std::string camera_dir = absl::GetFlag(FLAGS_camera_dir);
+  QCHECK(!camera_dir.empty()) << "--camera_dir is required";
+  const std::string output_path = absl::GetFlag(FLAGS_output_coords);
+  QCHECK(!output_path.empty()) << "--output_coords is required";
+  const std::string extract_dir = absl::GetFlag(FLAGS_extract_dir);
+
+  const std::string pushes_path =
+      absl::GetFlag(FLAGS_pushes).empty()
+          ? JoinPath({camera_dir, "stream_pushes.csv"})
+          : absl::GetFlag(FLAGS_pushes);
+  auto pushes = ReadStreamPushes(pushes_path);
+  QCHECK_OK(pushes);
+  auto frame_times =
+      ReadStreamFrameTimes(JoinPath({camera_dir, "stream_frames.csv"}));
+  QCHECK_OK(frame_times);
+
+  const std::vector<SteadyFrames> aligned =
+      AlignStream(*pushes, *frame_times,
+                  {
+                      .latency = absl::GetFlag(FLAGS_latency),
+                      .margin = absl::GetFlag(FLAGS_margin),
+                  });
+
+  proto::PixelRecords coords;
+  if (const std::string& path = absl::GetFlag(FLAGS_input_coords);
+      !path.empty() && Exists(path).value_or(false)) {
+    QCHECK_OK(ReadProto(path, &coords));
+  }
+
+  // The middle steady frame is the one least affected by jitter in the
+  // latency. Frames are decoded in order, so this maps the index of each
+  // frame that's needed to the push that needs it. The off image comes from
+  // the first all-off push, which automap makes before lighting any pixel.
+  std::map<int, const SteadyFrames*> wanted;
+  std::optional<int> off_index;
+  for (const SteadyFrames& steady : aligned) {
+    const bool off = steady.push.pixel == kStreamAllOff;
+    if (steady.frames.empty()) {
+      if (!off) {
+        LOG(WARNING) << "pixel " << steady.push.pixel << " has no steady "
+                     << "frames; is --latency too long?";
+        InsertResult(camera_num, steady.push.pixel, std::nullopt, &coords);
+      }
+      continue;
+    }
+
+    const int index = steady.frames[steady.frames.size() / 2];
+    if (off) {
+      if (!off_index.has_value()) {
+        off_index = index;
+        wanted[index] = &steady;
+      }
+      continue;
+    }
+    wanted[index] = &steady;
+  }
+  QCHECK(off_index.has_value()) << "no steady all-off frames";
+
+  const std::string video_path = JoinPath({camera_dir, "stream.avi"});
+  cv::VideoCapture video(video_path);
+  QCHECK(video.isOpened()) << "failed to open " << video_path;
+
+  cv::Mat off_image, mask;
+  int num_found = 0, num_pixels = 0;
+  cv::Mat frame;
+  for (int index = 0; !wanted.empty() && video.read(frame); ++index) {
+    auto iter = wanted.find(index);
+    if (iter == wanted.end()) {
+      continue;
+    }
+    const StreamPush& push = iter->second->push;
+    wanted.erase(iter);
+
+    if (push.pixel == kStreamAllOff) {
+      off_image = frame.clone();
+      mask = cv::Mat(frame.rows, frame.cols, CV_8U, cv::Scalar::all(255));
+      if (!extract_dir.empty()) {
+        QCHECK(cv::imwrite(JoinPath({extract_dir, "off.jpg"}), off_image));
+      }
+      continue;
+    }
+    QCHECK(!off_image.empty()) << "pixel " << push.pixel
+                               << " was lit before the lights were all off";
+
+    if (!extract_dir.empty()) {
+      const std::string path = JoinPath(
+          {extract_dir, absl::StrFormat("pixel_%03d.jpg", push.pixel)});
+      QCHECK(cv::imwrite(path, frame)) << "failed to write " << path;
+    }
+
+    std::unique_ptr<DetectResults> results = Detect(off_image, frame, mask);
+    ++num_pixels;
+    if (results->found) {
+      ++num_found;
+      InsertResult(camera_num, push.pixel, results->centroid, &coords);
+    } else {
+      InsertResult(camera_num, push.pixel, std::nullopt, &coords);
+    }
+  }
+  QCHECK(wanted.empty()) << video_path << " has fewer frames than "
+                         << "stream_frames.csv lists";
+
+  LOG(INFO) << "found " << num_found << " of " << num_pixels << " pixels";
+  QCHECK_OK(WriteTextProto(output_path, coords));
+  return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _CMD_DETECT_TEST_IMAGES_H_
+#define _CMD_DETECT_TEST_IMAGES_H_ 1
+
+#include "opencv2/opencv.hpp"
+
+// Synthetic frames for detection tests: a dim, uniform background onto which
+// lit pixels are drawn.
+
+namespace detect_testing {
+
+constexpr int kRows = 100;
+constexpr int kCols = 150;
+
+inline cv::Mat MakeImage() {
+  return cv::Mat(kRows, kCols, CV_8UC3, cv::Scalar::all(10));
+}
+
+// A mask that includes the whole image.
+inline cv::Mat AllMask() {
+  return cv::Mat(kRows, kCols, CV_8U, cv::Scalar(255));
+}
+
+// Draws a lit pixel: a colored halo around a saturated white center.
+inline void DrawPixel(cv::Mat image, cv::Point center, cv::Scalar color) {
+  cv::circle(image, center, 8, color, cv::FILLED);
+  cv::circle(image, center, 4, cv::Scalar::all(255), cv::FILLED);
+}
+
+}  // namespace detect_testing
+
+#endif  // _CMD_DETECT_TEST_IMAGES_H_
@@ -4,34 +4,68 @@
 
 #include "absl/strings/str_format.h"
 #include "lib/cv/cv.h"
+#include "lib/cv/decoded_cache.h"
 #include "lib/file/path.h"
 #include "opencv2/opencv.hpp"
 
+namespace {
+
+// The images are only displayed, so the cache holds them at this fraction of
+// their size, a quarter of the space of full-resolution copies.
+constexpr int kCachedScale = 2;
+
+absl::StatusOr<cv::Mat> Read(const std::string& path, bool decoded_cache) {
+  if (!decoded_cache) {
+    return CvReadImage(path);
+  }
+
+  absl::StatusOr<MappedImage> image =
+      ReadCachedImage(path, {.scale = kCachedScale});
+  if (!image.ok()) {
+    return image.status();
+  }
+  // Enlarged back to (about) the original size, as pixel locations are in
+  // full-resolution coordinates. This also copies the image out of the
+  // mapping, which callers outlive (as the view's background, for example).
+  cv::Mat enlarged;
+  cv::resize(image->image(), enlarged, cv::Size(), kCachedScale, kCachedScale,
+             cv::INTER_LINEAR);
+  return enlarged;
+}
+
+}  // namespace
+
 absl::StatusOr<std::unique_ptr<CameraImages>> CameraImages::Create(
-    const std::string& pixel_dir) {
-  auto off = CvReadImage(JoinPath({pixel_dir, "off.jpg"}));
+    const std::string& pixel_dir, bool decoded_cache) {
+  auto off = Read(JoinPath({pixel_dir, "off.jpg"}), decoded_cache);
   if (!off.ok()) {
     return off.status();
   }
 
-  auto on = CvReadImage(JoinPath({pixel_dir, "on.jpg"}));
+  auto on = Read(JoinPath({pixel_dir, "on.jpg"}), decoded_cache);
   if (!on.ok()) {
     return on.status();
   }
 
-  return std::unique_ptr<CameraImages>(new CameraImages(*off, *on, pixel_dir));
+  return std::unique_ptr<CameraImages>(
+      new CameraImages(*off, *on, pixel_dir, decoded_cache));
 }
 
 std::unique_ptr<CameraImages> CameraImages::CreateWithImages(
     cv::Mat off, cv::Mat on, const std::string& pixel_dir) {
-  return std::unique_ptr<CameraImages>(new CameraImages(off, on, pixel_dir));
+  return std::unique_ptr<CameraImages>(
+      new CameraImages(off, on, pixel_dir, false));
 }
 
-CameraImages::CameraImages(cv::Mat off, cv::Mat on, std::string pixel_dir)
-    : off_(off), on_(on), pixel_dir_(pixel_dir) {}
+CameraImages::CameraImages(cv::Mat off, cv::Mat on, std::string pixel_dir,
+                           bool decoded_cache)
+    : off_(off),
+      on_(on),
+      pixel_dir_(pixel_dir),
+      decoded_cache_(decoded_cache) {}
 
 absl::StatusOr<cv::Mat> CameraImages::ReadImage(int pixel_num) {
   const std::string path =
       JoinPath({pixel_dir_, absl::StrFormat("pixel_%03d.jpg", pixel_num)});
-  return CvReadImage(path);
+  return Read(path, decoded_cache_);
 }
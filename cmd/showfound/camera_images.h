@@ -11,8 +11,11 @@ class CameraImages {
  public:
   ~CameraImages() = default;
 
+  // With decoded_cache, images are read through ReadCachedImage, so that
+  // only the first run decodes them. The cache holds half-size copies, which
+  // are enlarged again when read, so images lose some detail.
   static absl::StatusOr<std::unique_ptr<CameraImages>> Create(
-      const std::string& path);
+      const std::string& path, bool decoded_cache = false);
   static std::unique_ptr<CameraImages> CreateWithImages(
       cv::Mat off, cv::Mat on, const std::string& path);
 
@@ -22,11 +25,13 @@ class CameraImages {
   absl::StatusOr<cv::Mat> ReadImage(int pixel_num);
 
  private:
-  CameraImages(cv::Mat off, cv::Mat on, std::string pixel_dir);
+  CameraImages(cv::Mat off, cv::Mat on, std::string pixel_dir,
+               bool decoded_cache);
 
   cv::Mat off_;
   cv::Mat on_;
   std::string pixel_dir_;
+  bool decoded_cache_;
 };
 
 #endif  // _CMD_SHOWFOUND_CAMERA_IMAGES_H_
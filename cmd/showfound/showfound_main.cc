@@ -44,6 +44,10 @@ ABSL_FLAG(std::string, output_xlights, "",
           "XLights model output file of pixels");
 ABSL_FLAG(std::string, output_xlights_model_name, "Model",
           "XLights model name");
+ABSL_FLAG(bool, decoded_cache, false,
+          "Keep half-size decoded copies of the camera images in a .decoded "
+          "directory beside them, so that later runs don't have to decode "
+          "them. They're shown enlarged, with less detail");
 
 namespace {
 
@@ -52,7 +56,8 @@ std::vector<std::unique_ptr<CameraImages>> MakeCameraImages(
   std::vector<std::unique_ptr<CameraImages>> out;
   std::vector<std::string> parts = absl::StrSplit(paths, ",");
   for (const std::string& path : parts) {
-    auto images = CameraImages::Create(path);
+    auto images =
+        CameraImages::Create(path, absl::GetFlag(FLAGS_decoded_cache));
     QCHECK_OK(images.status()) << path;
     out.push_back(std::move(*images));
   }
@@ -0,0 +1,26 @@
+#include "lib/base/benchmark.h"
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+absl::Duration MeanRunTime(int iterations, const std::function<void()>& fn) {
+  fn();
+
+  const absl::Time start = absl::Now();
+  for (int i = 0; i < iterations; ++i) {
+    fn();
+  }
+  return (absl::Now() - start) / iterations;
+}
+
+void ReportRunTime(const std::string& name, absl::Duration elapsed,
+                   absl::Duration baseline) {
+  std::cout << absl::StrFormat("%-24s %8.2fms %6.2fx\n", name,
+                               absl::ToDoubleMilliseconds(elapsed),
+                               absl::FDivDuration(baseline, elapsed));
+}
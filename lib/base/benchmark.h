@@ -0,0 +1,18 @@
+#ifndef _LIB_BASE_BENCHMARK_H_
+#define _LIB_BASE_BENCHMARK_H_ 1
+
+#include <functional>
+#include <string>
+
+#include "absl/time/time.h"
+
+// Returns the mean time taken by fn over `iterations` runs, after one warmup
+// run.
+absl::Duration MeanRunTime(int iterations, const std::function<void()>& fn);
+
+// Prints a line giving `elapsed` and its speedup over `baseline`, in columns
+// that line up across calls.
+void ReportRunTime(const std::string& name, absl::Duration elapsed,
+                   absl::Duration baseline);
+
+#endif  // _LIB_BASE_BENCHMARK_H_
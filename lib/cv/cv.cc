@@ -1,5 +1,9 @@
 #include "lib/cv/cv.h"
 
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <fstream>
 #include <string>
 
 #include "absl/status/status.h"
@@ -8,6 +12,95 @@
 #include "opencv2/highgui.hpp"
 #include "opencv2/opencv.hpp"
 
+// jpeglib.h needs size_t and FILE declared first.
+#include "jpeglib.h"
+
+namespace {
+
+struct JpegErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+  char message[JMSG_LENGTH_MAX];
+};
+
+// Replaces libjpeg's default error handler, which exits the process.
+void JpegErrorExit(j_common_ptr cinfo) {
+  auto* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+  (*cinfo->err->format_message)(cinfo, err->message);
+  longjmp(err->jump, 1);
+}
+
+bool IsJpeg(const std::string& data) {
+  return data.size() >= 2 && static_cast<unsigned char>(data[0]) == 0xff &&
+         static_cast<unsigned char>(data[1]) == 0xd8;
+}
+
+// libjpeg's fancy upsampling interpolates each pixel's chroma from its
+// neighbors', and replicates the edge pixels of a cropped decode instead. The
+// rectangle is decoded with this many more pixels on every side, so the
+// pixels within it match a full decode exactly.
+constexpr int kJpegRegionMargin = 1;
+
+// Decodes the rows of `rect`, and those within the margin around it, from the
+// JPEG in `data` into `out`, which is also wider than `rect` if it doesn't
+// start and end on iMCU boundaries. Sets `origin` to the location in `out`
+// of the rectangle's top-left corner.
+//
+// libjpeg reports errors by longjmp, so nothing with a destructor may be
+// live in this function when it calls into the library.
+absl::Status DecodeJpegRegion(const std::string& data, const cv::Rect& rect,
+                              cv::Mat* out, cv::Point* origin) {
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager err;
+  cinfo.err = jpeg_std_error(&err.pub);
+  err.pub.error_exit = JpegErrorExit;
+  if (setjmp(err.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return absl::InternalError(err.message);
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, reinterpret_cast<const unsigned char*>(data.data()),
+               data.size());
+  jpeg_read_header(&cinfo, TRUE);
+
+  const int width = cinfo.image_width, height = cinfo.image_height;
+  if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 ||
+      rect.x + rect.width > width || rect.y + rect.height > height) {
+    jpeg_destroy_decompress(&cinfo);
+    return absl::InvalidArgumentError(
+        absl::StrFormat("region %dx%d+%d+%d is outside the %dx%d image",
+                        rect.width, rect.height, rect.x, rect.y, width,
+                        height));
+  }
+
+  const int top = std::max(0, rect.y - kJpegRegionMargin);
+  const int bottom = std::min(height, rect.br().y + kJpegRegionMargin);
+  const int left = std::max(0, rect.x - kJpegRegionMargin);
+  const int right = std::min(width, rect.br().x + kJpegRegionMargin);
+
+  cinfo.out_color_space = JCS_EXT_BGR;
+  jpeg_start_decompress(&cinfo);
+
+  JDIMENSION crop_x = left, crop_width = right - left;
+  jpeg_crop_scanline(&cinfo, &crop_x, &crop_width);
+  jpeg_skip_scanlines(&cinfo, top);
+
+  out->create(bottom - top, crop_width, CV_8UC3);
+  while (cinfo.output_scanline < static_cast<JDIMENSION>(bottom)) {
+    JSAMPROW row = out->ptr<JSAMPLE>(cinfo.output_scanline - top);
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  *origin = cv::Point(rect.x - crop_x, rect.y - top);
+
+  // The rows below the region are never decoded, so the decompression is
+  // abandoned rather than finished.
+  jpeg_destroy_decompress(&cinfo);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
 absl::StatusOr<cv::Mat> CvReadImage(const std::string& path) {
   cv::Mat img = cv::imread(path);
   if (img.empty()) {
@@ -17,6 +110,47 @@ absl::StatusOr<cv::Mat> CvReadImage(const std::string& path) {
   return img;
 }
 
+absl::StatusOr<cv::Mat> CvReadImageRegion(const std::string& path,
+                                          const cv::Rect& rect) {
+  // Read straight into a buffer of the file's size, rather than through a
+  // stream that grows as it goes and is then copied out.
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  std::string data;
+  if (in) {
+    data.resize(in.tellg());
+    in.seekg(0);
+    in.read(data.data(), data.size());
+  }
+  if (!in) {
+    return absl::InternalError(
+        absl::StrFormat("failed to read image from %s", path));
+  }
+
+  if (!IsJpeg(data)) {
+    absl::StatusOr<cv::Mat> img = CvReadImage(path);
+    if (!img.ok()) {
+      return img.status();
+    }
+    if ((rect & cv::Rect(0, 0, img->cols, img->rows)) != rect) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "region %dx%d+%d+%d is outside the %dx%d image in %s", rect.width,
+          rect.height, rect.x, rect.y, img->cols, img->rows, path));
+    }
+    return (*img)(rect).clone();
+  }
+
+  cv::Mat decoded;
+  cv::Point origin;
+  if (absl::Status status = DecodeJpegRegion(data, rect, &decoded, &origin);
+      !status.ok()) {
+    return absl::Status(
+        status.code(),
+        absl::StrFormat("failed to read image from %s: %s", path,
+                        status.message()));
+  }
+  return decoded(cv::Rect(origin, rect.size())).clone();
+}
+
 unsigned long CvColorToRgbBytes(cv::viz::Color color) {
   return ((static_cast<int>(color[2]) & 0xff) << 16) |
          ((static_cast<int>(color[1]) & 0xff) << 8) |
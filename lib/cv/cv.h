@@ -5,10 +5,21 @@
 
 #include "absl/status/statusor.h"
 #include "opencv2/core/mat.hpp"
+#include "opencv2/core/types.hpp"
 #include "opencv2/viz/types.hpp"
 
 absl::StatusOr<cv::Mat> CvReadImage(const std::string& path);
 
+// Reads only `rect` of the image at `path`, as CvReadImage followed by a crop
+// would. JPEGs are partially decoded: rows above the rectangle are skipped,
+// columns are cropped to the enclosing iMCU boundaries, and decoding stops
+// after the rectangle's last row. Other formats are read in full and cropped.
+// Unlike CvReadImage, the EXIF orientation of a JPEG is ignored, so `rect` is
+// in stored coordinates. Returns an error if `rect` doesn't lie entirely
+// within the image.
+absl::StatusOr<cv::Mat> CvReadImageRegion(const std::string& path,
+                                          const cv::Rect& rect);
+
 unsigned long CvColorToRgbBytes(cv::viz::Color color);
 
 #endif  // _LIB_CV_CV_H_
@@ -1,16 +1,61 @@
 #include "lib/cv/cv.h"
 
+#include <string>
+#include <vector>
+
 #include "absl/strings/str_format.h"
 #include "gtest/gtest.h"
 #include "lib/file/path.h"
+#include "opencv2/opencv.hpp"
 #include "opencv2/viz/types.hpp"
 
 namespace {
 
+// Returns an image with detail in every channel, so that a misplaced or
+// misdecoded region doesn't match by accident.
+cv::Mat MakeTestImage() {
+  cv::Mat img(300, 400, CV_8UC3);
+  cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(256));
+  cv::GaussianBlur(img, img, cv::Size(5, 5), 0);
+  return img;
+}
+
 TEST(CvTest, CvReadImage) {
   EXPECT_FALSE(CvReadImage(JoinPath({testing::TempDir(), "nonexistent"})).ok());
 }
 
+TEST(CvTest, CvReadImageRegion) {
+  for (const std::string ext : {".jpg", ".png"}) {
+    const std::string path =
+        JoinPath({testing::TempDir(), "region" + ext});
+    ASSERT_TRUE(cv::imwrite(path, MakeTestImage()));
+    absl::StatusOr<cv::Mat> full = CvReadImage(path);
+    ASSERT_TRUE(full.ok()) << full.status();
+
+    const std::vector<cv::Rect> rects = {
+        {0, 0, 400, 300},  {0, 0, 1, 1},      {399, 299, 1, 1},
+        {123, 45, 67, 89}, {16, 16, 32, 32}, {350, 7, 50, 293},
+    };
+    for (const cv::Rect& rect : rects) {
+      absl::StatusOr<cv::Mat> region = CvReadImageRegion(path, rect);
+      ASSERT_TRUE(region.ok()) << ext << " " << rect << ": "
+                               << region.status();
+      ASSERT_EQ(region->size(), rect.size()) << ext << " " << rect;
+      EXPECT_EQ(cv::norm(*region, (*full)(rect), cv::NORM_INF), 0)
+          << ext << " " << rect;
+    }
+
+    EXPECT_FALSE(CvReadImageRegion(path, {390, 0, 20, 20}).ok()) << ext;
+    EXPECT_FALSE(CvReadImageRegion(path, {-1, 0, 20, 20}).ok()) << ext;
+    EXPECT_FALSE(CvReadImageRegion(path, {0, 0, 0, 20}).ok()) << ext;
+  }
+
+  EXPECT_FALSE(
+      CvReadImageRegion(JoinPath({testing::TempDir(), "nonexistent"}),
+                        {0, 0, 1, 1})
+          .ok());
+}
+
 TEST(CvColorToRgbBytes, Test) {
   const std::vector<std::tuple<cv::viz::Color, unsigned long>> test_cases = {
       {cv::viz::Color::white(), 0xffffff},
@@ -0,0 +1,258 @@
+#include "lib/cv/decoded_cache.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+namespace {
+
+constexpr char kMagic[4] = {'X', 'L', 'D', 'C'};
+constexpr uint32_t kVersion = 1;
+
+// Precedes the pixels in a cache file. Cache files are only meant to be read
+// on the machine that wrote them, so it's in native byte order.
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime;
+  int32_t rows;
+  int32_t cols;
+  int32_t type;
+  int32_t reserved;
+};
+
+// Where the pixels start, aligned for vector loads.
+constexpr size_t kDataOffset = 64;
+static_assert(sizeof(CacheHeader) <= kDataOffset);
+
+// Identifies a version of a source image.
+struct SourceStamp {
+  uint64_t size;
+  int64_t mtime;
+};
+
+absl::StatusOr<SourceStamp> StampSource(const std::string& path) {
+  std::error_code ec;
+  const uintmax_t size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return absl::NotFoundError(
+        absl::StrFormat("failed to read image from %s: %s", path,
+                        ec.message()));
+  }
+  const auto mtime = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrFormat(
+        "failed to get modification time of %s: %s", path, ec.message()));
+  }
+  return SourceStamp{
+      .size = size,
+      .mtime = static_cast<int64_t>(mtime.time_since_epoch().count()),
+  };
+}
+
+std::filesystem::path CachePath(const std::string& path,
+                                const DecodeOptions& options) {
+  const std::filesystem::path source(path);
+  return source.parent_path() / ".decoded" /
+         absl::StrFormat("%s.%s%d.raw", source.filename().string(),
+                         options.gray ? "gray" : "bgr", options.scale);
+}
+
+absl::StatusOr<cv::Mat> Decode(const std::string& path,
+                               const DecodeOptions& options) {
+  int mode;
+  switch (options.scale) {
+    case 1:
+      mode = cv::IMREAD_COLOR;
+      break;
+    case 2:
+      mode = cv::IMREAD_REDUCED_COLOR_2;
+      break;
+    case 4:
+      mode = cv::IMREAD_REDUCED_COLOR_4;
+      break;
+    case 8:
+      mode = cv::IMREAD_REDUCED_COLOR_8;
+      break;
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrFormat("unsupported scale %d", options.scale));
+  }
+
+  cv::Mat image = cv::imread(path, mode);
+  if (image.empty()) {
+    return absl::InternalError(
+        absl::StrFormat("failed to read image from %s", path));
+  }
+  if (options.gray) {
+    cv::Mat gray;
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    image = gray;
+  }
+  return image;
+}
+
+// Writes `image` to a cache file at `path`. The file is written under a
+// temporary name and then renamed, so that readers never see part of one.
+absl::Status WriteCacheFile(const std::filesystem::path& path,
+                            const SourceStamp& stamp, cv::Mat image) {
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  if (ec) {
+    return absl::UnknownError(absl::StrFormat(
+        "failed to make %s: %s", path.parent_path().string(), ec.message()));
+  }
+
+  std::string tmp_path = path.string() + ".XXXXXX";
+  const int fd = mkstemp(tmp_path.data());
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno,
+                               absl::StrCat("failed to create ", tmp_path));
+  }
+
+  CacheHeader header = {
+      .version = kVersion,
+      .source_size = stamp.size,
+      .source_mtime = stamp.mtime,
+      .rows = image.rows,
+      .cols = image.cols,
+      .type = image.type(),
+  };
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  char prefix[kDataOffset] = {};
+  memcpy(prefix, &header, sizeof(header));
+
+  if (!image.isContinuous()) {
+    image = image.clone();
+  }
+  const size_t data_size = image.total() * image.elemSize();
+
+  bool ok = write(fd, prefix, sizeof(prefix)) ==
+            static_cast<ssize_t>(sizeof(prefix));
+  for (size_t done = 0; ok && done < data_size;) {
+    const ssize_t n = write(fd, image.data + done, data_size - done);
+    ok = n > 0;
+    done += ok ? n : 0;
+  }
+  const int write_errno = errno;
+  close(fd);
+
+  if (!ok) {
+    unlink(tmp_path.c_str());
+    return absl::ErrnoToStatus(write_errno,
+                               absl::StrCat("failed to write ", tmp_path));
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) < 0) {
+    const int rename_errno = errno;
+    unlink(tmp_path.c_str());
+    return absl::ErrnoToStatus(rename_errno,
+                               absl::StrCat("failed to rename ", tmp_path));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+MappedImage::MappedImage(cv::Mat image)
+    : addr_(nullptr), length_(0), image_(image) {}
+
+MappedImage::MappedImage(void* addr, size_t length, cv::Mat image)
+    : addr_(addr), length_(length), image_(image) {}
+
+MappedImage::MappedImage(MappedImage&& other)
+    : addr_(other.addr_), length_(other.length_), image_(other.image_) {
+  other.addr_ = nullptr;
+  other.image_ = cv::Mat();
+}
+
+MappedImage& MappedImage::operator=(MappedImage&& other) {
+  if (this != &other) {
+    if (addr_ != nullptr) {
+      munmap(addr_, length_);
+    }
+    addr_ = other.addr_;
+    length_ = other.length_;
+    image_ = other.image_;
+    other.addr_ = nullptr;
+    other.image_ = cv::Mat();
+  }
+  return *this;
+}
+
+MappedImage::~MappedImage() {
+  if (addr_ != nullptr) {
+    munmap(addr_, length_);
+  }
+}
+
+absl::StatusOr<MappedImage> ReadCachedImage(const std::string& path,
+                                            const DecodeOptions& options) {
+  absl::StatusOr<SourceStamp> stamp = StampSource(path);
+  if (!stamp.ok()) {
+    return stamp.status();
+  }
+  const std::filesystem::path cache_path = CachePath(path, options);
+
+  // Anything wrong with the cache file (it's missing, stale, or truncated)
+  // just means the image has to be decoded.
+  if (const int fd = open(cache_path.c_str(), O_RDONLY); fd >= 0) {
+    struct stat st;
+    void* addr = MAP_FAILED;
+    size_t length = 0;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(kDataOffset)) {
+      length = st.st_size;
+      // Private and writable, so callers can modify the image without
+      // changing the file.
+      addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (addr != MAP_FAILED) {
+      CacheHeader header;
+      memcpy(&header, addr, sizeof(header));
+      const bool current =
+          memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+          header.version == kVersion && header.source_size == stamp->size &&
+          header.source_mtime == stamp->mtime && header.rows > 0 &&
+          header.cols > 0 &&
+          kDataOffset + static_cast<uint64_t>(header.rows) * header.cols *
+                            CV_ELEM_SIZE(header.type) ==
+              length;
+      if (current) {
+        return MappedImage(addr, length,
+                           cv::Mat(header.rows, header.cols, header.type,
+                                   static_cast<char*>(addr) + kDataOffset));
+      }
+      munmap(addr, length);
+    }
+  }
+
+  absl::StatusOr<cv::Mat> image = Decode(path, options);
+  if (!image.ok()) {
+    return image.status();
+  }
+  if (absl::Status status = WriteCacheFile(cache_path, *stamp, *image);
+      !status.ok()) {
+    LOG(WARNING) << "not caching " << path << ": " << status;
+  }
+  return MappedImage(*image);
+}
@@ -0,0 +1,51 @@
+#ifndef _LIB_CV_DECODED_CACHE_H_
+#define _LIB_CV_DECODED_CACHE_H_ 1
+
+#include <cstddef>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "opencv2/core/mat.hpp"
+
+// How an image is to be decoded.
+struct DecodeOptions {
+  // Convert to gray with cv::COLOR_BGR2GRAY, as Detect does.
+  bool gray = false;
+
+  // Decode reduced by this factor (1, 2, 4 or 8), as the
+  // cv::IMREAD_REDUCED_* modes do.
+  int scale = 1;
+};
+
+// A decoded image that may be mapped from a cache file. The image is only
+// valid while the MappedImage exists. It may be modified, but changes aren't
+// written back.
+class MappedImage {
+ public:
+  explicit MappedImage(cv::Mat image);
+  MappedImage(MappedImage&& other);
+  MappedImage& operator=(MappedImage&& other);
+  ~MappedImage();
+
+  cv::Mat image() const { return image_; }
+
+ private:
+  friend absl::StatusOr<MappedImage> ReadCachedImage(
+      const std::string& path, const DecodeOptions& options);
+
+  MappedImage(void* addr, size_t length, cv::Mat image);
+
+  void* addr_;
+  size_t length_;
+  cv::Mat image_;
+};
+
+// Returns the image at `path`, decoded as requested. Decoded images are
+// cached in a .decoded directory beside the image, as raw pixels which later
+// calls map into memory instead of decoding. A cache file is used only if
+// the image's size and modification time haven't changed since it was
+// written. If the cache can't be written, the image is decoded each time.
+absl::StatusOr<MappedImage> ReadCachedImage(const std::string& path,
+                                            const DecodeOptions& options);
+
+#endif  // _LIB_CV_DECODED_CACHE_H_
@@ -0,0 +1,90 @@
+#include "lib/cv/decoded_cache.h"
+
+#include <filesystem>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+#include "lib/testing/file.h"
+#include "opencv2/opencv.hpp"
+
+namespace {
+
+cv::Mat MakeImage(int value) {
+  cv::Mat image(64, 96, CV_8UC3, cv::Scalar(value, value / 2, 255 - value));
+  cv::circle(image, {30, 20}, 8, cv::Scalar::all(255), cv::FILLED);
+  return image;
+}
+
+bool Equal(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+TEST(ReadCachedImageTest, Color) {
+  const std::string path = JoinPath({MakeTestDir("decoded_color"), "a.jpg"});
+  ASSERT_TRUE(cv::imwrite(path, MakeImage(10)));
+  const cv::Mat want = cv::imread(path);
+
+  auto first = ReadCachedImage(path, {});
+  ASSERT_TRUE(first.ok()) << first.status();
+  EXPECT_TRUE(Equal(first->image(), want));
+  EXPECT_TRUE(std::filesystem::exists(
+      JoinPath({testing::TempDir(), "decoded_color/.decoded/a.jpg.bgr1.raw"})));
+
+  // From the cache file this time. Changes to the image don't reach it.
+  auto second = ReadCachedImage(path, {});
+  ASSERT_TRUE(second.ok()) << second.status();
+  EXPECT_TRUE(Equal(second->image(), want));
+  second->image().setTo(cv::Scalar::all(0));
+
+  auto third = ReadCachedImage(path, {});
+  ASSERT_TRUE(third.ok()) << third.status();
+  EXPECT_TRUE(Equal(third->image(), want));
+}
+
+TEST(ReadCachedImageTest, Forms) {
+  const std::string path = JoinPath({MakeTestDir("decoded_forms"), "a.png"});
+  ASSERT_TRUE(cv::imwrite(path, MakeImage(10)));
+
+  cv::Mat gray;
+  cv::cvtColor(cv::imread(path), gray, cv::COLOR_BGR2GRAY);
+  const cv::Mat reduced = cv::imread(path, cv::IMREAD_REDUCED_COLOR_4);
+
+  for (int i = 0; i < 2; ++i) {
+    SCOPED_TRACE(i);  // decoded, then cached
+
+    auto got = ReadCachedImage(path, {.gray = true});
+    ASSERT_TRUE(got.ok()) << got.status();
+    EXPECT_TRUE(Equal(got->image(), gray));
+
+    got = ReadCachedImage(path, {.scale = 4});
+    ASSERT_TRUE(got.ok()) << got.status();
+    EXPECT_TRUE(Equal(got->image(), reduced));
+  }
+
+  EXPECT_FALSE(ReadCachedImage(path, {.scale = 3}).ok());
+}
+
+TEST(ReadCachedImageTest, Invalidation) {
+  const std::string path = JoinPath({MakeTestDir("decoded_stale"), "a.png"});
+  ASSERT_TRUE(cv::imwrite(path, MakeImage(10)));
+  ASSERT_TRUE(ReadCachedImage(path, {}).ok());
+
+  // Replaced with an image of a different size.
+  cv::Mat bigger;
+  cv::resize(MakeImage(200), bigger, cv::Size(192, 128));
+  ASSERT_TRUE(cv::imwrite(path, bigger));
+
+  auto got = ReadCachedImage(path, {});
+  ASSERT_TRUE(got.ok()) << got.status();
+  EXPECT_TRUE(Equal(got->image(), cv::imread(path)));
+}
+
+TEST(ReadCachedImageTest, Missing) {
+  EXPECT_FALSE(
+      ReadCachedImage(JoinPath({testing::TempDir(), "nonexistent.jpg"}), {})
+          .ok());
+}
+
+}  // namespace
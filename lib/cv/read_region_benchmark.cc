@@ -0,0 +1,97 @@
+// Times CvReadImageRegion against a full cv::imread and crop, for windows at
+// the top, middle and bottom of a captured or synthetic JPEG.
+
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/log/check.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "lib/base/benchmark.h"
+#include "lib/cv/cv.h"
+#include "lib/file/path.h"
+#include "opencv2/opencv.hpp"
+
+ABSL_FLAG(std::string, image, "", "JPEG to read; synthetic if unset");
+ABSL_FLAG(int, width, 4000, "Width of the synthetic image");
+ABSL_FLAG(int, height, 3000, "Height of the synthetic image");
+ABSL_FLAG(int, size, 200, "Width and height of the window to read");
+ABSL_FLAG(int, iterations, 20, "Number of times to run each read");
+
+namespace {
+
+// Returns the mean time taken by fn over --iterations runs.
+absl::Duration Time(const std::function<void()>& fn) {
+  return MeanRunTime(absl::GetFlag(FLAGS_iterations), fn);
+}
+
+// Writes a noisy synthetic JPEG, which compresses (and so decodes) about as
+// slowly as a photo, and returns its path.
+std::string WriteSyntheticImage() {
+  cv::Mat img(absl::GetFlag(FLAGS_height), absl::GetFlag(FLAGS_width),
+              CV_8UC3);
+  cv::RNG(1).fill(img, cv::RNG::UNIFORM, 0, 256);
+  cv::GaussianBlur(img, img, cv::Size(3, 3), 0);
+
+  const std::string path =
+      JoinPath({std::filesystem::temp_directory_path().string(),
+                "read_region_benchmark.jpg"});
+  QCHECK(cv::imwrite(path, img)) << "failed to write " << path;
+  return path;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage("benchmarks partial image reads");
+  absl::ParseCommandLine(argc, argv);
+
+  const std::string path = absl::GetFlag(FLAGS_image).empty()
+                               ? WriteSyntheticImage()
+                               : absl::GetFlag(FLAGS_image);
+  absl::StatusOr<cv::Mat> full = CvReadImage(path);
+  QCHECK_OK(full.status());
+
+  const int size = absl::GetFlag(FLAGS_size);
+  QCHECK(size > 0 && size <= full->cols && size <= full->rows)
+      << "--size must fit within the " << full->cols << "x" << full->rows
+      << " image";
+
+  std::cout << absl::StrFormat("%dx%d, %dx%d window, %d iterations\n",
+                               full->cols, full->rows, size, size,
+                               absl::GetFlag(FLAGS_iterations));
+
+  const absl::Duration baseline = Time([&] {
+    cv::Mat img = cv::imread(path);
+    QCHECK(!img.empty());
+    img(cv::Rect(0, 0, size, size)).clone();
+  });
+  ReportRunTime("imread and crop", baseline, baseline);
+
+  const int x = (full->cols - size) / 2;
+  const std::vector<std::pair<std::string, cv::Rect>> windows = {
+      {"region (top)", {x, 0, size, size}},
+      {"region (middle)", {x, (full->rows - size) / 2, size, size}},
+      {"region (bottom)", {x, full->rows - size, size, size}},
+  };
+  for (const auto& [name, rect] : windows) {
+    absl::StatusOr<cv::Mat> region = CvReadImageRegion(path, rect);
+    QCHECK_OK(region.status());
+    QCHECK_EQ(cv::norm(*region, (*full)(rect), cv::NORM_INF), 0)
+        << name << " doesn't match the full image";
+
+    ReportRunTime(
+        name, Time([&] { QCHECK_OK(CvReadImageRegion(path, rect)); }),
+        baseline);
+  }
+
+  return 0;
+}
@@ -1,7 +1,12 @@
 #include "lib/file/file.h"
 
+#include <fcntl.h>
 #include <sys/errno.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <filesystem>
 
 #include "absl/strings/str_format.h"
 
@@ -18,3 +23,50 @@ absl::StatusOr<bool> Exists(const std::string& path) {
 
   return true;
 }
+
+absl::Status WriteFileAtomically(const std::string& path,
+                                 absl::string_view contents) {
+  // Unique within the directory, even with several threads writing the same
+  // path. Opened with O_EXCL rather than mkstemp so that the file gets the
+  // usual permissions.
+  static std::atomic<int> counter = 0;
+  const std::filesystem::path final_path(path);
+  const std::string tmp_path =
+      (final_path.parent_path() /
+       absl::StrFormat(".%s.tmp%d.%d", final_path.filename().string(),
+                       getpid(), counter++))
+          .string();
+
+  const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(
+        errno, absl::StrFormat("failed to create %s", tmp_path));
+  }
+
+  bool ok = true;
+  for (size_t done = 0; ok && done < contents.size();) {
+    const ssize_t n =
+        write(fd, contents.data() + done, contents.size() - done);
+    ok = n > 0;
+    done += ok ? n : 0;
+  }
+  int write_errno = errno;
+  if (close(fd) < 0 && ok) {
+    ok = false;
+    write_errno = errno;
+  }
+
+  if (!ok) {
+    unlink(tmp_path.c_str());
+    return absl::ErrnoToStatus(write_errno,
+                               absl::StrFormat("failed to write %s", tmp_path));
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) < 0) {
+    const int rename_errno = errno;
+    unlink(tmp_path.c_str());
+    return absl::ErrnoToStatus(
+        rename_errno, absl::StrFormat("failed to rename %s to %s", tmp_path,
+                                      path));
+  }
+  return absl::OkStatus();
+}
@@ -3,8 +3,17 @@
 
 #include <string>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 
 absl::StatusOr<bool> Exists(const std::string& path);
 
+// Writes `contents` to `path`, replacing any existing file. The contents go
+// to a hidden temporary file in the same directory, which is then renamed
+// into place, so if the write is interrupted, `path` is either unchanged
+// or complete, never truncated.
+absl::Status WriteFileAtomically(const std::string& path,
+                                 absl::string_view contents);
+
 #endif  // _LIB_FILE_FILE_H_
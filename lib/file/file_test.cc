@@ -0,0 +1,43 @@
+#include "lib/file/file.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+
+namespace {
+
+std::string ReadAll(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+TEST(WriteFileAtomicallyTest, Test) {
+  const std::string dir = JoinPath({testing::TempDir(), "write_atomically"});
+  std::filesystem::remove_all(dir);
+  ASSERT_TRUE(std::filesystem::create_directory(dir));
+  const std::string path = JoinPath({dir, "a.jpg"});
+
+  ASSERT_TRUE(WriteFileAtomically(path, std::string("a\0b", 3)).ok());
+  EXPECT_EQ(ReadAll(path), std::string("a\0b", 3));
+
+  // Replaces the old contents, and leaves no temporary files behind.
+  ASSERT_TRUE(WriteFileAtomically(path, "cd").ok());
+  EXPECT_EQ(ReadAll(path), "cd");
+  int num_files = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    EXPECT_EQ(entry.path().filename(), "a.jpg");
+    ++num_files;
+  }
+  EXPECT_EQ(num_files, 1);
+
+  EXPECT_FALSE(
+      WriteFileAtomically(JoinPath({dir, "missing", "a.jpg"}), "x").ok());
+}
+
+}  // namespace
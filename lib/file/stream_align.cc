@@ -0,0 +1,110 @@
+#include "lib/file/stream_align.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "lib/file/readers.h"
+
+namespace {
+
+// Reads a file of "<int>,<unix micros>" lines, calling `add` with each.
+absl::Status ReadTimedInts(const std::string& path,
+                           const std::function<void(int, absl::Time)>& add) {
+  return ReadFields(
+      path, ",", 2,
+      [&](int lineno, absl::Span<const std::string> fields) {
+        int num;
+        int64_t micros;
+        if (!absl::SimpleAtoi(fields[0], &num) ||
+            !absl::SimpleAtoi(fields[1], &micros)) {
+          return MakeParseError(path, lineno, "bad number");
+        }
+        add(num, absl::FromUnixMicros(micros));
+        return absl::OkStatus();
+      });
+}
+
+}  // namespace
+
+std::string FormatStreamPush(const StreamPush& push) {
+  return absl::StrFormat("%d,%d", push.pixel, absl::ToUnixMicros(push.time));
+}
+
+std::string FormatStreamFrameTime(const StreamFrameTime& frame) {
+  return absl::StrFormat("%d,%d", frame.index,
+                         absl::ToUnixMicros(frame.time));
+}
+
+absl::StatusOr<std::vector<StreamPush>> ReadStreamPushes(
+    const std::string& path) {
+  std::vector<StreamPush> pushes;
+  if (absl::Status status = ReadTimedInts(
+          path,
+          [&](int pixel, absl::Time time) {
+            pushes.push_back({.pixel = pixel, .time = time});
+          });
+      !status.ok()) {
+    return status;
+  }
+  return pushes;
+}
+
+absl::StatusOr<std::vector<StreamFrameTime>> ReadStreamFrameTimes(
+    const std::string& path) {
+  std::vector<StreamFrameTime> frames;
+  if (absl::Status status = ReadTimedInts(
+          path,
+          [&](int index, absl::Time time) {
+            frames.push_back({.index = index, .time = time});
+          });
+      !status.ok()) {
+    return status;
+  }
+  return frames;
+}
+
+std::vector<SteadyFrames> AlignStream(
+    const std::vector<StreamPush>& pushes,
+    const std::vector<StreamFrameTime>& frames,
+    const StreamAlignOptions& options) {
+  // Recordings' frame times should already be in order, but the search
+  // below depends on it.
+  std::vector<StreamFrameTime> sorted = frames;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const StreamFrameTime& a, const StreamFrameTime& b) {
+                     return a.time < b.time;
+                   });
+  auto first_at_or_after = [&](absl::Time time) {
+    return std::lower_bound(
+        sorted.begin(), sorted.end(), time,
+        [](const StreamFrameTime& frame, absl::Time t) {
+          return frame.time < t;
+        });
+  };
+
+  std::vector<SteadyFrames> out;
+  for (int i = 0; i < static_cast<int>(pushes.size()); ++i) {
+    const absl::Time start = pushes[i].time + options.latency + options.margin;
+    const absl::Time end =
+        i + 1 < static_cast<int>(pushes.size())
+            ? pushes[i + 1].time + options.latency - options.margin
+            : absl::InfiniteFuture();
+
+    SteadyFrames steady = {.push = pushes[i]};
+    for (auto iter = first_at_or_after(start);
+         iter != sorted.end() && iter->time < end; ++iter) {
+      steady.frames.push_back(iter->index);
+    }
+    out.push_back(std::move(steady));
+  }
+  return out;
+}
@@ -0,0 +1,65 @@
+#ifndef _LIB_FILE_STREAM_ALIGN_H_
+#define _LIB_FILE_STREAM_ALIGN_H_ 1
+
+// Aligns a continuously-recorded video with the pushes that stepped through
+// the pixels while it was being recorded (automap --capture_mode=stream), so
+// that the frames showing each pixel can be picked out afterwards.
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+
+// The pixel number of a push that turned every pixel off.
+constexpr int kStreamAllOff = -1;
+
+// A push that lit only `pixel` (or none, for kStreamAllOff), made at `time`.
+struct StreamPush {
+  int pixel;
+  absl::Time time;
+};
+
+// The time at which the frame numbered `index` (counting from 0) in a
+// recording was captured.
+struct StreamFrameTime {
+  int index;
+  absl::Time time;
+};
+
+// Pushes and frame times are stored one per line as "<pixel or index>,<time>"
+// where time is in microseconds since the Unix epoch.
+std::string FormatStreamPush(const StreamPush& push);
+std::string FormatStreamFrameTime(const StreamFrameTime& frame);
+absl::StatusOr<std::vector<StreamPush>> ReadStreamPushes(
+    const std::string& path);
+absl::StatusOr<std::vector<StreamFrameTime>> ReadStreamFrameTimes(
+    const std::string& path);
+
+struct StreamAlignOptions {
+  // Time from a push until the frames captured show it, covering the
+  // controller, the camera's exposure and the camera's pipeline.
+  absl::Duration latency = absl::Milliseconds(100);
+
+  // Frames within this long of either end of a push's window are skipped,
+  // allowing for jitter in the latency.
+  absl::Duration margin = absl::Milliseconds(10);
+};
+
+// The frames showing a push's lights and nothing else.
+struct SteadyFrames {
+  StreamPush push;
+  std::vector<int> frames;  // indexes, in capture order
+};
+
+// Returns the steady frames for each push, in push order. A push's frames
+// are those captured from its time plus latency to the next push's time plus
+// latency, less the margin at each end. The last push's frames run to the
+// end of the recording. Pushes too close together to have steady frames get
+// none.
+std::vector<SteadyFrames> AlignStream(
+    const std::vector<StreamPush>& pushes,
+    const std::vector<StreamFrameTime>& frames,
+    const StreamAlignOptions& options);
+
+#endif  // _LIB_FILE_STREAM_ALIGN_H_
@@ -0,0 +1,87 @@
+#include "lib/file/stream_align.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+#include "lib/file/writers.h"
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+absl::Time Ms(int ms) { return absl::FromUnixMillis(1'700'000'000'000 + ms); }
+
+// Frames every 30ms from 0 to 990ms.
+std::vector<StreamFrameTime> Frames() {
+  std::vector<StreamFrameTime> frames;
+  for (int i = 0; i < 34; ++i) {
+    frames.push_back({.index = i, .time = Ms(i * 30)});
+  }
+  return frames;
+}
+
+TEST(StreamAlignTest, ReadWrite) {
+  const std::string pushes_path =
+      JoinPath({testing::TempDir(), "stream_pushes.csv"});
+  ASSERT_TRUE(WriteFile(pushes_path,
+                        {FormatStreamPush({kStreamAllOff, Ms(0)}),
+                         FormatStreamPush({7, Ms(100)})})
+                  .ok());
+  auto pushes = ReadStreamPushes(pushes_path);
+  ASSERT_TRUE(pushes.ok()) << pushes.status();
+  ASSERT_EQ(pushes->size(), 2);
+  EXPECT_EQ((*pushes)[0].pixel, kStreamAllOff);
+  EXPECT_EQ((*pushes)[0].time, Ms(0));
+  EXPECT_EQ((*pushes)[1].pixel, 7);
+  EXPECT_EQ((*pushes)[1].time, Ms(100));
+
+  const std::string frames_path =
+      JoinPath({testing::TempDir(), "stream_frames.csv"});
+  ASSERT_TRUE(WriteFile(frames_path, {FormatStreamFrameTime({3, Ms(33)})})
+                  .ok());
+  auto frames = ReadStreamFrameTimes(frames_path);
+  ASSERT_TRUE(frames.ok()) << frames.status();
+  ASSERT_EQ(frames->size(), 1);
+  EXPECT_EQ((*frames)[0].index, 3);
+  EXPECT_EQ((*frames)[0].time, Ms(33));
+
+  ASSERT_TRUE(WriteFile(frames_path, {"3,x"}).ok());
+  EXPECT_FALSE(ReadStreamFrameTimes(frames_path).ok());
+}
+
+TEST(StreamAlignTest, Align) {
+  const std::vector<StreamPush> pushes = {
+      {kStreamAllOff, Ms(0)},
+      {1, Ms(300)},
+      {2, Ms(400)},
+      {3, Ms(420)},  // too soon after pixel 2 to show on its own
+      {kStreamAllOff, Ms(700)},
+  };
+
+  const std::vector<SteadyFrames> steady = AlignStream(
+      pushes, Frames(),
+      {.latency = absl::Milliseconds(50), .margin = absl::Milliseconds(10)});
+  ASSERT_EQ(steady.size(), 5);
+
+  // [60ms, 340ms)
+  EXPECT_EQ(steady[0].push.pixel, kStreamAllOff);
+  EXPECT_THAT(steady[0].frames, ElementsAre(2, 3, 4, 5, 6, 7, 8, 9, 10, 11));
+  // [360ms, 440ms)
+  EXPECT_EQ(steady[1].push.pixel, 1);
+  EXPECT_THAT(steady[1].frames, ElementsAre(12, 13, 14));
+  // [460ms, 460ms)
+  EXPECT_THAT(steady[2].frames, IsEmpty());
+  // [480ms, 740ms)
+  EXPECT_EQ(steady[3].push.pixel, 3);
+  EXPECT_THAT(steady[3].frames, ElementsAre(16, 17, 18, 19, 20, 21, 22, 23,
+                                            24));
+  // [760ms, end)
+  EXPECT_THAT(steady[4].frames, ElementsAre(26, 27, 28, 29, 30, 31, 32, 33));
+}
+
+}  // namespace
@@ -0,0 +1,58 @@
+#include "lib/geometry/projection.h"
+
+#include <cmath>
+
+#include "absl/log/check.h"
+#include "lib/geometry/camera_metadata.h"
+#include "lib/geometry/points.h"
+
+namespace {
+
+constexpr double PI_3 = M_PI / 3.0;
+
+// The inverse of FindAngleRad: the image coordinate for an angle from the
+// camera's axis.
+double AngleToPixel(double angle, int res, double fov) {
+  const double res_half = res / 2.0;
+  return res_half + (angle / (fov / 2.0)) * res_half;
+}
+
+// The solver works with lines rather than rays, so angles that differ by pi
+// are the same. Normalizes an angle to [-pi/2, pi/2).
+double NormalizeLineAngle(double angle) {
+  return angle - M_PI * std::floor((angle + M_PI_2) / M_PI);
+}
+
+}  // namespace
+
+XYPos CameraWorldXYPos(int camera_number, const CameraMetadata& metadata) {
+  QCHECK(camera_number == 1 || camera_number == 2);
+
+  const double d = metadata.distance_from_center;
+  if (camera_number == 1) {
+    return {.x = d, .y = 0};
+  }
+  return {.x = -std::cos(PI_3) * d, .y = std::sin(PI_3) * d};
+}
+
+XYPos ProjectToCamera(int camera_number, const XYZPos& pos,
+                      const CameraMetadata& metadata) {
+  const XYPos camera = CameraWorldXYPos(camera_number, metadata);
+  const double dx = pos.x - camera.x;
+  const double dy = pos.y - camera.y;
+
+  // The solver finds the world XY angle from the horizontal angle as pi-a
+  // for camera 1 and 2pi/3-a for camera 2.
+  const double xy_angle = std::atan2(dy, dx);
+  const double h_angle = NormalizeLineAngle(
+      (camera_number == 1 ? M_PI : 2.0 * PI_3) - xy_angle);
+
+  // The solver finds z as tan(-a)*dist, where a is the vertical angle.
+  const double dist = std::sqrt(dx * dx + dy * dy);
+  const double v_angle = -std::atan2(pos.z, dist);
+
+  return {
+      .x = AngleToPixel(h_angle, metadata.res_h, metadata.fov_h),
+      .y = AngleToPixel(v_angle, metadata.res_v, metadata.fov_v),
+  };
+}
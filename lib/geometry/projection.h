@@ -0,0 +1,20 @@
+#ifndef _LIB_GEOMETRY_PROJECTION_H_
+#define _LIB_GEOMETRY_PROJECTION_H_ 1
+
+#include "lib/geometry/camera_metadata.h"
+#include "lib/geometry/points.h"
+
+// Projects world positions into camera images. This is the inverse of the
+// model used by calc and showfound's PixelSolver: camera 1 sits at (D, 0)
+// and camera 2 at 120 degrees counterclockwise from it, both at z=0 and
+// aimed at the origin, where D is the distance from center.
+
+// Returns the world XY position of camera 1 or 2.
+XYPos CameraWorldXYPos(int camera_number, const CameraMetadata& metadata);
+
+// Returns the image position at which camera 1 or 2 sees `pos`. The result
+// may lie outside the image.
+XYPos ProjectToCamera(int camera_number, const XYZPos& pos,
+                      const CameraMetadata& metadata);
+
+#endif  // _LIB_GEOMETRY_PROJECTION_H_
@@ -0,0 +1,51 @@
+#include "lib/geometry/projection.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lib/geometry/camera_metadata.h"
+#include "lib/geometry/points.h"
+#include "lib/geometry/points_testutil.h"
+#include "lib/geometry/translation.h"
+
+namespace {
+
+const CameraMetadata kMetadata = {
+    .distance_from_center = 10,
+    .fov_h = Radians(90),
+    .fov_v = Radians(60),
+    .res_h = 1000,
+    .res_v = 600,
+};
+
+TEST(ProjectionTest, CameraWorldXYPos) {
+  EXPECT_THAT(CameraWorldXYPos(1, kMetadata),
+              XYPosNear(XYPos{.x = 10, .y = 0}, 0.001));
+  EXPECT_THAT(CameraWorldXYPos(2, kMetadata),
+              XYPosNear(XYPos{.x = -5, .y = 8.66}, 0.001));
+}
+
+TEST(ProjectionTest, Center) {
+  for (int camera : {1, 2}) {
+    EXPECT_THAT(ProjectToCamera(camera, {0, 0, 0}, kMetadata),
+                XYPosNear(XYPos{.x = 500, .y = 300}, 0.001))
+        << camera;
+  }
+}
+
+TEST(ProjectionTest, Edges) {
+  // Camera 1 looks down the -x axis, so +y is to its right. A point 45
+  // degrees off axis is at the edge of the 90 degree field of view.
+  EXPECT_THAT(ProjectToCamera(1, {0, 10, 0}, kMetadata),
+              XYPosNear(XYPos{.x = 1000, .y = 300}, 0.001));
+  EXPECT_THAT(ProjectToCamera(1, {0, -10, 0}, kMetadata),
+              XYPosNear(XYPos{.x = 0, .y = 300}, 0.001));
+
+  // Up is toward the top of the image.
+  const double z = 10 * std::tan(Radians(30));
+  EXPECT_THAT(ProjectToCamera(1, {0, 0, z}, kMetadata),
+              XYPosNear(XYPos{.x = 500, .y = 0}, 0.001));
+  EXPECT_THAT(ProjectToCamera(1, {0, 0, -z}, kMetadata),
+              XYPosNear(XYPos{.x = 500, .y = 600}, 0.001));
+}
+
+}  // namespace
@@ -0,0 +1,21 @@
+#ifndef _LIB_TESTING_FILE_H_
+#define _LIB_TESTING_FILE_H_ 1
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <string>
+
+#include "absl/log/check.h"
+#include "gtest/gtest.h"
+#include "lib/file/path.h"
+
+// Creates (if necessary) a directory called `name` in the test's temporary
+// directory, and returns its path.
+inline std::string MakeTestDir(const std::string& name) {
+  const std::string dir = JoinPath({::testing::TempDir(), name});
+  QCHECK(mkdir(dir.c_str(), 0777) == 0 || errno == EEXIST) << dir;
+  return dir;
+}
+
+#endif  // _LIB_TESTING_FILE_H_